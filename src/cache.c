@@ -0,0 +1,485 @@
+/**
+ * @file
+ * @brief Persistent device descriptor cache implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "cache.h"
+
+#include "button.h"
+#include "receiver.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char *slavery_cache_default_path() {
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *path = NULL;
+
+	if (cache_home != NULL && cache_home[0] != '\0') {
+		asprintf(&path, "%s/slavery/devices.cache", cache_home);
+	} else if (home != NULL && home[0] != '\0') {
+		asprintf(&path, "%s/.cache/slavery/devices.cache", home);
+	}
+
+	return path;
+}
+
+static size_t slavery_cache_entry_size(const size_t num_features, const size_t num_buttons) {
+	size_t size = sizeof(slavery_cache_entry_t) + num_features * sizeof(slavery_cache_feature_t) +
+	              num_buttons * sizeof(slavery_cache_button_t);
+
+	// Keep every entry aligned, so the mapping can be read in place.
+	return (size + 7) & ~(size_t)7;
+}
+
+static const slavery_cache_button_t *slavery_cache_entry_buttons(const slavery_cache_entry_t *entry) {
+	return (const slavery_cache_button_t *)(entry->features + entry->num_features);
+}
+
+static bool slavery_cache_validate(const slavery_cache_t *cache) {
+	const slavery_cache_header_t *header = cache->data;
+	size_t offset = sizeof(slavery_cache_header_t);
+
+	if (cache->size < sizeof(slavery_cache_header_t) ||
+	    memcmp(header->magic, SLAVERY_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != SLAVERY_CACHE_VERSION || header->size != cache->size) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		const slavery_cache_entry_t *entry =
+		    (const slavery_cache_entry_t *)((const uint8_t *)cache->data + offset);
+
+		if (offset + sizeof(slavery_cache_entry_t) > cache->size ||
+		    entry->size != slavery_cache_entry_size(entry->num_features, entry->num_buttons) ||
+		    offset + entry->size > cache->size) {
+			return false;
+		}
+
+		offset += entry->size;
+	}
+
+	return true;
+}
+
+static void slavery_cache_map(slavery_cache_t *cache) {
+	struct stat st;
+	int fd;
+
+	cache->data = NULL;
+	cache->size = 0;
+
+	if ((fd = open(cache->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		log_debug("no device cache at %s", cache->path);
+
+		return;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(slavery_cache_header_t)) {
+		log_debug("device cache %s is empty", cache->path);
+
+		close(fd);
+
+		return;
+	}
+
+	if ((cache->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		log_warning_errno(SLAVERY_ERROR_IO, "mmap() failed");
+
+		cache->data = NULL;
+
+		close(fd);
+
+		return;
+	}
+
+	close(fd);
+
+	cache->size = st.st_size;
+
+	if (!slavery_cache_validate(cache)) {
+		log_debug("device cache %s is corrupt or from another version, ignoring it", cache->path);
+
+		munmap(cache->data, cache->size);
+
+		cache->data = NULL;
+		cache->size = 0;
+	}
+}
+
+slavery_cache_t *slavery_cache_open(const char *path) {
+	slavery_cache_t *cache = malloc(sizeof(slavery_cache_t));
+
+	cache->path = path != NULL ? strdup(path) : slavery_cache_default_path();
+	cache->data = NULL;
+	cache->size = 0;
+	atomic_init(&cache->dirty, false);
+
+	if (cache->path == NULL) {
+		log_debug("no cache path available, disabling device cache");
+
+		free(cache);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->mutex, NULL);
+
+	log_debug("opening device cache %s", cache->path);
+
+	slavery_cache_map(cache);
+
+	return cache;
+}
+
+void slavery_cache_free(slavery_cache_t *cache) {
+	log_debug("freeing device cache at %p", cache);
+
+	if (cache->data != NULL) {
+		munmap(cache->data, cache->size);
+	}
+
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache->path);
+	free(cache);
+}
+
+static bool slavery_cache_entry_matches(const slavery_cache_entry_t *entry,
+                                        const slavery_receiver_t *receiver,
+                                        const uint8_t device_index) {
+	return entry->device_index == device_index && entry->receiver_vendor_id == receiver->vendor_id &&
+	       entry->receiver_product_id == receiver->product_id &&
+	       strncmp(entry->receiver_address, receiver->address, sizeof(entry->receiver_address) - 1) == 0;
+}
+
+static const slavery_cache_entry_t *slavery_cache_find(const slavery_cache_t *cache,
+                                                       const slavery_receiver_t *receiver,
+                                                       const uint8_t device_index) {
+	if (cache->data == NULL) {
+		return NULL;
+	}
+
+	const slavery_cache_header_t *header = cache->data;
+	const uint8_t *data = (const uint8_t *)cache->data + sizeof(slavery_cache_header_t);
+
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		const slavery_cache_entry_t *entry = (const slavery_cache_entry_t *)data;
+
+		if (slavery_cache_entry_matches(entry, receiver, device_index)) {
+			return entry;
+		}
+
+		data += entry->size;
+	}
+
+	return NULL;
+}
+
+slavery_device_t *slavery_cache_get_device(slavery_cache_t *cache,
+                                           slavery_receiver_t *receiver,
+                                           const uint8_t device_index) {
+	slavery_cache_entry_t *entry = NULL;
+
+	// The entry is copied out, as a save can replace the mapping while the device is being validated.
+	pthread_mutex_lock(&cache->mutex);
+
+	const slavery_cache_entry_t *cached = slavery_cache_find(cache, receiver, device_index);
+
+	if (cached != NULL) {
+		entry = malloc(cached->size);
+		memcpy(entry, cached, cached->size);
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (entry == NULL) {
+		errno = ENOENT;
+
+		return NULL;
+	}
+
+	log_debug("found cached device %s on %s:%u", entry->name, receiver->devnode, device_index);
+
+	slavery_device_t *device = calloc(1, sizeof(slavery_device_t));
+	const slavery_cache_button_t *buttons = slavery_cache_entry_buttons(entry);
+
+	device->receiver = receiver;
+	device->index = device_index;
+
+	slavery_feature_table_init(&device->features);
+
+	for (size_t i = 0; i < entry->num_features; i++) {
+		slavery_feature_table_insert(&device->features,
+		                             &(slavery_feature_t){.id = entry->features[i].id,
+		                                                  .index = entry->features[i].index,
+		                                                  .flags = entry->features[i].flags,
+		                                                  .version = entry->features[i].version});
+	}
+
+	// The firmware version is the one request made for a cached device. It proves the device is there and is
+	// the same model running the same firmware as when it was cached.
+	if (slavery_device_get_firmware(device) < 0) {
+		log_debug("failed to validate cached device on %s:%u", receiver->devnode, device_index);
+
+		free(device);
+		free(entry);
+
+		return NULL;
+	}
+
+	if (memcmp(device->firmware, entry->firmware, SLAVERY_DEVICE_FIRMWARE_SIZE) != 0) {
+		log_debug("cached device on %s:%u has changed, discarding it", receiver->devnode, device_index);
+
+		free(device);
+		free(entry);
+
+		errno = ESTALE;
+
+		return NULL;
+	}
+
+	device->protocol_version = strndup(entry->protocol_version, sizeof(entry->protocol_version));
+	device->type = entry->type;
+	device->name = strndup(entry->name, sizeof(entry->name));
+	device->num_buttons = entry->num_buttons;
+	device->buttons = malloc(device->num_buttons * sizeof(slavery_button_t *));
+
+	for (size_t i = 0; i < device->num_buttons; i++) {
+		uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG] = {0};
+
+		memcpy(response_data + 4, buttons[i].info, sizeof(buttons[i].info));
+
+		device->buttons[i] = slavery_device_parse_button(device, i, response_data);
+	}
+
+	free(entry);
+
+	return device;
+}
+
+void slavery_cache_mark_dirty(slavery_cache_t *cache) {
+	atomic_store(&cache->dirty, true);
+}
+
+static void slavery_cache_append(uint8_t **data, size_t *size, const void *chunk, const size_t chunk_size) {
+	*data = realloc(*data, *size + chunk_size);
+
+	memcpy(*data + *size, chunk, chunk_size);
+
+	*size += chunk_size;
+}
+
+static void slavery_cache_append_device(uint8_t **data, size_t *size, const slavery_device_t *device) {
+	const slavery_receiver_t *receiver = device->receiver;
+	size_t entry_size = slavery_cache_entry_size(device->features.num_features, device->num_buttons);
+	slavery_cache_entry_t *entry = calloc(1, entry_size);
+	slavery_cache_button_t *buttons;
+
+	entry->size = entry_size;
+	entry->receiver_vendor_id = receiver->vendor_id;
+	entry->receiver_product_id = receiver->product_id;
+	snprintf(entry->receiver_address, sizeof(entry->receiver_address), "%s", receiver->address);
+	entry->device_index = device->index;
+	entry->type = device->type;
+	entry->num_buttons = device->num_buttons;
+	memcpy(entry->firmware, device->firmware, SLAVERY_DEVICE_FIRMWARE_SIZE);
+	snprintf(entry->protocol_version, sizeof(entry->protocol_version), "%s", device->protocol_version);
+	snprintf(entry->name, sizeof(entry->name), "%s", device->name);
+
+	for (size_t i = 0; i < SLAVERY_FEATURE_TABLE_SIZE; i++) {
+		const slavery_feature_t *feature = slavery_feature_table_get(&device->features, i);
+
+		if (feature != NULL) {
+			entry->features[entry->num_features++] = (slavery_cache_feature_t){.id = feature->id,
+			                                                                   .index = feature->index,
+			                                                                   .flags = feature->flags,
+			                                                                   .version = feature->version};
+		}
+	}
+
+	buttons = (slavery_cache_button_t *)slavery_cache_entry_buttons(entry);
+
+	for (size_t i = 0; i < device->num_buttons; i++) {
+		const slavery_button_t *button = device->buttons[i];
+		uint8_t *info = buttons[i].info;
+
+		// Reverse of slavery_device_parse_button(), so cached buttons are parsed exactly like fresh ones.
+		info[0] = button->cid >> 8;
+		info[1] = button->cid & 0xff;
+		info[2] = button->task_id >> 8;
+		info[3] = button->task_id & 0xff;
+		info[4] = button->flags;
+		info[5] = button->function_position;
+		info[6] = button->group;
+		info[7] = button->group_remap_mask;
+		info[8] = button->gesture;
+	}
+
+	slavery_cache_append(data, size, entry, entry_size);
+
+	free(entry);
+}
+
+static int slavery_cache_make_parents(const char *path) {
+	char *parent = strdup(path);
+
+	for (char *slash = strchr(parent + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+
+		if (mkdir(parent, 0700) < 0 && errno != EEXIST) {
+			log_warning_errno(SLAVERY_ERROR_IO, "mkdir() failed");
+
+			free(parent);
+
+			return -1;
+		}
+
+		*slash = '/';
+	}
+
+	free(parent);
+
+	return 0;
+}
+
+static int slavery_cache_write(slavery_cache_t *cache, slavery_t *slavery) {
+	slavery_cache_header_t header = {.version = SLAVERY_CACHE_VERSION, .num_entries = 0};
+	uint8_t *data = NULL;
+	size_t size = 0;
+	char *tmp_path = NULL;
+	int fd;
+
+	memcpy(header.magic, SLAVERY_CACHE_MAGIC, sizeof(header.magic));
+	slavery_cache_append(&data, &size, &header, sizeof(header));
+
+	for (size_t i = 0; i < slavery->num_receivers; i++) {
+		slavery_receiver_t *receiver = slavery->receivers[i];
+
+		for (size_t j = 0; j < receiver->num_devices; j++) {
+			slavery_device_t *device = receiver->devices[j];
+
+			// Devices without a firmware feature can't be validated, so they are always discovered.
+			if (slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_FIRMWARE) < 0) {
+				continue;
+			}
+
+			slavery_cache_append_device(&data, &size, device);
+			header.num_entries++;
+		}
+	}
+
+	// Keep devices that weren't connected this time, so they are still cached next time.
+	if (cache->data != NULL) {
+		const slavery_cache_header_t *old_header = cache->data;
+		const uint8_t *old_data = (const uint8_t *)cache->data + sizeof(slavery_cache_header_t);
+
+		for (uint32_t i = 0; i < old_header->num_entries; i++) {
+			const slavery_cache_entry_t *entry = (const slavery_cache_entry_t *)old_data;
+			bool connected = false;
+
+			for (size_t j = 0; j < slavery->num_receivers && !connected; j++) {
+				for (size_t k = 0; k < slavery->receivers[j]->num_devices && !connected; k++) {
+					slavery_device_t *device = slavery->receivers[j]->devices[k];
+
+					connected = slavery_cache_entry_matches(entry, device->receiver, device->index);
+				}
+			}
+
+			if (!connected) {
+				slavery_cache_append(&data, &size, entry, entry->size);
+				header.num_entries++;
+			}
+
+			old_data += entry->size;
+		}
+	}
+
+	header.size = size;
+	memcpy(data, &header, sizeof(header));
+
+	if (slavery_cache_make_parents(cache->path) < 0) {
+		free(data);
+
+		return -1;
+	}
+
+	// Write a new file and rename it into place, so a reader never maps a half written cache.
+	asprintf(&tmp_path, "%s.tmp", cache->path);
+
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "open() failed");
+
+		free(tmp_path);
+		free(data);
+
+		return -1;
+	}
+
+	if (write(fd, data, size) != (ssize_t)size) {
+		log_warning_errno(SLAVERY_ERROR_IO, "write() failed");
+
+		close(fd);
+		unlink(tmp_path);
+		free(tmp_path);
+		free(data);
+
+		return -1;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path, cache->path) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "rename() failed");
+
+		unlink(tmp_path);
+		free(tmp_path);
+		free(data);
+
+		return -1;
+	}
+
+	log_debug("saved %u devices to device cache", header.num_entries);
+
+	free(tmp_path);
+	free(data);
+
+	// Later scans and saves see what was just written, rather than the cache as it was at startup.
+	if (cache->data != NULL) {
+		munmap(cache->data, cache->size);
+	}
+
+	slavery_cache_map(cache);
+
+	return 0;
+}
+
+int slavery_cache_save(slavery_cache_t *cache, slavery_t *slavery) {
+	if (!atomic_exchange(&cache->dirty, false)) {
+		return 0;
+	}
+
+	log_debug("saving device cache to %s", cache->path);
+
+	pthread_mutex_lock(&cache->mutex);
+
+	int result = slavery_cache_write(cache, slavery);
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return result;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Persistent device descriptor cache functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "device.h"
+#include "libslavery.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLAVERY_CACHE_MAGIC "SLVCACHE"
+#define SLAVERY_CACHE_VERSION 1
+
+/**
+ * @brief Start of a cache file. Everything is in host byte order, the file is only ever read by the machine
+ * that wrote it.
+ */
+typedef struct slavery_cache_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_entries;
+	uint64_t size;
+} slavery_cache_header_t;
+
+/**
+ * @brief A cached feature, as returned by FeatureSet.
+ */
+typedef struct slavery_cache_feature_t {
+	uint16_t id;
+	uint8_t index;
+	uint8_t flags;
+	uint8_t version;
+} slavery_cache_feature_t;
+
+/**
+ * @brief A cached button, kept as the payload of its GET_BUTTON_INFO response.
+ */
+typedef struct slavery_cache_button_t {
+	uint8_t info[SLAVERY_PACKET_LENGTH_CONTROL_LONG - 4];
+} slavery_cache_button_t;
+
+/**
+ * @brief A cached device, followed by its features and then its buttons.
+ *
+ * Devices are keyed by receiver (vendor ID, product ID and physical address), device index and the response
+ * to the firmware feature's GET_VERSION, which also identifies the model.
+ */
+typedef struct slavery_cache_entry_t {
+	uint32_t size;
+	uint16_t receiver_vendor_id;
+	uint16_t receiver_product_id;
+	char receiver_address[64];
+	uint8_t device_index;
+	uint8_t type;
+	uint8_t num_features;
+	uint8_t num_buttons;
+	uint8_t firmware[SLAVERY_DEVICE_FIRMWARE_SIZE];
+	char protocol_version[8];
+	char name[256];
+	slavery_cache_feature_t features[];
+} slavery_cache_entry_t;
+
+/**
+ * @brief Read-only mapping of the cache file, rewritten as a whole whenever a device had to be discovered.
+ *
+ * Each save maps the file it wrote in place of the old one, under mutex, as hotplug can look devices up while
+ * a scan saves.
+ */
+typedef struct slavery_cache_t {
+	char *path;
+	pthread_mutex_t mutex;
+	void *data;
+	size_t size;
+	atomic_bool dirty;
+} slavery_cache_t;
+
+slavery_cache_t *slavery_cache_open(const char *path);
+void slavery_cache_free(slavery_cache_t *cache);
+slavery_device_t *slavery_cache_get_device(slavery_cache_t *cache,
+                                           slavery_receiver_t *receiver,
+                                           const uint8_t device_index);
+void slavery_cache_mark_dirty(slavery_cache_t *cache);
+int slavery_cache_save(slavery_cache_t *cache, slavery_t *slavery);
@@ -0,0 +1,281 @@
+/**
+ * @file
+ * @brief HID++ traffic capture implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "capture.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static size_t slavery_capture_option(uint8_t buffer[],
+                                     size_t offset,
+                                     const uint16_t code,
+                                     const void *value,
+                                     const uint16_t length) {
+	memcpy(buffer + offset, &code, sizeof(code));
+	memcpy(buffer + offset + 2, &length, sizeof(length));
+
+	if (length > 0) {
+		memcpy(buffer + offset + 4, value, length);
+	}
+
+	memset(buffer + offset + 4 + length, 0, -length & 3);
+
+	return offset + 4 + ((length + 3) & ~3);
+}
+
+static void slavery_capture_write_block(FILE *file, const uint32_t type, const uint8_t body[], size_t size) {
+	uint32_t length = 12 + size;
+
+	// Every block is already padded to 32 bits by whoever built its body.
+	fwrite(&type, sizeof(type), 1, file);
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(body, size, 1, file);
+	fwrite(&length, sizeof(length), 1, file);
+}
+
+static void slavery_capture_write_header(slavery_capture_t *capture) {
+	uint8_t body[128];
+	uint32_t magic = SLAVERY_CAPTURE_BYTE_ORDER_MAGIC;
+	uint16_t version[] = {1, 0};
+	int64_t section_length = -1;
+	const char *application = PROJECT_NAME " " PROJECT_VERSION;
+	uint16_t end = SLAVERY_CAPTURE_OPTION_END;
+	size_t size = 0;
+
+	memcpy(body, &magic, sizeof(magic));
+	memcpy(body + 4, version, sizeof(version));
+	memcpy(body + 8, &section_length, sizeof(section_length));
+	size = slavery_capture_option(
+	    body, 16, SLAVERY_CAPTURE_OPTION_SHB_USERAPPL, application, strlen(application));
+	size = slavery_capture_option(body, size, end, NULL, 0);
+
+	slavery_capture_write_block(capture->file, SLAVERY_CAPTURE_BLOCK_SHB, body, size);
+
+	uint16_t link_type[] = {SLAVERY_CAPTURE_LINKTYPE_USB_LINUX_MMAPPED, 0};
+	uint32_t snap_length = sizeof(slavery_capture_usbmon_header_t) + SLAVERY_PACKET_LENGTH_MAX;
+	uint8_t resolution = 9;
+
+	// Timestamps are in nanoseconds rather than the default microseconds.
+	memcpy(body, link_type, sizeof(link_type));
+	memcpy(body + 4, &snap_length, sizeof(snap_length));
+	size =
+	    slavery_capture_option(body, 8, SLAVERY_CAPTURE_OPTION_IF_NAME, PROJECT_NAME, strlen(PROJECT_NAME));
+	size = slavery_capture_option(body, size, SLAVERY_CAPTURE_OPTION_IF_TSRESOL, &resolution, 1);
+	size = slavery_capture_option(body, size, end, NULL, 0);
+
+	slavery_capture_write_block(capture->file, SLAVERY_CAPTURE_BLOCK_IDB, body, size);
+}
+
+static void slavery_capture_write_packet(slavery_capture_t *capture, const slavery_capture_record_t *record) {
+	uint8_t body[20 + sizeof(slavery_capture_usbmon_header_t) + SLAVERY_PACKET_LENGTH_MAX + 12];
+	uint64_t time_ns = record->time_ns + capture->realtime_offset_ns;
+	bool in = record->direction == SLAVERY_CAPTURE_DIRECTION_IN;
+	uint32_t flags = in ? SLAVERY_CAPTURE_EPB_FLAGS_INBOUND : SLAVERY_CAPTURE_EPB_FLAGS_OUTBOUND;
+	uint32_t length = sizeof(slavery_capture_usbmon_header_t) + record->size;
+
+	// Reports read are completions of the IN endpoint, and those written submissions to the OUT endpoint.
+	slavery_capture_usbmon_header_t header = {
+	    .id = capture->next_id++,
+	    .type = in ? 'C' : 'S',
+	    .transfer_type = SLAVERY_CAPTURE_USB_TRANSFER_INTERRUPT,
+	    .endpoint = in ? SLAVERY_CAPTURE_USB_ENDPOINT_IN : SLAVERY_CAPTURE_USB_ENDPOINT_OUT,
+	    .device = record->size > 1 ? record->data[1] : 0,
+	    .bus = record->receiver,
+	    .setup_flag = '-',
+	    .data_flag = 0,
+	    .ts_sec = time_ns / 1000000000,
+	    .ts_usec = time_ns % 1000000000 / 1000,
+	    .status = in ? 0 : -EINPROGRESS,
+	    .length = record->size,
+	    .captured_length = record->size,
+	};
+	uint32_t fields[] = {0, time_ns >> 32, time_ns & UINT32_MAX, length, length};
+	size_t size;
+
+	memcpy(body, fields, sizeof(fields));
+	memcpy(body + sizeof(fields), &header, sizeof(header));
+	memcpy(body + sizeof(fields) + sizeof(header), record->data, record->size);
+	memset(body + sizeof(fields) + length, 0, -length & 3);
+
+	size = sizeof(fields) + ((length + 3) & ~3);
+	size = slavery_capture_option(body, size, SLAVERY_CAPTURE_OPTION_EPB_FLAGS, &flags, sizeof(flags));
+	size = slavery_capture_option(body, size, SLAVERY_CAPTURE_OPTION_END, NULL, 0);
+
+	slavery_capture_write_block(capture->file, SLAVERY_CAPTURE_BLOCK_EPB, body, size);
+}
+
+static bool slavery_capture_pop(slavery_capture_t *capture, slavery_capture_record_t *record) {
+	size_t pos = atomic_load_explicit(&capture->dequeue_pos, memory_order_relaxed);
+	slavery_capture_cell_t *cell = &capture->cells[pos & (SLAVERY_CAPTURE_RING_SIZE - 1)];
+	size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+
+	// The writer is the only consumer, so unlike the worker queues, taking a cell needs no compare and swap.
+	if (sequence != pos + 1) {
+		return false;
+	}
+
+	*record = cell->record;
+
+	atomic_store_explicit(&cell->sequence, pos + SLAVERY_CAPTURE_RING_SIZE, memory_order_release);
+	atomic_store_explicit(&capture->dequeue_pos, pos + 1, memory_order_relaxed);
+
+	return true;
+}
+
+static void *slavery_capture_run(slavery_capture_t *capture) {
+	struct pollfd pollfd = {.fd = capture->stop_fd, .events = POLLIN};
+	slavery_capture_record_t record;
+	bool stopping = false;
+
+	if ((errno = pthread_setname_np(pthread_self(), "capture")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	// The ring is drained on a timer rather than woken by each report, so capturing costs the I/O path no
+	// system calls. Reports captured before stopping are all written, as the ring is drained once more.
+	while (!stopping) {
+		stopping = poll(&pollfd, 1, SLAVERY_CAPTURE_FLUSH_MS) > 0;
+
+		while (slavery_capture_pop(capture, &record)) {
+			slavery_capture_write_packet(capture, &record);
+			capture->captured++;
+		}
+
+		if (fflush(capture->file) != 0) {
+			log_warning_errno(SLAVERY_ERROR_IO, "failed to write capture");
+		}
+	}
+
+	return NULL;
+}
+
+slavery_capture_t *slavery_capture_new(const char *path) {
+	slavery_capture_t *capture = malloc(sizeof(slavery_capture_t));
+	struct timespec realtime;
+
+	if ((capture->file = fopen(path, "we")) == NULL) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to open capture file %s", path);
+
+		free(capture);
+
+		return NULL;
+	}
+
+	if ((capture->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		fclose(capture->file);
+		free(capture);
+
+		return NULL;
+	}
+
+	// Reports are stamped with the monotonic clock, and written with wall clock time so tools show when they
+	// happened.
+	clock_gettime(CLOCK_REALTIME, &realtime);
+
+	capture->realtime_offset_ns =
+	    (int64_t)realtime.tv_sec * 1000000000 + realtime.tv_nsec - (int64_t)time_monotonic_ns();
+	capture->next_id = 1;
+	capture->cells = malloc(sizeof(slavery_capture_cell_t) * SLAVERY_CAPTURE_RING_SIZE);
+
+	for (size_t i = 0; i < SLAVERY_CAPTURE_RING_SIZE; i++) {
+		atomic_init(&capture->cells[i].sequence, i);
+	}
+
+	atomic_init(&capture->enqueue_pos, 0);
+	atomic_init(&capture->dequeue_pos, 0);
+	atomic_init(&capture->dropped, 0);
+	capture->captured = 0;
+
+	slavery_capture_write_header(capture);
+
+	if ((errno = pthread_create(&capture->thread, NULL, (pthread_callback_t)slavery_capture_run, capture)) !=
+	    0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		close(capture->stop_fd);
+		fclose(capture->file);
+		free(capture->cells);
+		free(capture);
+
+		return NULL;
+	}
+
+	log_debug("capturing HID++ traffic to %s", path);
+
+	return capture;
+}
+
+void slavery_capture_free(slavery_capture_t *capture) {
+	if (eventfd_write(capture->stop_fd, 1) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write()");
+	}
+
+	pthread_join(capture->thread, NULL);
+
+	size_t dropped = atomic_load(&capture->dropped);
+
+	if (dropped > 0) {
+		log_warning(SLAVERY_ERROR_IO, "capture dropped %zu reports when its ring was full", dropped);
+	}
+
+	log_debug("captured %zu reports", capture->captured);
+
+	close(capture->stop_fd);
+	fclose(capture->file);
+	free(capture->cells);
+	free(capture);
+}
+
+void slavery_capture_report(slavery_capture_t *capture,
+                            const uint16_t receiver,
+                            const slavery_capture_direction_t direction,
+                            const uint8_t data[],
+                            const size_t size) {
+	size_t pos = atomic_load_explicit(&capture->enqueue_pos, memory_order_relaxed);
+	slavery_capture_cell_t *cell;
+
+	while (true) {
+		cell = &capture->cells[pos & (SLAVERY_CAPTURE_RING_SIZE - 1)];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(
+			        &capture->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// The writer has fallen a whole ring behind, so this report is counted but not kept.
+			atomic_fetch_add_explicit(&capture->dropped, 1, memory_order_relaxed);
+
+			return;
+		} else {
+			pos = atomic_load_explicit(&capture->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	cell->record.time_ns = time_monotonic_ns();
+	cell->record.receiver = receiver;
+	cell->record.direction = direction;
+	cell->record.size = size < SLAVERY_PACKET_LENGTH_MAX ? size : SLAVERY_PACKET_LENGTH_MAX;
+
+	memcpy(cell->record.data, data, cell->record.size);
+
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+}
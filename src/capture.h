@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @brief HID++ traffic capture functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Reports the capture ring holds before the writer has to catch up. Must be a power of 2.
+ */
+#define SLAVERY_CAPTURE_RING_SIZE 4096
+
+/**
+ * @brief Milliseconds between the writer draining the ring to the file.
+ */
+#define SLAVERY_CAPTURE_FLUSH_MS 50
+
+// pcapng and usbmon values, also needed to read captures back.
+#define SLAVERY_CAPTURE_BLOCK_SHB 0x0a0d0d0a
+#define SLAVERY_CAPTURE_BLOCK_IDB 0x00000001
+#define SLAVERY_CAPTURE_BLOCK_EPB 0x00000006
+#define SLAVERY_CAPTURE_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define SLAVERY_CAPTURE_LINKTYPE_USB_LINUX_MMAPPED 220
+
+#define SLAVERY_CAPTURE_OPTION_END 0
+#define SLAVERY_CAPTURE_OPTION_SHB_USERAPPL 4
+#define SLAVERY_CAPTURE_OPTION_IF_NAME 2
+#define SLAVERY_CAPTURE_OPTION_IF_TSRESOL 9
+#define SLAVERY_CAPTURE_OPTION_EPB_FLAGS 2
+
+#define SLAVERY_CAPTURE_EPB_FLAGS_INBOUND 1
+#define SLAVERY_CAPTURE_EPB_FLAGS_OUTBOUND 2
+
+#define SLAVERY_CAPTURE_USB_TRANSFER_INTERRUPT 1
+#define SLAVERY_CAPTURE_USB_TRANSFER_CONTROL 2
+#define SLAVERY_CAPTURE_USB_ENDPOINT_IN 0x83
+#define SLAVERY_CAPTURE_USB_ENDPOINT_OUT 0x03
+
+/**
+ * @brief The header usbmon puts before each transfer, which is what the USB link type expects to find.
+ */
+typedef struct slavery_capture_usbmon_header_t {
+	uint64_t id;
+	uint8_t type;
+	uint8_t transfer_type;
+	uint8_t endpoint;
+	uint8_t device;
+	uint16_t bus;
+	int8_t setup_flag;
+	int8_t data_flag;
+	int64_t ts_sec;
+	int32_t ts_usec;
+	int32_t status;
+	uint32_t length;
+	uint32_t captured_length;
+	uint8_t setup[8];
+	int32_t interval;
+	int32_t start_frame;
+	uint32_t transfer_flags;
+	uint32_t num_descriptors;
+} slavery_capture_usbmon_header_t;
+
+_Static_assert(sizeof(slavery_capture_usbmon_header_t) == 64, "usbmon header must be 64 bytes");
+
+/**
+ * @brief Which way a captured report went.
+ */
+typedef enum
+{
+	SLAVERY_CAPTURE_DIRECTION_IN,
+	SLAVERY_CAPTURE_DIRECTION_OUT
+} slavery_capture_direction_t;
+
+/**
+ * @brief A report as captured, before it is turned into a pcapng packet.
+ */
+typedef struct slavery_capture_record_t {
+	uint64_t time_ns;
+	uint16_t receiver;
+	uint8_t direction;
+	uint8_t size;
+	uint8_t data[SLAVERY_PACKET_LENGTH_MAX];
+} slavery_capture_record_t;
+
+/**
+ * @brief A single preallocated slot in the capture ring.
+ */
+typedef struct slavery_capture_cell_t {
+	atomic_size_t sequence;
+	slavery_capture_record_t record;
+} slavery_capture_cell_t;
+
+/**
+ * @brief Records every report read from or written to a receiver into a pcapng file.
+ *
+ * Reports are copied into a bounded lock-free ring on the I/O path, costing a clock read, a compare and swap
+ * and a copy of at most SLAVERY_PACKET_LENGTH_MAX bytes, and a writer thread turns them into packets. The
+ * file uses the Linux usbmon link type, as a capture of the receiver's interrupt endpoints would: the bus
+ * number is the receiver's hidraw minor and the device address its HID++ device index.
+ */
+typedef struct slavery_capture_t {
+	FILE *file;
+	int stop_fd;
+	pthread_t thread;
+	int64_t realtime_offset_ns;
+	uint64_t next_id;
+	size_t captured;
+	slavery_capture_cell_t *cells;
+	_Alignas(64) atomic_size_t enqueue_pos;
+	_Alignas(64) atomic_size_t dequeue_pos;
+	atomic_size_t dropped;
+} slavery_capture_t;
+
+slavery_capture_t *slavery_capture_new(const char *path);
+void slavery_capture_free(slavery_capture_t *capture);
+void slavery_capture_report(slavery_capture_t *capture,
+                            const uint16_t receiver,
+                            const slavery_capture_direction_t direction,
+                            const uint8_t data[],
+                            const size_t size);
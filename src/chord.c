@@ -0,0 +1,179 @@
+/**
+ * @file
+ * @brief Chord dispatch table implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "chord.h"
+
+#include "button.h"
+#include "device.h"
+#include "launcher.h"
+#include "libslavery_p.h"
+#include "receiver.h"
+#include "utils.h"
+
+#include <stdlib.h>
+
+static size_t slavery_chord_table_hash(const slavery_chord_table_t *table,
+                                       const uint32_t mask,
+                                       const slavery_config_action_t action) {
+	return (uint32_t)((mask ^ (uint32_t)action << 27) * 0x9e3779b1u) >> table->shift;
+}
+
+static slavery_chord_rule_t *slavery_chord_table_slot(const slavery_chord_table_t *table,
+                                                      const uint32_t mask,
+                                                      const slavery_config_action_t action) {
+	size_t slot = slavery_chord_table_hash(table, mask, action);
+
+	slavery_chord_rule_t *rule;
+
+	while ((rule = &table->rules[slot])->used && (rule->mask != mask || rule->action != action)) {
+		slot = (slot + 1) & (table->num_slots - 1);
+	}
+
+	return rule;
+}
+
+static int slavery_chord_entry_mask(const slavery_device_t *device,
+                                    const slavery_config_t *config,
+                                    const slavery_config_entry_t *entry,
+                                    uint32_t *mask) {
+	const slavery_config_button_t *buttons = slavery_config_entry_get_buttons(config, entry);
+
+	*mask = 0;
+
+	for (size_t i = 0; i < entry->num_buttons; i++) {
+		ssize_t bit = slavery_device_cid_to_bit(device, buttons[i].cid);
+
+		if (bit < 0) {
+			return -1;
+		}
+
+		*mask |= 1u << bit;
+	}
+
+	return *mask != 0 ? 0 : -1;
+}
+
+slavery_chord_table_t *slavery_chord_table_new(const slavery_device_t *device,
+                                               const slavery_config_t *config) {
+	slavery_chord_table_t *table = malloc(sizeof(slavery_chord_table_t));
+	size_t num_keys = 0;
+
+	table->config = config;
+	table->input = device->receiver->slavery->input;
+	table->launcher = device->receiver->slavery->launcher;
+	table->buttons = 0;
+	table->gestures = 0;
+	table->shift = 32 - 3;
+
+	for (size_t i = 0; i < config->num_entries; i++) {
+		num_keys += config->entries[i].num_actions;
+	}
+
+	while (((size_t)1 << (32 - table->shift)) < num_keys * 2) {
+		table->shift--;
+	}
+
+	table->num_slots = (size_t)1 << (32 - table->shift);
+	table->rules = calloc(table->num_slots, sizeof(slavery_chord_rule_t));
+	table->entries = malloc(sizeof(slavery_config_entry_t *) * (num_keys > 0 ? num_keys : 1));
+
+	// First count the entries under each key, then lay them out contiguously, keeping config order.
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < config->num_entries; i++) {
+			const slavery_config_entry_t *entry = &config->entries[i];
+			const slavery_config_action_t *actions = slavery_config_entry_get_actions(config, entry);
+			uint32_t mask;
+
+			if (!entry->enabled || slavery_chord_entry_mask(device, config, entry, &mask) < 0) {
+				if (pass == 0) {
+					log_debug("config entry %s doesn't apply to device %u",
+					          slavery_config_entry_get_name(config, entry),
+					          device->index);
+				}
+
+				continue;
+			}
+
+			for (size_t j = 0; j < entry->num_actions; j++) {
+				slavery_chord_rule_t *rule = slavery_chord_table_slot(table, mask, actions[j]);
+
+				if (pass == 0) {
+					table->buttons |= mask;
+
+					if (actions[j] >= SLAVERY_CONFIG_ACTION_GESTURE_UP &&
+					    actions[j] <= SLAVERY_CONFIG_ACTION_GESTURE_RIGHT) {
+						table->gestures |= mask;
+					}
+
+					rule->used = true;
+					rule->mask = mask;
+					rule->action = actions[j];
+					rule->num_entries++;
+				} else {
+					rule->entries[rule->num_entries++] = entry;
+				}
+			}
+		}
+
+		if (pass == 0) {
+			size_t offset = 0;
+
+			for (size_t slot = 0; slot < table->num_slots; slot++) {
+				table->rules[slot].entries = &table->entries[offset];
+				offset += table->rules[slot].num_entries;
+				table->rules[slot].num_entries = 0;
+			}
+		}
+	}
+
+	return table;
+}
+
+void slavery_chord_table_free(slavery_chord_table_t *table) {
+	free(table->entries);
+	free(table->rules);
+	free(table);
+}
+
+const slavery_chord_rule_t *slavery_chord_table_find(const slavery_chord_table_t *table,
+                                                     const uint32_t mask,
+                                                     const slavery_config_action_t action) {
+	const slavery_chord_rule_t *rule = slavery_chord_table_slot(table, mask, action);
+
+	return rule->used ? rule : NULL;
+}
+
+int slavery_chord_table_run(const slavery_chord_table_t *table, const slavery_chord_rule_t *rule) {
+	int result = 0;
+
+	for (size_t i = 0; i < rule->num_entries; i++) {
+		const slavery_config_entry_t *entry = rule->entries[i];
+
+		log_debug("running config entry %s", slavery_config_entry_get_name(table->config, entry));
+
+		if (table->input != NULL && entry->num_events > 0 &&
+		    slavery_virtual_input_write_events(
+		        table->input, slavery_config_entry_get_events(table->config, entry), entry->num_events) < 0) {
+			result = -1;
+		}
+
+		for (size_t j = 0; j < entry->num_do_commands; j++) {
+			if (table->launcher == NULL ||
+			    slavery_launcher_run(table->launcher,
+			                         slavery_config_entry_get_do_command(table->config, entry, j)) < 0) {
+				result = -1;
+			}
+		}
+	}
+
+	return result;
+}
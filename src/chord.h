@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief Chord dispatch table functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "config.h"
+#include "virtual_input.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct slavery_device_t slavery_device_t;
+typedef struct slavery_launcher_t slavery_launcher_t;
+
+/**
+ * @brief Config entries matching one pressed-button mask and action.
+ */
+typedef struct slavery_chord_rule_t {
+	bool used;
+	uint32_t mask;
+	slavery_config_action_t action;
+	size_t num_entries;
+	const slavery_config_entry_t **entries;
+} slavery_chord_rule_t;
+
+/**
+ * @brief A config compiled for one device.
+ *
+ * Rules are keyed by the device's pressed-button mask and an action, in an open-addressed table at most
+ * half full, so finding the entries for a button state change costs the same however large the config is.
+ * Entries naming a button the device doesn't have are left out. The union of every rule's mask, and of those
+ * with gesture actions, tells the device which controls need diverting. Events go to the context's virtual
+ * device, and commands to its launcher, so running them never waits for a device or process to be created.
+ */
+typedef struct slavery_chord_table_t {
+	const slavery_config_t *config;
+	uint32_t buttons;
+	uint32_t gestures;
+	unsigned int shift;
+	size_t num_slots;
+	slavery_chord_rule_t *rules;
+	const slavery_config_entry_t **entries;
+	slavery_virtual_input_t *input;
+	slavery_launcher_t *launcher;
+} slavery_chord_table_t;
+
+slavery_chord_table_t *slavery_chord_table_new(const slavery_device_t *device,
+                                               const slavery_config_t *config);
+void slavery_chord_table_free(slavery_chord_table_t *table);
+const slavery_chord_rule_t *slavery_chord_table_find(const slavery_chord_table_t *table,
+                                                     const uint32_t mask,
+                                                     const slavery_config_action_t action);
+int slavery_chord_table_run(const slavery_chord_table_t *table, const slavery_chord_rule_t *rule);
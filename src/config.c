@@ -8,19 +8,24 @@
  * @license $(PROJECT_LICENSE)
  */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
 #include "config.h"
 
 #include "libslavery.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <json.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 /*static char *parse_string(const json_object *obj, const char *key, const bool required) {
     json_object *child_obj;
@@ -207,7 +212,8 @@ static ssize_t slavery_config_entry_parse_strings(const json_object *obj,
 	ssize_t num_strings;
 	*value = NULL;
 
-	if (!json_object_object_get_ex(obj, key, &child_obj)) {
+	if (!json_object_object_get_ex(obj, key, &child_obj) ||
+	    json_object_get_type(child_obj) == json_type_null) {
 		if (!required) {
 			log_debug("config entry is missing optional string/string array value for %s", key);
 
@@ -230,24 +236,30 @@ static ssize_t slavery_config_entry_parse_strings(const json_object *obj,
 			break;
 
 		case json_type_array: {
-			array_list *list = json_object_get_array(child_obj);
-			*value = malloc(sizeof(char **) * list->size);
+			size_t length = json_object_array_length(child_obj);
+			*value = malloc(sizeof(char **) * length);
 
-			for (size_t i = 0; i < list->size; i++) {
+			for (size_t i = 0; i < length; i++) {
 				json_object *grandchild_obj = json_object_array_get_idx(child_obj, i);
 
 				if (json_object_get_type(grandchild_obj) != json_type_string) {
-					log_warning(SLAVERY_ERROR_CONFIG, "config entry has invalid type for item in %s array");
+					log_warning(
+					    SLAVERY_ERROR_CONFIG, "config entry has invalid type for item in %s array", key);
+
+					for (size_t j = 0; j < i; j++) {
+						free((*value)[j]);
+					}
 
-					// TODO free
+					free(*value);
+					*value = NULL;
 
 					return -1;
 				}
 
-				*value[i] = strdup(json_object_get_string(grandchild_obj));
+				(*value)[i] = strdup(json_object_get_string(grandchild_obj));
 			}
 
-			num_strings = list->size;
+			num_strings = length;
 
 			break;
 		}
@@ -263,39 +275,291 @@ static ssize_t slavery_config_entry_parse_strings(const json_object *obj,
 	return num_strings;
 }
 
-slavery_config_entry_t *slavery_config_entry_parse(const char *name, const json_object *obj) {
+static int slavery_config_output_resolve(const char *name, const bool mouse, struct input_event *event) {
+	if (!mouse) {
+#define KEY(key_name, key_code)                                                  \
+	if (strcmp(name, key_name) == 0) {                                           \
+		*event = (struct input_event){.type = EV_KEY, .code = key_code, .value = 1}; \
+                                                                                 \
+		return 0;                                                                \
+	}
+		KEYBOARD_MAP(KEY)
+#undef KEY
+	} else {
+#define MOUSE(mouse_name, mouse_type, mouse_code, mouse_value)                                 \
+	if (strcmp(name, mouse_name) == 0) {                                                       \
+		*event = (struct input_event){.type = mouse_type, .code = mouse_code, .value = mouse_value}; \
+                                                                                               \
+		return 0;                                                                              \
+	}
+		MOUSE_MAP(MOUSE)
+#undef MOUSE
+	}
+
+	log_warning(SLAVERY_ERROR_CONFIG, "unknown %s name %s", mouse ? "mouse" : "keyboard", name);
+
+	return -1;
+}
+
+int slavery_config_output_compile(slavery_config_output_t *output,
+                                  char *keyboard[],
+                                  const size_t num_keyboard,
+                                  char *mouse[],
+                                  const size_t num_mouse) {
+	size_t num_inputs = num_keyboard + num_mouse;
+	size_t num_pressed = 0;
+
+	output->num_events = 0;
+	output->events = NULL;
+
+	if (num_inputs == 0) {
+		return 0;
+	}
+
+	// At most every input pressed then released, plus a SYN_REPORT closing each half.
+	struct input_event *events = malloc(sizeof(struct input_event) * (num_inputs * 2 + 2));
+
+	for (size_t i = 0; i < num_inputs; i++) {
+		bool is_mouse = i >= num_keyboard;
+		const char *name = is_mouse ? mouse[i - num_keyboard] : keyboard[i];
+
+		if (slavery_config_output_resolve(name, is_mouse, &events[i]) < 0) {
+			free(events);
+
+			return -1;
+		}
+
+		if (events[i].type == EV_KEY) {
+			num_pressed++;
+		}
+	}
+
+	output->num_events = num_inputs;
+	events[output->num_events++] = (struct input_event){.type = EV_SYN, .code = SYN_REPORT};
+
+	if (num_pressed > 0) {
+		for (size_t i = num_inputs; i-- > 0;) {
+			if (events[i].type == EV_KEY) {
+				events[output->num_events++] =
+				    (struct input_event){.type = EV_KEY, .code = events[i].code, .value = 0};
+			}
+		}
+
+		events[output->num_events++] = (struct input_event){.type = EV_SYN, .code = SYN_REPORT};
+	}
+
+	output->events = events;
+
+	return 0;
+}
+
+ssize_t slavery_config_command_split(const char *command, char args[], uint32_t *argc) {
+	char quote = '\0';
+	bool in_arg = false;
+	size_t size = 0;
+
+	*argc = 0;
+
+	// Quotes and backslashes work as they do in a shell, but nothing is expanded, so a command always runs
+	// exactly as written. The arguments are never longer than the command, so args needs strlen() + 1 bytes.
+	for (const char *c = command; *c != '\0'; c++) {
+		if (quote == '\0' && (*c == ' ' || *c == '\t' || *c == '\n')) {
+			if (in_arg) {
+				args[size++] = '\0';
+				in_arg = false;
+			}
+
+			continue;
+		}
+
+		if (!in_arg) {
+			in_arg = true;
+			(*argc)++;
+		}
+
+		if (quote == '\0' && (*c == '\'' || *c == '"')) {
+			quote = *c;
+		} else if (quote != '\0' && *c == quote) {
+			quote = '\0';
+		} else if (*c == '\\' && quote != '\'' && (quote == '\0' || c[1] == '"' || c[1] == '\\')) {
+			if (*++c == '\0') {
+				return -1;
+			}
+
+			args[size++] = *c;
+		} else {
+			args[size++] = *c;
+		}
+	}
+
+	if (quote != '\0' || *argc == 0) {
+		return -1;
+	}
+
+	args[size++] = '\0';
+
+	return size;
+}
+
+static void slavery_config_strings_free(char *strings[], const ssize_t num_strings) {
+	for (ssize_t i = 0; i < num_strings; i++) {
+		free(strings[i]);
+	}
+
+	free(strings);
+}
+
+static int slavery_config_entry_parse_buttons(slavery_config_source_entry_t *config_entry,
+                                              char *strings[],
+                                              const size_t num_strings) {
+	config_entry->num_buttons = num_strings;
+	config_entry->buttons = malloc(sizeof(slavery_config_button_t) * num_strings);
+
+	for (size_t i = 0; i < num_strings; i++) {
+		if ((config_entry->buttons[i].cid = slavery_string_to_cid(strings[i])) == SLAVERY_CID_MOUSE_UNKNOWN) {
+			log_warning(SLAVERY_ERROR_CONFIG, "unknown button name %s", strings[i]);
+
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int slavery_config_entry_parse_actions(slavery_config_source_entry_t *config_entry,
+                                              char *strings[],
+                                              const size_t num_strings) {
+	config_entry->num_actions = num_strings;
+	config_entry->actions = malloc(sizeof(slavery_config_action_t) * num_strings);
+
+	for (size_t i = 0; i < num_strings; i++) {
+		if ((config_entry->actions[i] = slavery_config_string_to_action(strings[i])) ==
+		    SLAVERY_CONFIG_ACTION_UNKNOWN) {
+			log_warning(SLAVERY_ERROR_CONFIG, "unknown action %s", strings[i]);
+
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+slavery_config_source_entry_t *slavery_config_source_entry_parse(const char *name, const json_object *obj) {
 	log_debug("parsing config entry %s", name);
 
-	slavery_config_entry_t *config_entry = malloc(sizeof(slavery_config_entry_t));
+	slavery_config_source_entry_t *config_entry = calloc(1, sizeof(slavery_config_source_entry_t));
 	config_entry->name = strdup(name);
 
 	if (slavery_config_entry_parse_string(obj, "description", false, &config_entry->description) < 0) {
 		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
 
+		slavery_config_source_entry_free(config_entry);
+
 		return NULL;
 	}
 
 	if (slavery_config_entry_parse_bool(obj, "enabled", false, &config_entry->enabled) < 0) {
 		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
 
+		slavery_config_source_entry_free(config_entry);
+
 		return NULL;
 	}
 
 	if (slavery_config_entry_parse_bool(obj, "inhibit_cursor", false, &config_entry->inhibit_cursor) < 0) {
 		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
 
+		slavery_config_source_entry_free(config_entry);
+
 		return NULL;
 	}
 
 	if (slavery_config_entry_parse_bool(obj, "do_default", false, &config_entry->do_default) < 0) {
 		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
 
+		slavery_config_source_entry_free(config_entry);
+
 		return NULL;
 	}
 
-	if (slavery_config_entry_parse_strings(obj, "do_command", false, &config_entry->do_command) < 0) {
+	// Buttons and actions are resolved here, so nothing compares names once events are flowing.
+	char **strings;
+	ssize_t num_strings;
+
+	if ((num_strings = slavery_config_entry_parse_strings(obj, "buttons", true, &strings)) < 0 ||
+	    slavery_config_entry_parse_buttons(config_entry, strings, num_strings) < 0) {
+		slavery_config_strings_free(strings, num_strings);
+
 		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
 
+		slavery_config_source_entry_free(config_entry);
+
+		return NULL;
+	}
+
+	slavery_config_strings_free(strings, num_strings);
+
+	if ((num_strings = slavery_config_entry_parse_strings(obj, "action", true, &strings)) < 0 ||
+	    slavery_config_entry_parse_actions(config_entry, strings, num_strings) < 0) {
+		slavery_config_strings_free(strings, num_strings);
+
+		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
+
+		slavery_config_source_entry_free(config_entry);
+
+		return NULL;
+	}
+
+	slavery_config_strings_free(strings, num_strings);
+
+	ssize_t num_do_commands =
+	    slavery_config_entry_parse_strings(obj, "do_command", false, &config_entry->do_command);
+
+	if (num_do_commands < 0) {
+		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
+
+		slavery_config_source_entry_free(config_entry);
+
+		return NULL;
+	}
+
+	config_entry->num_do_commands = num_do_commands;
+
+	for (size_t i = 0; i < config_entry->num_do_commands; i++) {
+		char args[strlen(config_entry->do_command[i]) + 1];
+		uint32_t argc;
+
+		if (slavery_config_command_split(config_entry->do_command[i], args, &argc) < 0) {
+			log_warning(SLAVERY_ERROR_CONFIG,
+			            "failed to parse do_command \"%s\" in config entry for %s",
+			            config_entry->do_command[i],
+			            name);
+
+			slavery_config_source_entry_free(config_entry);
+
+			return NULL;
+		}
+	}
+
+	// Key and button names are only needed until they have been resolved to events.
+	char **do_keyboard, **do_mouse;
+	ssize_t num_do_keyboard = slavery_config_entry_parse_strings(obj, "do_keyboard", false, &do_keyboard);
+	ssize_t num_do_mouse = slavery_config_entry_parse_strings(obj, "do_mouse", false, &do_mouse);
+	int result = -1;
+
+	if (num_do_keyboard >= 0 && num_do_mouse >= 0) {
+		result = slavery_config_output_compile(
+		    &config_entry->output, do_keyboard, num_do_keyboard, do_mouse, num_do_mouse);
+	}
+
+	slavery_config_strings_free(do_keyboard, num_do_keyboard);
+	slavery_config_strings_free(do_mouse, num_do_mouse);
+
+	if (result < 0) {
+		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config entry for %s", name);
+
+		slavery_config_source_entry_free(config_entry);
+
 		return NULL;
 	}
 
@@ -315,52 +579,571 @@ slavery_config_entry_t *slavery_config_entry_parse(const char *name, const json_
 	return config_entry;
 }
 
-slavery_config_t *slavery_config_new(const char *path) {
-	log_debug("parsing config file %s", path);
+void slavery_config_source_entry_free(slavery_config_source_entry_t *source_entry) {
+	free(source_entry->name);
+	free(source_entry->description);
+	free(source_entry->buttons);
+	free(source_entry->actions);
+	slavery_config_strings_free(source_entry->do_command, source_entry->num_do_commands);
+	free(source_entry->output.events);
+	free(source_entry);
+}
+
+static uint64_t slavery_config_checksum(const uint8_t data[], const size_t size) {
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	}
+
+	return hash;
+}
+
+static int64_t slavery_config_time_ns(const struct timespec *time) {
+	return time->tv_sec * 1000000000LL + time->tv_nsec;
+}
+
+static char *slavery_config_compiled_path(const char *path) {
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *real_path = realpath(path, NULL);
+	const char *key = real_path != NULL ? real_path : path;
+	uint64_t hash = slavery_config_checksum((const uint8_t *)key, strlen(key));
+	char *compiled_path = NULL;
+
+	// Compiled configs live in the user's cache, as the JSON may be in a directory they can't write to.
+	if (cache_home != NULL && cache_home[0] != '\0') {
+		asprintf(&compiled_path, "%s/slavery/config-%016" PRIx64 ".bin", cache_home, hash);
+	} else if (home != NULL && home[0] != '\0') {
+		asprintf(&compiled_path, "%s/.cache/slavery/config-%016" PRIx64 ".bin", home, hash);
+	}
+
+	free(real_path);
+
+	return compiled_path;
+}
+
+static uint32_t slavery_config_image_append(uint8_t **data,
+                                            size_t *size,
+                                            const void *chunk,
+                                            const size_t chunk_size) {
+	// Keep every chunk aligned, so the image can be read in place.
+	size_t offset = (*size + 7) & ~(size_t)7;
+
+	*data = realloc(*data, offset + chunk_size);
+
+	memset(*data + *size, 0, offset - *size);
+
+	// Empty arrays are passed as NULL.
+	if (chunk_size > 0) {
+		memcpy(*data + offset, chunk, chunk_size);
+	}
+
+	*size = offset + chunk_size;
+
+	return offset;
+}
+
+static uint32_t slavery_config_image_append_string(uint8_t **data, size_t *size, const char *string) {
+	return string != NULL ? slavery_config_image_append(data, size, string, strlen(string) + 1) : 0;
+}
+
+uint8_t *slavery_config_image_build(slavery_config_source_entry_t *source_entries[],
+                                    const size_t num_entries,
+                                    const struct stat *source,
+                                    size_t *size) {
+	slavery_config_header_t header = {.version = SLAVERY_CONFIG_VERSION,
+	                                  .num_entries = num_entries,
+	                                  .source_size = source->st_size,
+	                                  .source_mtime_ns = slavery_config_time_ns(&source->st_mtim),
+	                                  .source_ino = source->st_ino,
+	                                  .source_ctime_ns = slavery_config_time_ns(&source->st_ctim)};
+	slavery_config_entry_t *entries =
+	    calloc(num_entries > 0 ? num_entries : 1, sizeof(slavery_config_entry_t));
+	bool keys_seen[KEY_CNT] = {false};
+	bool rels_seen[REL_CNT] = {false};
+	uint16_t keys[KEY_CNT];
+	uint16_t rels[REL_CNT];
+	uint8_t *data = NULL;
+
+	*size = 0;
+
+	memcpy(header.magic, SLAVERY_CONFIG_MAGIC, sizeof(header.magic));
+	slavery_config_image_append(&data, size, &header, sizeof(header));
+
+	for (size_t i = 0; i < num_entries; i++) {
+		const slavery_config_source_entry_t *source_entry = source_entries[i];
+		const slavery_config_output_t *output = &source_entry->output;
+		slavery_config_entry_t *entry = &entries[i];
+		uint32_t do_command[source_entry->num_do_commands + 1];
+
+		entry->name = slavery_config_image_append_string(&data, size, source_entry->name);
+		entry->description = slavery_config_image_append_string(&data, size, source_entry->description);
+		entry->num_buttons = source_entry->num_buttons;
+		entry->buttons = slavery_config_image_append(
+		    &data, size, source_entry->buttons, sizeof(slavery_config_button_t) * source_entry->num_buttons);
+		entry->num_actions = source_entry->num_actions;
+		entry->actions = slavery_config_image_append(
+		    &data, size, source_entry->actions, sizeof(slavery_config_action_t) * source_entry->num_actions);
+
+		// Commands are stored ready to launch, already split into their arguments.
+		for (size_t j = 0; j < source_entry->num_do_commands; j++) {
+			size_t length = strlen(source_entry->do_command[j]);
+			slavery_config_command_t *command = malloc(sizeof(slavery_config_command_t) + length + 1);
+
+			command->size =
+			    slavery_config_command_split(source_entry->do_command[j], command->args, &command->argc);
+			do_command[j] = slavery_config_image_append(
+			    &data, size, command, sizeof(slavery_config_command_t) + command->size);
+
+			free(command);
+		}
+
+		entry->num_do_commands = source_entry->num_do_commands;
+		entry->do_command = slavery_config_image_append(
+		    &data, size, do_command, sizeof(uint32_t) * source_entry->num_do_commands);
+		entry->num_events = output->num_events;
+		entry->events = slavery_config_image_append(
+		    &data, size, output->events, sizeof(struct input_event) * output->num_events);
+		entry->enabled = source_entry->enabled;
+		entry->inhibit_cursor = source_entry->inhibit_cursor;
+		entry->do_default = source_entry->do_default;
+
+		for (size_t j = 0; j < output->num_events; j++) {
+			const struct input_event *event = &output->events[j];
+
+			if (event->type == EV_KEY && !keys_seen[event->code]) {
+				keys_seen[event->code] = true;
+				keys[header.num_keys++] = event->code;
+			} else if (event->type == EV_REL && !rels_seen[event->code]) {
+				rels_seen[event->code] = true;
+				rels[header.num_rels++] = event->code;
+			}
+		}
+	}
+
+	header.entries =
+	    slavery_config_image_append(&data, size, entries, sizeof(slavery_config_entry_t) * num_entries);
+	header.keys = slavery_config_image_append(&data, size, keys, sizeof(uint16_t) * header.num_keys);
+	header.rels = slavery_config_image_append(&data, size, rels, sizeof(uint16_t) * header.num_rels);
+	header.size = *size;
+	header.checksum = slavery_config_checksum(data + sizeof(header), *size - sizeof(header));
+
+	memcpy(data, &header, sizeof(header));
+	free(entries);
+
+	return data;
+}
+
+static bool slavery_config_image_has_array(const size_t size,
+                                           const uint32_t offset,
+                                           const uint32_t count,
+                                           const size_t element_size) {
+	// Every chunk is aligned as the image is built, so one that isn't wasn't written by the compiler.
+	return offset % 8 == 0 && offset + (uint64_t)count * element_size <= size;
+}
+
+static bool slavery_config_image_has_string(const uint8_t data[], const size_t size, const uint32_t offset) {
+	return offset < size && memchr(data + offset, '\0', size - offset) != NULL;
+}
+
+static bool slavery_config_image_has_command(const uint8_t data[], const size_t size, const uint32_t offset) {
+	const slavery_config_command_t *command = (const slavery_config_command_t *)(data + offset);
+	uint32_t num_args = 0;
+
+	if (!slavery_config_image_has_array(size, offset, 1, sizeof(slavery_config_command_t)) ||
+	    offset + sizeof(slavery_config_command_t) + (uint64_t)command->size > size) {
+		return false;
+	}
+
+	// The launcher expects exactly argc arguments, the last of them terminated.
+	for (uint32_t i = 0; i < command->size; i++) {
+		num_args += command->args[i] == '\0';
+	}
+
+	return num_args == command->argc && (command->size == 0 || command->args[command->size - 1] == '\0');
+}
+
+static bool slavery_config_image_has_entry(const uint8_t data[],
+                                           const size_t size,
+                                           const slavery_config_entry_t *entry) {
+	if (!slavery_config_image_has_string(data, size, entry->name) ||
+	    (entry->description != 0 && !slavery_config_image_has_string(data, size, entry->description)) ||
+	    !slavery_config_image_has_array(
+	        size, entry->buttons, entry->num_buttons, sizeof(slavery_config_button_t)) ||
+	    !slavery_config_image_has_array(
+	        size, entry->actions, entry->num_actions, sizeof(slavery_config_action_t)) ||
+	    !slavery_config_image_has_array(size, entry->do_command, entry->num_do_commands, sizeof(uint32_t)) ||
+	    !slavery_config_image_has_array(size, entry->events, entry->num_events, sizeof(struct input_event))) {
+		return false;
+	}
+
+	const uint32_t *do_command = (const uint32_t *)(data + entry->do_command);
+
+	for (size_t i = 0; i < entry->num_do_commands; i++) {
+		if (!slavery_config_image_has_command(data, size, do_command[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool slavery_config_image_validate(const uint8_t data[],
+                                          const size_t size,
+                                          const struct stat *source) {
+	const slavery_config_header_t *header = (const slavery_config_header_t *)data;
+
+	if (size < sizeof(slavery_config_header_t) || memcmp(header->magic, SLAVERY_CONFIG_MAGIC, 8) != 0 ||
+	    header->version != SLAVERY_CONFIG_VERSION || header->size != size) {
+		log_debug("compiled config has an unsupported format");
+
+		return false;
+	}
+
+	if (source != NULL && (header->source_size != (uint64_t)source->st_size ||
+	                       header->source_mtime_ns != slavery_config_time_ns(&source->st_mtim) ||
+	                       header->source_ino != (uint64_t)source->st_ino ||
+	                       header->source_ctime_ns != slavery_config_time_ns(&source->st_ctim))) {
+		log_debug("compiled config is stale");
+
+		return false;
+	}
+
+	const size_t header_size = sizeof(slavery_config_header_t);
+
+	if (slavery_config_checksum(data + header_size, size - header_size) != header->checksum) {
+		log_warning(SLAVERY_ERROR_CONFIG, "compiled config checksum mismatch");
+
+		return false;
+	}
 
+	// A checksum only catches damage, so every reference is checked before anything is read through it.
+	if (!slavery_config_image_has_array(
+	        size, header->entries, header->num_entries, sizeof(slavery_config_entry_t)) ||
+	    !slavery_config_image_has_array(size, header->keys, header->num_keys, sizeof(uint16_t)) ||
+	    !slavery_config_image_has_array(size, header->rels, header->num_rels, sizeof(uint16_t))) {
+		log_warning(SLAVERY_ERROR_CONFIG, "compiled config is truncated");
+
+		return false;
+	}
+
+	const slavery_config_entry_t *entries = (const slavery_config_entry_t *)(data + header->entries);
+
+	for (size_t i = 0; i < header->num_entries; i++) {
+		if (!slavery_config_image_has_entry(data, size, &entries[i])) {
+			log_warning(SLAVERY_ERROR_CONFIG, "compiled config entry %zu is out of bounds", i);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static slavery_config_t *slavery_config_from_image(const uint8_t data[],
+                                                   const size_t size,
+                                                   const bool mapped) {
+	const slavery_config_header_t *header = (const slavery_config_header_t *)data;
+	slavery_config_t *config = malloc(sizeof(slavery_config_t));
+
+	config->data = data;
+	config->size = size;
+	config->mapped = mapped;
+	config->num_entries = header->num_entries;
+	config->entries = (const slavery_config_entry_t *)(data + header->entries);
+	config->caps = (slavery_virtual_input_caps_t){.name = PROJECT_NAME " virtual input",
+	                                               .num_keys = header->num_keys,
+	                                               .keys = (const uint16_t *)(data + header->keys),
+	                                               .num_rels = header->num_rels,
+	                                               .rels = (const uint16_t *)(data + header->rels)};
+
+	log_debug("loaded config with %zu entries, needing %zu keys and %zu axes",
+	          config->num_entries,
+	          config->caps.num_keys,
+	          config->caps.num_rels);
+
+	return config;
+}
+
+static slavery_config_t *slavery_config_map(const char *path, const struct stat *source) {
+	struct stat st;
+	uint8_t *data;
 	int fd;
-	char *json;
-	struct stat stat;
-	json_object *obj;
-	slavery_config_t *config;
-	slavery_config_entry_t *entry;
 
-	if ((fd = open(path, O_RDONLY)) < 0) {
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		log_debug("no compiled config at %s", path);
+
 		return NULL;
 	}
 
-	if (fstat(fd, &stat) < 0) {
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(slavery_config_header_t) ||
+	    (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+
 		return NULL;
 	}
 
-	if ((json = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == NULL) {
+	close(fd);
+
+	if (!slavery_config_image_validate(data, st.st_size, source)) {
+		munmap(data, st.st_size);
+
+		return NULL;
+	}
+
+	return slavery_config_from_image(data, st.st_size, true);
+}
+
+static uint8_t *slavery_config_parse_json(const char *path, const struct stat *source, size_t *size) {
+	log_debug("parsing config file %s", path);
+
+	slavery_config_source_entry_t **source_entries = NULL;
+	slavery_config_source_entry_t *source_entry;
+	size_t num_entries = 0;
+	json_object *obj;
+	uint8_t *data;
+	char *json;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_CONFIG, "failed to open config file %s", path);
+
 		return NULL;
 	}
 
-	if ((obj = json_tokener_parse(json)) == NULL) {
+	if (source->st_size == 0 ||
+	    (json = mmap(NULL, source->st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		log_warning_errno(SLAVERY_ERROR_CONFIG, "failed to map config file %s", path);
+
+		close(fd);
+
 		return NULL;
 	}
 
-	config = malloc(sizeof(slavery_config_t));
-	config->num_entries = 0;
+	close(fd);
+
+	// The mapping isn't NUL terminated, so the parser is given its length.
+	json_tokener *tokener = json_tokener_new();
+	obj = json_tokener_parse_ex(tokener, json, source->st_size);
+
+	json_tokener_free(tokener);
+	munmap(json, source->st_size);
+
+	if (obj == NULL) {
+		log_warning(SLAVERY_ERROR_CONFIG, "failed to parse config file %s", path);
+
+		return NULL;
+	}
 
 	json_object_object_foreach(obj, name, value) {
-		if ((entry = slavery_config_entry_parse(name, value)) == NULL) {
+		if ((source_entry = slavery_config_source_entry_parse(name, value)) == NULL) {
 			log_warning(SLAVERY_ERROR_CONFIG, "ignoring config entry %s", name);
 
 			continue;
 		}
 
-		config->entries =
-		    realloc(config->entries, sizeof(slavery_config_entry_t *) * config->num_entries + 1);
-		config->entries[config->num_entries++] = entry;
+		source_entries = realloc(source_entries, sizeof(slavery_config_source_entry_t *) * (num_entries + 1));
+		source_entries[num_entries++] = source_entry;
 	}
 
-	log_debug("parsed %u config entries", config->num_entries);
+	json_object_put(obj);
 
-	return config;
+	data = slavery_config_image_build(source_entries, num_entries, source, size);
+
+	for (size_t i = 0; i < num_entries; i++) {
+		slavery_config_source_entry_free(source_entries[i]);
+	}
+
+	free(source_entries);
+
+	log_debug("compiled %zu config entries into %zu bytes", num_entries, *size);
+
+	return data;
+}
+
+static int slavery_config_write(const char *path, const uint8_t data[], const size_t size) {
+	char *parent = strdup(path);
+	char *tmp_path = NULL;
+	int fd;
+
+	for (char *slash = strchr(parent + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+
+		if (mkdir(parent, 0700) < 0 && errno != EEXIST) {
+			log_warning_errno(SLAVERY_ERROR_IO, "mkdir() failed");
+
+			free(parent);
+
+			return -1;
+		}
+
+		*slash = '/';
+	}
+
+	free(parent);
+
+	// Write a new file and rename it into place, so a reader never maps a half written config.
+	asprintf(&tmp_path, "%s.tmp", path);
+
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "open() failed");
+
+		free(tmp_path);
+
+		return -1;
+	}
+
+	if (write(fd, data, size) != (ssize_t)size) {
+		log_warning_errno(SLAVERY_ERROR_IO, "write() failed");
+
+		close(fd);
+		unlink(tmp_path);
+		free(tmp_path);
+
+		return -1;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path, path) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "rename() failed");
+
+		unlink(tmp_path);
+		free(tmp_path);
+
+		return -1;
+	}
+
+	free(tmp_path);
+
+	return 0;
+}
+
+int slavery_config_compile(const char *path, const char *output_path) {
+	char *compiled_path = output_path != NULL ? strdup(output_path) : slavery_config_compiled_path(path);
+	struct stat source;
+	uint8_t *data;
+	size_t size;
+	int result;
+
+	if (compiled_path == NULL) {
+		log_warning(SLAVERY_ERROR_CONFIG, "no output path for compiled config");
+
+		return -1;
+	}
+
+	if (stat(path, &source) < 0) {
+		log_warning_errno(SLAVERY_ERROR_CONFIG, "failed to stat config file %s", path);
+
+		free(compiled_path);
+
+		return -1;
+	}
+
+	if ((data = slavery_config_parse_json(path, &source, &size)) == NULL) {
+		free(compiled_path);
+
+		return -1;
+	}
+
+	if ((result = slavery_config_write(compiled_path, data, size)) == 0) {
+		log_debug("wrote compiled config to %s", compiled_path);
+	}
+
+	free(compiled_path);
+	free(data);
+
+	return result;
+}
+
+slavery_config_t *slavery_config_new(const char *path) {
+	char magic[sizeof(((slavery_config_header_t *)NULL)->magic)];
+	slavery_config_t *config;
+	struct stat source;
+	uint8_t *data;
+	size_t size;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0 || fstat(fd, &source) < 0) {
+		log_warning_errno(SLAVERY_ERROR_CONFIG, "failed to open config file %s", path);
+
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		return NULL;
+	}
+
+	bool compiled = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+	                memcmp(magic, SLAVERY_CONFIG_MAGIC, sizeof(magic)) == 0;
+
+	close(fd);
+
+	// A compiled config is used as it is, there is no JSON to check it against.
+	if (compiled) {
+		return slavery_config_map(path, NULL);
+	}
+
+	char *compiled_path = slavery_config_compiled_path(path);
+
+	if (compiled_path != NULL && (config = slavery_config_map(compiled_path, &source)) != NULL) {
+		free(compiled_path);
+
+		return config;
+	}
+
+	if ((data = slavery_config_parse_json(path, &source, &size)) == NULL) {
+		free(compiled_path);
+
+		return NULL;
+	}
+
+	// Failing to save only means the next load parses the JSON again.
+	if (compiled_path != NULL && slavery_config_write(compiled_path, data, size) < 0) {
+		log_debug("failed to save compiled config to %s", compiled_path);
+	}
+
+	free(compiled_path);
+
+	return slavery_config_from_image(data, size, false);
 }
 
 void slavery_config_free(slavery_config_t *config) {
-	UNUSED(config);
+	log_debug("freeing config at %p", config);
+
+	if (config->mapped) {
+		munmap((void *)config->data, config->size);
+	} else {
+		free((void *)config->data);
+	}
+
+	free(config);
+}
+
+const char *slavery_config_entry_get_name(const slavery_config_t *config,
+                                          const slavery_config_entry_t *entry) {
+	return (const char *)config->data + entry->name;
+}
+
+const slavery_config_button_t *slavery_config_entry_get_buttons(const slavery_config_t *config,
+                                                                const slavery_config_entry_t *entry) {
+	return (const slavery_config_button_t *)(config->data + entry->buttons);
+}
+
+const slavery_config_action_t *slavery_config_entry_get_actions(const slavery_config_t *config,
+                                                                const slavery_config_entry_t *entry) {
+	return (const slavery_config_action_t *)(config->data + entry->actions);
+}
+
+const slavery_config_command_t *slavery_config_entry_get_do_command(const slavery_config_t *config,
+                                                                   const slavery_config_entry_t *entry,
+                                                                   const size_t index) {
+	return (const slavery_config_command_t *)(config->data +
+	                                          ((const uint32_t *)(config->data + entry->do_command))[index]);
+}
+
+const struct input_event *slavery_config_entry_get_events(const slavery_config_t *config,
+                                                          const slavery_config_entry_t *entry) {
+	return (const struct input_event *)(config->data + entry->events);
 }
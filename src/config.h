@@ -10,8 +10,14 @@
 
 #pragma once
 
+#include "button.h"
+#include "virtual_input.h"
+
+#include <linux/input.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #define ACTION_MAP(ACTION)                                       \
@@ -63,14 +69,138 @@ slavery_config_action_t slavery_config_string_to_action(const char *action) {
 #undef ACTION_MAP
 }
 
+#define KEYBOARD_MAP(KEY)                  \
+	KEY("ctrl", KEY_LEFTCTRL)              \
+	KEY("shift", KEY_LEFTSHIFT)            \
+	KEY("alt", KEY_LEFTALT)                \
+	KEY("super", KEY_LEFTMETA)             \
+	KEY("right_ctrl", KEY_RIGHTCTRL)       \
+	KEY("right_shift", KEY_RIGHTSHIFT)     \
+	KEY("right_alt", KEY_RIGHTALT)         \
+	KEY("right_super", KEY_RIGHTMETA)      \
+	KEY("esc", KEY_ESC)                    \
+	KEY("tab", KEY_TAB)                    \
+	KEY("enter", KEY_ENTER)                \
+	KEY("space", KEY_SPACE)                \
+	KEY("backspace", KEY_BACKSPACE)        \
+	KEY("delete", KEY_DELETE)              \
+	KEY("insert", KEY_INSERT)              \
+	KEY("home", KEY_HOME)                  \
+	KEY("end", KEY_END)                    \
+	KEY("page_up", KEY_PAGEUP)             \
+	KEY("page_down", KEY_PAGEDOWN)         \
+	KEY("up", KEY_UP)                      \
+	KEY("down", KEY_DOWN)                  \
+	KEY("left", KEY_LEFT)                  \
+	KEY("right", KEY_RIGHT)                \
+	KEY("minus", KEY_MINUS)                \
+	KEY("equal", KEY_EQUAL)                \
+	KEY("print", KEY_SYSRQ)                \
+	KEY("a", KEY_A)                        \
+	KEY("b", KEY_B)                        \
+	KEY("c", KEY_C)                        \
+	KEY("d", KEY_D)                        \
+	KEY("e", KEY_E)                        \
+	KEY("f", KEY_F)                        \
+	KEY("g", KEY_G)                        \
+	KEY("h", KEY_H)                        \
+	KEY("i", KEY_I)                        \
+	KEY("j", KEY_J)                        \
+	KEY("k", KEY_K)                        \
+	KEY("l", KEY_L)                        \
+	KEY("m", KEY_M)                        \
+	KEY("n", KEY_N)                        \
+	KEY("o", KEY_O)                        \
+	KEY("p", KEY_P)                        \
+	KEY("q", KEY_Q)                        \
+	KEY("r", KEY_R)                        \
+	KEY("s", KEY_S)                        \
+	KEY("t", KEY_T)                        \
+	KEY("u", KEY_U)                        \
+	KEY("v", KEY_V)                        \
+	KEY("w", KEY_W)                        \
+	KEY("x", KEY_X)                        \
+	KEY("y", KEY_Y)                        \
+	KEY("z", KEY_Z)                        \
+	KEY("0", KEY_0)                        \
+	KEY("1", KEY_1)                        \
+	KEY("2", KEY_2)                        \
+	KEY("3", KEY_3)                        \
+	KEY("4", KEY_4)                        \
+	KEY("5", KEY_5)                        \
+	KEY("6", KEY_6)                        \
+	KEY("7", KEY_7)                        \
+	KEY("8", KEY_8)                        \
+	KEY("9", KEY_9)                        \
+	KEY("f1", KEY_F1)                      \
+	KEY("f2", KEY_F2)                      \
+	KEY("f3", KEY_F3)                      \
+	KEY("f4", KEY_F4)                      \
+	KEY("f5", KEY_F5)                      \
+	KEY("f6", KEY_F6)                      \
+	KEY("f7", KEY_F7)                      \
+	KEY("f8", KEY_F8)                      \
+	KEY("f9", KEY_F9)                      \
+	KEY("f10", KEY_F10)                    \
+	KEY("f11", KEY_F11)                    \
+	KEY("f12", KEY_F12)                    \
+	KEY("mute", KEY_MUTE)                  \
+	KEY("volume_down", KEY_VOLUMEDOWN)     \
+	KEY("volume_up", KEY_VOLUMEUP)         \
+	KEY("play_pause", KEY_PLAYPAUSE)       \
+	KEY("next_song", KEY_NEXTSONG)         \
+	KEY("previous_song", KEY_PREVIOUSSONG) \
+	KEY("zoom_in", KEY_ZOOMIN)             \
+	KEY("zoom_out", KEY_ZOOMOUT)
+
+#define MOUSE_MAP(MOUSE)                         \
+	MOUSE("left", EV_KEY, BTN_LEFT, 1)           \
+	MOUSE("right", EV_KEY, BTN_RIGHT, 1)         \
+	MOUSE("middle", EV_KEY, BTN_MIDDLE, 1)       \
+	MOUSE("back", EV_KEY, BTN_SIDE, 1)           \
+	MOUSE("forward", EV_KEY, BTN_EXTRA, 1)       \
+	MOUSE("scroll_up", EV_REL, REL_WHEEL, 1)     \
+	MOUSE("scroll_down", EV_REL, REL_WHEEL, -1)  \
+	MOUSE("scroll_left", EV_REL, REL_HWHEEL, -1) \
+	MOUSE("scroll_right", EV_REL, REL_HWHEEL, 1)
+
+#define SLAVERY_CONFIG_MAGIC "SLVCONF"
+#define SLAVERY_CONFIG_VERSION 3
+
 typedef struct json_object json_object;
 typedef struct array_list array_list;
 
 typedef struct slavery_config_button_t {
-	int x;
+	slavery_cid_t cid;
 } slavery_config_button_t;
 
-typedef struct slavery_config_entry_t {
+/**
+ * @brief An entry's do_keyboard and do_mouse values, resolved to evdev events when the config is compiled.
+ *
+ * Keys and buttons are pressed in the order listed and released in reverse, each half closed by a
+ * SYN_REPORT, so triggering an entry is a single write of events.
+ */
+typedef struct slavery_config_output_t {
+	size_t num_events;
+	struct input_event *events;
+} slavery_config_output_t;
+
+/**
+ * @brief A do_command split into its arguments when the config is compiled.
+ *
+ * args holds argc NUL terminated arguments back to back, size bytes in all, so a command can be handed to the
+ * launcher as it is, without being parsed or copied when it runs.
+ */
+typedef struct slavery_config_command_t {
+	uint32_t argc;
+	uint32_t size;
+	char args[];
+} slavery_config_command_t;
+
+/**
+ * @brief A config entry as parsed from JSON, before it is compiled.
+ */
+typedef struct slavery_config_source_entry_t {
 	char *name;
 	char *description;
 	size_t num_buttons;
@@ -82,17 +212,92 @@ typedef struct slavery_config_entry_t {
 	bool do_default;
 	size_t num_do_commands;
 	char **do_command;
-	size_t num_do_keyboard;
-	char **do_keyboard;
-	size_t num_do_mouse;
-	char **do_mouse;
+	slavery_config_output_t output;
+} slavery_config_source_entry_t;
+
+/**
+ * @brief Start of a compiled config image. Everything is in host byte order, and every reference is an
+ * offset from the start of the image, so it can be used wherever it is mapped.
+ *
+ * The checksum covers everything after the header. Images compiled from JSON record the source file's size,
+ * inode, and modification and change times, and are rebuilt once they no longer match. The change time can't
+ * be set back, so an edit is noticed even if it keeps the size and restores the modification time.
+ */
+typedef struct slavery_config_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_entries;
+	uint64_t size;
+	uint64_t checksum;
+	uint64_t source_size;
+	int64_t source_mtime_ns;
+	uint64_t source_ino;
+	int64_t source_ctime_ns;
+	uint32_t entries;
+	uint32_t num_keys;
+	uint32_t keys;
+	uint32_t num_rels;
+	uint32_t rels;
+	uint32_t reserved;
+} slavery_config_header_t;
+
+/**
+ * @brief A compiled config entry. Strings are NUL terminated, and an offset of 0 means the value is absent.
+ */
+typedef struct slavery_config_entry_t {
+	uint32_t name;
+	uint32_t description;
+	uint32_t num_buttons;
+	uint32_t buttons;
+	uint32_t num_actions;
+	uint32_t actions;
+	uint32_t num_do_commands;
+	uint32_t do_command;
+	uint32_t num_events;
+	uint32_t events;
+	bool enabled;
+	bool inhibit_cursor;
+	bool do_default;
 } slavery_config_entry_t;
 
+/**
+ * @brief A loaded config, read in place from its compiled image.
+ *
+ * caps holds exactly the key and axis codes used by any entry's output, so a virtual device can be created
+ * with no more capabilities than it needs.
+ */
 typedef struct slavery_config_t {
+	const uint8_t *data;
+	size_t size;
+	bool mapped;
 	size_t num_entries;
-	slavery_config_entry_t **entries;
+	const slavery_config_entry_t *entries;
+	slavery_virtual_input_caps_t caps;
 } slavery_config_t;
 
 slavery_config_t *slavery_config_new(const char *path);
 void slavery_config_free(slavery_config_t *config);
-slavery_config_entry_t *slavery_config_entry_parse(const char *name, const json_object *obj);
+int slavery_config_compile(const char *path, const char *output_path);
+const char *slavery_config_entry_get_name(const slavery_config_t *config,
+                                          const slavery_config_entry_t *entry);
+const slavery_config_button_t *slavery_config_entry_get_buttons(const slavery_config_t *config,
+                                                                const slavery_config_entry_t *entry);
+const slavery_config_action_t *slavery_config_entry_get_actions(const slavery_config_t *config,
+                                                                const slavery_config_entry_t *entry);
+const slavery_config_command_t *slavery_config_entry_get_do_command(const slavery_config_t *config,
+                                                                   const slavery_config_entry_t *entry,
+                                                                   const size_t index);
+const struct input_event *slavery_config_entry_get_events(const slavery_config_t *config,
+                                                          const slavery_config_entry_t *entry);
+ssize_t slavery_config_command_split(const char *command, char args[], uint32_t *argc);
+slavery_config_source_entry_t *slavery_config_source_entry_parse(const char *name, const json_object *obj);
+void slavery_config_source_entry_free(slavery_config_source_entry_t *source_entry);
+uint8_t *slavery_config_image_build(slavery_config_source_entry_t *source_entries[],
+                                    const size_t num_entries,
+                                    const struct stat *source,
+                                    size_t *size);
+int slavery_config_output_compile(slavery_config_output_t *output,
+                                  char *keyboard[],
+                                  const size_t num_keyboard,
+                                  char *mouse[],
+                                  const size_t num_mouse);
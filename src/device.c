@@ -13,11 +13,15 @@
 #include "device.h"
 
 #include "button.h"
+#include "chord.h"
 #include "feature.h"
 #include "function.h"
+#include "libslavery_p.h"
+#include "pool.h"
 #include "receiver.h"
 #include "utils.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,124 +47,280 @@ void slavery_device_free(slavery_device_t *device) {
 		free(device->buttons[i]);
 	}
 
-	for (size_t i = 0; i < device->num_features; i++) {
-		free(device->features[i]);
+	free(device->buttons);
+
+	slavery_timer_cancel(&device->receiver->timers, &device->tap.timer);
+
+	if (atomic_load(&device->chords) != NULL) {
+		slavery_chord_table_free(atomic_load(&device->chords));
 	}
 
-	free(device->buttons);
-	free(device->features);
 	free(device);
 }
 
+void slavery_device_get_request_stats(slavery_device_t *device, slavery_request_stats_t *stats) {
+	slavery_request_table_get_stats(&device->receiver->requests, device->index, stats);
+}
+
 int slavery_device_set_config(slavery_device_t *device, const slavery_config_t *config) {
-	UNUSED(device);
-	UNUSED(config);
+	// Configs are applied per context, under its lock, so one device can't be configured on its own.
+	return slavery_set_config(device->receiver->slavery, (slavery_config_t *)config);
+}
+
+slavery_chord_table_t *slavery_device_swap_config(slavery_device_t *device, const slavery_config_t *config) {
+	log_debug("compiling config for device %s:%u", device->receiver->devnode, device->index);
+
+	slavery_chord_table_t *chords = config != NULL ? slavery_chord_table_new(device, config) : NULL;
+
+	// Workers may still be reading the old table, so it is handed back rather than freed.
+	return atomic_exchange(&device->chords, chords);
+}
+
+static int slavery_device_send_diversion(slavery_device_t *device) {
+	const slavery_chord_table_t *chords = atomic_load(&device->chords);
+	uint8_t request_data[SLAVERY_DEVICE_CHORD_BITS][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t response_data[SLAVERY_DEVICE_CHORD_BITS][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	ssize_t feature_index = slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_CONTROLS_V4);
+	uint32_t diverted = 0;
+	uint32_t raw_xy = 0;
+	size_t num_requests = 0;
+
+	// Report bits are seen without diverting, so only the controls above them need it. Motion is diverted
+	// for controls with gesture rules, which the device only does while the control is held, so ordinary
+	// cursor movement never leaves the mouse's own path.
+	if (chords != NULL) {
+		diverted = chords->buttons & ~((1u << SLAVERY_DEVICE_BUTTON_BITS) - 1);
+		raw_xy = chords->gestures & diverted;
+	}
+
+	for (size_t bit = SLAVERY_DEVICE_BUTTON_BITS; bit < SLAVERY_DEVICE_CHORD_BITS; bit++) {
+		slavery_button_t *button = device->button_bits[bit];
+
+		if (button == NULL || !button->gesture) {
+			raw_xy &= ~(1u << bit);
+		}
+
+		uint32_t changed = (diverted ^ device->diverted) | (raw_xy ^ device->raw_xy);
+
+		if (button == NULL || (changed & (1u << bit)) == 0) {
+			continue;
+		}
+
+		memset(request_data[num_requests], 0, SLAVERY_PACKET_LENGTH_CONTROL_LONG);
+		request_data[num_requests][0] = SLAVERY_REPORT_ID_CONTROL_LONG;
+		request_data[num_requests][1] = device->index;
+		request_data[num_requests][2] = feature_index;
+		request_data[num_requests][3] =
+		    slavery_function_encode(SLAVERY_FUNCTION_CONTROLS_V4_SET_CID_REPORT_INFO);
+		request_data[num_requests][4] = button->cid >> 8;
+		request_data[num_requests][5] = button->cid & 0xff;
+		request_data[num_requests][6] =
+		    SLAVERY_CONTROLS_V4_REPORT_DIVERT_VALID | SLAVERY_CONTROLS_V4_REPORT_RAW_XY_VALID |
+		    (diverted & (1u << bit) ? SLAVERY_CONTROLS_V4_REPORT_DIVERT : 0) |
+		    (raw_xy & (1u << bit) ? SLAVERY_CONTROLS_V4_REPORT_RAW_XY : 0);
+		num_requests++;
+	}
+
+	if (num_requests == 0) {
+		return 0;
+	}
+
+	log_debug("changing diversion of %zu controls on device %s:%u",
+	          num_requests,
+	          device->receiver->devnode,
+	          device->index);
+
+	if (feature_index < 0 || slavery_receiver_request_batch(device->receiver,
+	                                                        num_requests,
+	                                                        request_data,
+	                                                        SLAVERY_PACKET_LENGTH_CONTROL_LONG,
+	                                                        response_data) < 0) {
+		log_warning(SLAVERY_ERROR_HIDPP, "failed to divert controls on device %u", device->index);
+
+		return -1;
+	}
+
+	device->diverted = diverted;
+	device->raw_xy = raw_xy;
 
 	return 0;
 }
 
-ssize_t slavery_device_get_features(slavery_device_t *device) {
-	log_debug("getting features for device %s:%u...", device->receiver->devnode, device->index);
-	log_debug("checking if device exists");
+int slavery_device_update_diversion(slavery_device_t *device) {
+	pthread_mutex_lock(&device->receiver->slavery->diversion_mutex);
+
+	int result = slavery_device_send_diversion(device);
+
+	pthread_mutex_unlock(&device->receiver->slavery->diversion_mutex);
+
+	return result;
+}
 
-	device->features = NULL;
-	device->num_features = 0;
-	slavery_feature_t *feature;
+int slavery_device_reset_diversion(slavery_device_t *device) {
+	log_debug("diverting controls on device %s:%u again", device->receiver->devnode, device->index);
 
-	// Get root feature, which we already know the details of, but lets do it for completeness.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_ROOT)) == NULL) {
-		log_debug("couldn't get root feature for device %s:%u", device->receiver->devnode, device->index);
+	pthread_mutex_lock(&device->receiver->slavery->diversion_mutex);
+
+	// Diversion doesn't survive the device losing its link, so everything the rules need is sent again.
+	device->diverted = 0;
+	device->raw_xy = 0;
+
+	int result = slavery_device_send_diversion(device);
+
+	pthread_mutex_unlock(&device->receiver->slavery->diversion_mutex);
+
+	return result;
+}
+
+static const uint16_t slavery_device_known_feature_ids[] = {
+#define FEATURE_ID(feature_id_id, feature_id_value, feature_id_string) feature_id_id,
+#define FEATURE_ID_UNKNOWN(feature_id_id, feature_id_string)
+    FEATURE_ID_MAP(FEATURE_ID)
+#undef FEATURE_ID
+#undef FEATURE_ID_UNKNOWN
+};
+
+static ssize_t slavery_device_get_known_features(slavery_device_t *device) {
+	size_t num_requests =
+	    sizeof(slavery_device_known_feature_ids) / sizeof(slavery_device_known_feature_ids[0]);
+	uint8_t request_data[num_requests][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t response_data[num_requests][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+
+	log_debug("looking up %lu known features on device %s:%u",
+	          num_requests,
+	          device->receiver->devnode,
+	          device->index);
+
+	for (size_t i = 0; i < num_requests; i++) {
+		memset(request_data[i], 0, SLAVERY_PACKET_LENGTH_CONTROL_SHORT);
+		request_data[i][0] = SLAVERY_REPORT_ID_CONTROL_SHORT;
+		request_data[i][1] = device->index;
+		request_data[i][2] = SLAVERY_FEATURE_INDEX_ROOT;
+		request_data[i][3] = slavery_function_encode(SLAVERY_FUNCTION_ROOT_GET_FEATURE_INDEX);
+		request_data[i][4] = slavery_device_known_feature_ids[i] >> 8;
+		request_data[i][5] = slavery_device_known_feature_ids[i] & 0xff;
+	}
+
+	if (slavery_receiver_request_batch(device->receiver,
+	                                   num_requests,
+	                                   request_data,
+	                                   SLAVERY_PACKET_LENGTH_CONTROL_SHORT,
+	                                   response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request feature indexes");
 
 		return -1;
 	}
 
-	device->features = realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-	device->features[device->num_features++] = feature;
-
-	// Get feature set feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_FEATURE_SET)) == NULL) {
-		log_debug(
-		    "couldn't get feature set feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get firmware feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_FIRMWARE)) == NULL) {
-		log_debug("couldn't get firmware feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get name feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_NAME_TYPE)) == NULL) {
-		log_debug("couldn't get name feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get reset feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_RESET)) == NULL) {
-		log_debug("couldn't get reset feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get crypto feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_CRYPTO)) == NULL) {
-		log_debug("couldn't get crypto feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get battery feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_BATTERY)) == NULL) {
-		log_debug("couldn't get battery feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get host feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_HOST)) == NULL) {
-		log_debug("couldn't get host feature for device %s:%u", device->receiver->devnode, device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
-	}
-
-	// Get controls v4 feature.
-	if ((feature = slavery_device_get_feature(device, SLAVERY_FEATURE_ID_CONTROLS_V4)) == NULL) {
-		log_debug("couldn't get controls v4 set feature for device %s:%u",
+	for (size_t i = 0; i < num_requests; i++) {
+		// An index of 0 means the device doesn't have the feature.
+		if (response_data[i][4] != SLAVERY_FEATURE_INDEX_ROOT) {
+			slavery_feature_table_insert(&device->features,
+			                             &(slavery_feature_t){.id = slavery_device_known_feature_ids[i],
+			                                                  .index = response_data[i][4],
+			                                                  .flags = response_data[i][5],
+			                                                  .version = response_data[i][6]});
+		}
+	}
+
+	return device->features.num_features;
+}
+
+ssize_t slavery_device_get_features(slavery_device_t *device) {
+	log_debug("getting features for device %s:%u...", device->receiver->devnode, device->index);
+
+	slavery_feature_t feature_set;
+	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+
+	slavery_feature_table_init(&device->features);
+
+	// Looking up the feature set feature doubles as the check that a device is connected at this index.
+	if (slavery_device_get_feature(device, SLAVERY_FEATURE_ID_FEATURE_SET, &feature_set) < 0) {
+		if (errno != ENOENT) {
+			log_debug("no device at %s:%u", device->receiver->devnode, device->index);
+
+			return -1;
+		}
+
+		log_debug("couldn't get feature set feature for device %s:%u, looking up known features instead",
 		          device->receiver->devnode,
 		          device->index);
-	} else {
-		device->features =
-		    realloc(device->features, sizeof(slavery_feature_t *) * (device->num_features + 1));
-		device->features[device->num_features++] = feature;
+
+		return slavery_device_get_known_features(device);
+	}
+
+	slavery_feature_table_insert(&device->features, &feature_set);
+
+	uint8_t request_data[] = {SLAVERY_REPORT_ID_CONTROL_SHORT,
+	                          device->index,
+	                          feature_set.index,
+	                          slavery_function_encode(SLAVERY_FUNCTION_FEATURE_SET_GET_COUNT),
+	                          0x00,
+	                          0x00,
+	                          0x00};
+
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request feature count");
+
+		return slavery_device_get_known_features(device);
+	}
+
+	// The count excludes the root feature, so feature indexes run from 1 to count inclusive.
+	size_t num_features = response_data[4];
+
+	if (num_features >= SLAVERY_FEATURE_INDEX_ERROR_HIDPP20) {
+		num_features = SLAVERY_FEATURE_INDEX_ERROR_HIDPP20 - 1;
+	}
+
+	if (num_features == 0) {
+		return device->features.num_features;
+	}
+
+	uint8_t id_request_data[num_features][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t id_response_data[num_features][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+
+	for (size_t i = 0; i < num_features; i++) {
+		memcpy(id_request_data[i], request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT);
+		id_request_data[i][3] = slavery_function_encode(SLAVERY_FUNCTION_FEATURE_SET_GET_FEATURE_ID);
+		id_request_data[i][4] = i + 1;
+	}
+
+	if (slavery_receiver_request_batch(device->receiver,
+	                                   num_features,
+	                                   id_request_data,
+	                                   SLAVERY_PACKET_LENGTH_CONTROL_SHORT,
+	                                   id_response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request feature IDs");
+
+		return slavery_device_get_known_features(device);
+	}
+
+	for (size_t i = 0; i < num_features; i++) {
+		slavery_feature_t feature = {.id = id_response_data[i][4] << 8 | id_response_data[i][5],
+		                             .index = i + 1,
+		                             .flags = id_response_data[i][6],
+		                             .version = id_response_data[i][7]};
+
+		log_debug("feature 0x%04x (%s) at index %u, version %u",
+		          feature.id,
+		          slavery_feature_id_to_string(feature.id),
+		          feature.index,
+		          feature.version);
+
+		slavery_feature_table_insert(&device->features, &feature);
 	}
 
-	log_debug("found %d features for device %s:%u...",
-	          device->num_features,
+	log_debug("found %lu features for device %s:%u...",
+	          device->features.num_features,
 	          device->receiver->devnode,
 	          device->index);
 
-	return device->num_features;
+	return device->features.num_features;
 }
 
-slavery_feature_t *slavery_device_get_feature(slavery_device_t *device, slavery_feature_id_t feature_id) {
+int slavery_device_get_feature(slavery_device_t *device,
+                               const slavery_feature_id_t feature_id,
+                               slavery_feature_t *feature) {
 	log_debug("getting feature information for feature %s", slavery_feature_id_to_string(feature_id));
 
 	uint8_t request_data[] = {SLAVERY_REPORT_ID_CONTROL_SHORT,
@@ -172,27 +332,21 @@ slavery_feature_t *slavery_device_get_feature(slavery_device_t *device, slavery_
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to request feature");
-
-		return NULL;
-	}
-
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_debug("failed to request feature");
 
-		return NULL;
+		return -1;
 	}
 
 	if (response_data[4] == 0x00 && response_data[5] == 0x00 && response_data[6] == 0x00) {
 		log_debug("feature doesn't exist");
 
-		return NULL;
+		errno = ENOENT;
+
+		return -1;
 	}
 
-	slavery_feature_t *feature = malloc(sizeof(slavery_feature_t));
 	feature->id = feature_id;
 	feature->index = response_data[4];
 	feature->flags = response_data[5];
@@ -200,7 +354,44 @@ slavery_feature_t *slavery_device_get_feature(slavery_device_t *device, slavery_
 
 	log_debug("received information for feature %s", slavery_feature_id_to_string(feature_id));
 
-	return feature;
+	return 0;
+}
+
+int slavery_device_get_firmware(slavery_device_t *device) {
+	log_debug("getting firmware version for device %s:%u...", device->receiver->devnode, device->index);
+
+	ssize_t feature_index = slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_FIRMWARE);
+
+	memset(device->firmware, 0, SLAVERY_DEVICE_FIRMWARE_SIZE);
+
+	if (feature_index < 0) {
+		log_debug("device has no firmware feature");
+
+		errno = ENOENT;
+
+		return -1;
+	}
+
+	// Entity 0 is the main application firmware.
+	uint8_t request_data[] = {SLAVERY_REPORT_ID_CONTROL_SHORT,
+	                          device->index,
+	                          feature_index,
+	                          slavery_function_encode(SLAVERY_FUNCTION_FIRMWARE_GET_VERSION),
+	                          0x00,
+	                          0x00,
+	                          0x00};
+	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_debug("failed to request firmware version");
+
+		return -1;
+	}
+
+	memcpy(device->firmware, response_data + 4, SLAVERY_DEVICE_FIRMWARE_SIZE);
+
+	return 0;
 }
 
 const char *slavery_device_get_protocol_version(slavery_device_t *device) {
@@ -216,16 +407,9 @@ const char *slavery_device_get_protocol_version(slavery_device_t *device) {
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to request device protocol");
-
-		return NULL;
-	}
-
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request device protocol");
 
 		return NULL;
 	}
@@ -249,16 +433,9 @@ slavery_device_type_t slavery_device_get_type(slavery_device_t *device) {
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to request type");
-
-		return -1;
-	}
-
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request type");
 
 		return SLAVERY_DEVICE_TYPE_UNKNOWN;
 	}
@@ -282,16 +459,9 @@ const char *slavery_device_get_name(slavery_device_t *device) {
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to request name length");
-
-		return NULL;
-	}
-
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request name length");
 
 		return NULL;
 	}
@@ -299,37 +469,53 @@ const char *slavery_device_get_name(slavery_device_t *device) {
 	log_debug("device name length: %u", response_data[4]);
 
 	uint8_t name_length = response_data[4];
-	char *name = malloc(name_length + 1);
-	char *name_pos = name;
-	request_data[3] = slavery_function_encode(SLAVERY_FUNCTION_NAME_TYPE_GET_NAME);
 
-	log_debug("getting name for device %s:%u...", device->receiver->devnode, device->index);
+	if (name_length == 0) {
+		device->name = strdup("");
 
-	do {
-		if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-		    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-			log_warning_errno(SLAVERY_ERROR_IO, "failed to request name");
+		return device->name;
+	}
 
-			return NULL;
-		}
+	size_t num_chunks = (name_length + 15) / 16;
+	char *name = malloc(name_length + 1);
+	uint8_t chunk_request_data[num_chunks][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t chunk_response_data[num_chunks][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+
+	log_debug("getting name for device %s:%u in %lu chunks...",
+	          device->receiver->devnode,
+	          device->index,
+	          num_chunks);
+
+	// Each chunk is independent, so request them all at once rather than one round trip at a time.
+	for (size_t i = 0; i < num_chunks; i++) {
+		memcpy(chunk_request_data[i], request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT);
+		chunk_request_data[i][3] = slavery_function_encode(SLAVERY_FUNCTION_NAME_TYPE_GET_NAME);
+		chunk_request_data[i][4] = i * 16;
+	}
 
-		if (slavery_receiver_control_read_response(
-		        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-			log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	if (slavery_receiver_request_batch(device->receiver,
+	                                   num_chunks,
+	                                   chunk_request_data,
+	                                   SLAVERY_PACKET_LENGTH_CONTROL_SHORT,
+	                                   chunk_response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request name");
 
-			return NULL;
-		}
+		free(name);
 
-		ssize_t num_bytes = (name + name_length + 1) - name_pos;
+		return NULL;
+	}
+
+	for (size_t i = 0; i < num_chunks; i++) {
+		size_t num_bytes = name_length - i * 16;
 
 		if (num_bytes > 16) {
 			num_bytes = 16;
 		}
 
-		name_pos = stpncpy(name_pos, (const char *)response_data + 4, num_bytes);
-		request_data[4] += num_bytes;
-	} while (request_data[4] < name_length);
+		memcpy(name + i * 16, chunk_response_data[i] + 4, num_bytes);
+	}
 
+	name[name_length] = '\0';
 	device->name = name;
 
 	log_debug("device name: %s", device->name);
@@ -347,23 +533,57 @@ ssize_t slavery_device_get_num_buttons(slavery_device_t *device) {
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to request number of buttons");
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request number of buttons");
 
 		return -1;
 	}
 
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	device->num_buttons = response_data[4];
 
-		return -1;
+	return device->num_buttons;
+}
+
+slavery_button_t *slavery_device_parse_button(slavery_device_t *device,
+                                              const uint8_t button_index,
+                                              const uint8_t response_data[]) {
+	slavery_button_t *button;
+
+	button = malloc(sizeof(slavery_button_t));
+
+	button->index = button_index;
+	button->device = device;
+	button->cid = (slavery_cid_t)response_data[4] << 8 | response_data[5];
+	button->task_id = (uint16_t)response_data[6] << 8 | response_data[7];
+	button->flags = response_data[8];
+	button->virtual = response_data[8] & 0x80;
+	button->persistent_divert = response_data[8] & 0x40;
+	button->temporary_divert = response_data[8] & 0x20;
+	button->reprogrammable = response_data[8] & 0x10;
+	button->type = (slavery_button_type_t)button->flags & 0x0f;
+	button->function_position = response_data[9];
+	button->group = response_data[10];
+	button->group_remap_mask = response_data[11];
+	button->gesture = response_data[12];
+
+	if (log_enabled(LOG_LEVEL_DEBUG)) {
+		char hex[SLAVERY_PACKET_LENGTH_CONTROL_LONG * 5];
+
+		log_debug("button %u on device %s:%u is CID %#06x, task ID %#06x, flags %#04x, group %u, info %s",
+		          button->index,
+		          device->receiver->devnode,
+		          device->index,
+		          button->cid,
+		          button->task_id,
+		          button->flags,
+		          button->group,
+		          bytes_to_hex(response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG, hex));
 	}
 
-	device->num_buttons = response_data[4];
+	device->buttons[button_index] = button;
 
-	return device->num_buttons;
+	return device->buttons[button_index];
 }
 
 slavery_button_t *slavery_device_get_button(slavery_device_t *device, uint8_t button_index) {
@@ -375,65 +595,98 @@ slavery_button_t *slavery_device_get_button(slavery_device_t *device, uint8_t bu
 	                          0x00,
 	                          0x00};
 	uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG];
-	slavery_button_t *button;
 
-	if (write(device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT) !=
-	    (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+	if (slavery_receiver_request(
+	        device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request button information");
+
 		return NULL;
 	}
 
-	if (slavery_receiver_control_read_response(
-	        device->receiver, response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response from device");
+	return slavery_device_parse_button(device, button_index, response_data);
+}
+
+ssize_t slavery_device_get_buttons(slavery_device_t *device) {
+	log_debug("getting information for %lu buttons on device %s:%u...",
+	          device->num_buttons,
+	          device->receiver->devnode,
+	          device->index);
 
-		return NULL;
+	uint8_t request_data[device->num_buttons][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t response_data[device->num_buttons][SLAVERY_PACKET_LENGTH_CONTROL_LONG];
+	uint8_t feature_index = slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_CONTROLS_V4);
+
+	for (size_t i = 0; i < device->num_buttons; i++) {
+		memset(request_data[i], 0, SLAVERY_PACKET_LENGTH_CONTROL_SHORT);
+		request_data[i][0] = SLAVERY_REPORT_ID_CONTROL_SHORT;
+		request_data[i][1] = device->index;
+		request_data[i][2] = feature_index;
+		request_data[i][3] = slavery_function_encode(SLAVERY_FUNCTION_CONTROLS_V4_GET_BUTTON_INFO);
+		request_data[i][4] = i;
 	}
 
-	button = malloc(sizeof(slavery_button_t));
+	if (slavery_receiver_request_batch(device->receiver,
+	                                   device->num_buttons,
+	                                   request_data,
+	                                   SLAVERY_PACKET_LENGTH_CONTROL_SHORT,
+	                                   response_data) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to request button information");
 
-	printf("get button info: ");
+		return -1;
+	}
 
-	for (size_t i = 0; i < SLAVERY_PACKET_LENGTH_CONTROL_LONG; i++) {
-		printf("%hhx ", response_data[i]);
+	for (size_t i = 0; i < device->num_buttons; i++) {
+		slavery_device_parse_button(device, i, response_data[i]);
 	}
 
-	puts("");
+	return device->num_buttons;
+}
 
-	button->index = button_index;
-	button->device = device;
-	button->cid = (slavery_cid_t)response_data[4] << 8 | response_data[5];
-	button->task_id = (uint16_t)response_data[6] << 8 | response_data[7];
-	button->flags = response_data[8];
-	button->virtual = response_data[8] & 0x80;
-	button->persistent_divert = response_data[8] & 0x40;
-	button->temporary_divert = response_data[8] & 0x20;
-	button->reprogrammable = response_data[8] & 0x10;
-	button->type = (slavery_button_type_t)button->flags & 0x0f;
-	button->function_position = response_data[9];
-	button->group = response_data[10];
-	button->group_remap_mask = response_data[11];
-	button->gesture = response_data[12];
+/**
+ * @brief CIDs reported by each bit of a button event, lowest bit first.
+ */
+static const slavery_cid_t slavery_device_button_bit_cids[] = {SLAVERY_CID_MOUSE_LEFT,
+                                                               SLAVERY_CID_MOUSE_RIGHT,
+                                                               SLAVERY_CID_MOUSE_MIDDLE,
+                                                               SLAVERY_CID_MOUSE_BACK,
+                                                               SLAVERY_CID_MOUSE_FORWARD};
 
-	printf("index: %u\n", button->index);
-	printf("cid: %d\n", button->cid);
-	printf("task id: %u\n", button->task_id);
-	printf("virtual: %d\n", button->virtual);
-	printf("persistent divert: %d\n", button->persistent_divert);
-	printf("temporary divert: %d\n", button->temporary_divert);
-	printf("reprogrammable: %d\n", button->reprogrammable);
-	printf("fn toggle: %d\n", button->type == SLAVERY_BUTTON_TYPE_FUNCTION_TOGGLE);
-	printf("hotkey: %d\n", button->type == SLAVERY_BUTTON_TYPE_HOTKEY);
-	printf("fn: %d\n", button->type == SLAVERY_BUTTON_TYPE_FUNCTION);
-	printf("mouse: %d\n", button->type == SLAVERY_BUTTON_TYPE_BUTTON);
-	printf("fn positon: %d\n", button->function_position);
-	printf("group: %d\n", button->group);
-	printf("group remap mask: %d\n", button->group_remap_mask);
-	printf("gesture: %d\n", button->gesture);
-	puts("");
+void slavery_device_build_button_table(slavery_device_t *device) {
+	size_t diverted_bit = SLAVERY_DEVICE_BUTTON_BITS;
 
-	device->buttons[button_index] = button;
+	for (size_t bit = 0; bit < SLAVERY_DEVICE_CHORD_BITS; bit++) {
+		device->button_bits[bit] = NULL;
 
-	return device->buttons[button_index];
+		if (bit >= sizeof(slavery_device_button_bit_cids) / sizeof(slavery_device_button_bit_cids[0])) {
+			continue;
+		}
+
+		for (size_t i = 0; i < device->num_buttons; i++) {
+			if (device->buttons[i]->cid == slavery_device_button_bit_cids[bit]) {
+				device->button_bits[bit] = device->buttons[i];
+
+				break;
+			}
+		}
+	}
+
+	// Controls without a report bit can only be seen when diverted, so they take the bits above.
+	for (size_t i = 0; i < device->num_buttons && diverted_bit < SLAVERY_DEVICE_CHORD_BITS; i++) {
+		if (device->buttons[i]->temporary_divert &&
+		    slavery_device_cid_to_bit(device, device->buttons[i]->cid) < 0) {
+			device->button_bits[diverted_bit++] = device->buttons[i];
+		}
+	}
+}
+
+ssize_t slavery_device_cid_to_bit(const slavery_device_t *device, const slavery_cid_t cid) {
+	for (size_t bit = 0; bit < SLAVERY_DEVICE_CHORD_BITS; bit++) {
+		if (device->button_bits[bit] != NULL && device->button_bits[bit]->cid == cid) {
+			return bit;
+		}
+	}
+
+	return -1;
 }
 
 /*
@@ -496,19 +749,8 @@ for (size_t i = 0; i < SLAVERY_PACKET_LENGTH_CONTROL_LONG; i++) {
 
 puts("");
 
-if (write(button->device->receiver->fd, request_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG) !=
-	(ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_LONG) {
-	return;
-}
-
-if (read(button->device->receiver->control_pipe[0], response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG)
-!= (ssize_t)SLAVERY_PACKET_LENGTH_CONTROL_LONG) { return;
-}
-
-if (response_data[2] == 0xff) {
-	printf("remap error\n");
-
-	exit(0);
+if (slavery_receiver_request(button->device->receiver, request_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG,
+response_data) < 0) { printf("remap error\n");
 
 	return;
 }
@@ -522,11 +764,5 @@ puts("");
 }
 
 ssize_t slavery_feature_id_to_index(slavery_device_t *device, const uint16_t id) {
-	for (size_t i = 0; i < device->num_features; i++) {
-		if (device->features[i]->id == id) {
-			return device->features[i]->index;
-		}
-	}
-
-	return -1;
+	return slavery_feature_table_find(&device->features, id);
 }
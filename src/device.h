@@ -10,15 +10,20 @@
 
 #pragma once
 
+#include "button.h"
 #include "feature.h"
+#include "timer.h"
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
 
 typedef struct slavery_receiver_t slavery_receiver_t;
 typedef struct slavery_config_t slavery_config_t;
 typedef struct slavery_button_t slavery_button_t;
-typedef struct slavery_feature_t slavery_feature_t;
+typedef struct slavery_request_stats_t slavery_request_stats_t;
+typedef struct slavery_chord_table_t slavery_chord_table_t;
 
 /**
  * @brief Device indexes supported by HID++.
@@ -73,6 +78,57 @@ const char *slavery_device_type_to_string(const slavery_device_type_t device_typ
 	}
 }
 
+/**
+ * @brief Size of the firmware version payload kept for each device.
+ */
+#define SLAVERY_DEVICE_FIRMWARE_SIZE 16
+
+/**
+ * @brief Number of button bits in a button event report.
+ */
+#define SLAVERY_DEVICE_BUTTON_BITS 16
+
+/**
+ * @brief Number of bits in a device's pressed-button mask. Bits above those in button event reports belong
+ * to divertable controls, whose presses arrive as diverted control events instead.
+ */
+#define SLAVERY_DEVICE_CHORD_BITS 32
+
+/**
+ * @brief Stages of telling taps from holds.
+ */
+typedef enum
+{
+	SLAVERY_DEVICE_TAP_IDLE,
+	SLAVERY_DEVICE_TAP_DOWN,
+	SLAVERY_DEVICE_TAP_HELD,
+	SLAVERY_DEVICE_TAP_UP
+} slavery_device_tap_state_t;
+
+/**
+ * @brief Tap and hold tracking for the chord last pressed on a device.
+ *
+ * Only touched by the worker dispatching the device's events, apart from the generation, which the timer
+ * stamps on its expiry so the worker can discard one that was cancelled or re-armed after it fired.
+ */
+typedef struct slavery_device_tap_t {
+	slavery_device_tap_state_t state;
+	uint32_t mask;
+	unsigned int count;
+	bool armed;
+	atomic_uint generation;
+	slavery_timer_t timer;
+} slavery_device_tap_t;
+
+/**
+ * @brief Motion reported while a control with gesture rules is held, summed as it arrives.
+ */
+typedef struct slavery_device_gesture_t {
+	int32_t dx;
+	int32_t dy;
+	bool moved;
+} slavery_device_gesture_t;
+
 /**
  * @brief Describes a compatible device.
  */
@@ -82,21 +138,41 @@ typedef struct slavery_device_t {
 	char *protocol_version;
 	slavery_device_type_t type;
 	char *name;
-	size_t num_features;
-	slavery_feature_t **features;
+	uint8_t firmware[SLAVERY_DEVICE_FIRMWARE_SIZE];
+	slavery_feature_table_t features;
 	size_t num_buttons;
 	slavery_button_t **buttons;
+	slavery_button_t *button_bits[SLAVERY_DEVICE_CHORD_BITS];
+	_Atomic(slavery_chord_table_t *) chords;
+	uint32_t pressed;
+	slavery_device_tap_t tap;
+	slavery_device_gesture_t gesture;
+	uint32_t diverted;
+	uint32_t raw_xy;
 } slavery_device_t;
 
 void slavery_device_array_free(slavery_device_t *devices[], const ssize_t num_devices);
+void slavery_device_get_request_stats(slavery_device_t *device, slavery_request_stats_t *stats);
 int slavery_device_set_config(slavery_device_t *device, const slavery_config_t *config);
+slavery_chord_table_t *slavery_device_swap_config(slavery_device_t *device, const slavery_config_t *config);
+int slavery_device_update_diversion(slavery_device_t *device);
+int slavery_device_reset_diversion(slavery_device_t *device);
 void slavery_device_free(slavery_device_t *device);
 ssize_t slavery_device_get_features(slavery_device_t *device);
-slavery_feature_t *slavery_device_get_feature(slavery_device_t *device, slavery_feature_id_t feature_id);
+int slavery_device_get_feature(slavery_device_t *device,
+                               const slavery_feature_id_t feature_id,
+                               slavery_feature_t *feature);
+int slavery_device_get_firmware(slavery_device_t *device);
 const char *slavery_device_get_protocol_version(slavery_device_t *device);
 slavery_device_type_t slavery_device_get_type(slavery_device_t *device);
 const char *slavery_device_get_name(slavery_device_t *device);
 ssize_t slavery_device_get_num_buttons(slavery_device_t *device);
+slavery_button_t *slavery_device_parse_button(slavery_device_t *device,
+                                              const uint8_t button_index,
+                                              const uint8_t response_data[]);
 slavery_button_t *slavery_device_get_button(slavery_device_t *device, uint8_t button_index);
+ssize_t slavery_device_get_buttons(slavery_device_t *device);
+void slavery_device_build_button_table(slavery_device_t *device);
+ssize_t slavery_device_cid_to_bit(const slavery_device_t *device, const slavery_cid_t cid);
 void slavery_device_remap_button(slavery_device_t *device, slavery_button_t *button);
 ssize_t slavery_feature_id_to_index(slavery_device_t *device, const uint16_t id);
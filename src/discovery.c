@@ -0,0 +1,195 @@
+/**
+ * @file
+ * @brief Receiver discovery implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "discovery.h"
+
+#include "utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <libudev.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAVERY_DISCOVERY_SYSFS_HIDRAW "/sys/class/hidraw"
+
+bool slavery_discovery_match_hid_id(const char *hid_id) {
+	unsigned int bus, vendor_id, product_id;
+
+	// HID_ID is "bus:vendor:product" in hex, e.g. "0003:0000046D:0000C52B".
+	if (hid_id == NULL || sscanf(hid_id, "%x:%x:%x", &bus, &vendor_id, &product_id) != 3) {
+		return false;
+	}
+
+	return vendor_id == SLAVERY_USB_VENDOR_ID_LOGITECH &&
+	       product_id == SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER;
+}
+
+bool slavery_discovery_match_udev_device(struct udev_device *device) {
+	struct udev_device *parent = udev_device_get_parent_with_subsystem_devtype(device, "hid", NULL);
+
+	if (parent == NULL) {
+		return false;
+	}
+
+	return slavery_discovery_match_hid_id(udev_device_get_property_value(parent, "HID_ID"));
+}
+
+static void slavery_discovery_append(char ***devnodes, size_t *num_devnodes, const char *devnode) {
+	*devnodes = realloc(*devnodes, sizeof(char *) * (*num_devnodes + 1));
+	(*devnodes)[(*num_devnodes)++] = strdup(devnode);
+}
+
+ssize_t slavery_discovery_sysfs(char ***devnodes) {
+	DIR *dir;
+	struct dirent *entry;
+	size_t num_devnodes = 0;
+
+	*devnodes = NULL;
+
+	if ((dir = opendir(SLAVERY_DISCOVERY_SYSFS_HIDRAW)) == NULL) {
+		log_warning_errno(SLAVERY_ERROR_IO, "opendir() failed");
+
+		return -1;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		char path[PATH_MAX], line[256], hid_id[64] = "", hid_name[128] = "";
+		FILE *uevent;
+
+		if (strncmp(entry->d_name, "hidraw", 6) != 0) {
+			continue;
+		}
+
+		// The HID device's uevent carries its bus, vendor and product, so nothing has to be opened to filter.
+		snprintf(path, sizeof(path), SLAVERY_DISCOVERY_SYSFS_HIDRAW "/%s/device/uevent", entry->d_name);
+
+		if ((uevent = fopen(path, "re")) == NULL) {
+			log_debug("failed to open %s, ignoring %s", path, entry->d_name);
+
+			continue;
+		}
+
+		while (fgets(line, sizeof(line), uevent) != NULL) {
+			line[strcspn(line, "\n")] = '\0';
+
+			if (strncmp(line, "HID_ID=", 7) == 0) {
+				snprintf(hid_id, sizeof(hid_id), "%s", line + 7);
+			} else if (strncmp(line, "HID_NAME=", 9) == 0) {
+				snprintf(hid_name, sizeof(hid_name), "%s", line + 9);
+			}
+		}
+
+		fclose(uevent);
+
+		if (!slavery_discovery_match_hid_id(hid_id)) {
+			log_debug("ignoring %s (%s, %s)", entry->d_name, hid_id, hid_name);
+
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+
+		log_debug("found receiver candidate %s (%s)", path, hid_name);
+
+		slavery_discovery_append(devnodes, &num_devnodes, path);
+	}
+
+	closedir(dir);
+
+	return num_devnodes;
+}
+
+ssize_t slavery_discovery_udev(char ***devnodes) {
+	struct udev *udev;
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *device_list, *device_entry;
+	size_t num_devnodes = 0;
+
+	*devnodes = NULL;
+
+	if ((udev = udev_new()) == NULL) {
+		log_warning(SLAVERY_ERROR_UDEV, "udev_new() failed");
+
+		return -1;
+	}
+
+	if ((enumerate = udev_enumerate_new(udev)) == NULL) {
+		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_new() failed");
+
+		udev_unref(udev);
+
+		return -1;
+	}
+
+	if (udev_enumerate_add_match_subsystem(enumerate, "hidraw") < 0) {
+		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_add_match_subsystem() failed");
+
+		udev_enumerate_unref(enumerate);
+		udev_unref(udev);
+
+		return -1;
+	}
+
+	if (udev_enumerate_scan_devices(enumerate) < 0) {
+		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_scan_devices() failed");
+
+		udev_enumerate_unref(enumerate);
+		udev_unref(udev);
+
+		return -1;
+	}
+
+	device_list = udev_enumerate_get_list_entry(enumerate);
+
+	udev_list_entry_foreach(device_entry, device_list) {
+		const char *sys_path = udev_list_entry_get_name(device_entry);
+		struct udev_device *device = udev_device_new_from_syspath(udev, sys_path);
+
+		if (device == NULL) {
+			continue;
+		}
+
+		const char *devnode = udev_device_get_devnode(device);
+
+		if (devnode != NULL && slavery_discovery_match_udev_device(device)) {
+			log_debug("found receiver candidate %s", devnode);
+
+			slavery_discovery_append(devnodes, &num_devnodes, devnode);
+		} else {
+			log_debug("ignoring %s", sys_path);
+		}
+
+		udev_device_unref(device);
+	}
+
+	udev_enumerate_unref(enumerate);
+	udev_unref(udev);
+
+	return num_devnodes;
+}
+
+ssize_t slavery_discover(const slavery_discovery_backend_t backend, char ***devnodes) {
+	ssize_t num_devnodes;
+
+	if (backend == SLAVERY_DISCOVERY_SYSFS) {
+		if ((num_devnodes = slavery_discovery_sysfs(devnodes)) >= 0) {
+			return num_devnodes;
+		}
+
+		log_debug("sysfs discovery failed, falling back to udev");
+	}
+
+	return slavery_discovery_udev(devnodes);
+}
@@ -0,0 +1,25 @@
+/**
+ * @file
+ * @brief Receiver discovery functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "libslavery.h"
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+struct udev;
+struct udev_device;
+
+bool slavery_discovery_match_hid_id(const char *hid_id);
+bool slavery_discovery_match_udev_device(struct udev_device *device);
+ssize_t slavery_discovery_sysfs(char ***devnodes);
+ssize_t slavery_discovery_udev(char ***devnodes);
+ssize_t slavery_discover(const slavery_discovery_backend_t backend, char ***devnodes);
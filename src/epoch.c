@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @brief Epoch-based reclamation implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "epoch.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+int slavery_epoch_init(slavery_epoch_t *epoch, const size_t num_records) {
+	atomic_init(&epoch->global, 1);
+	epoch->num_records = num_records;
+
+	if ((epoch->records = aligned_alloc(64, sizeof(slavery_epoch_record_t) * num_records)) == NULL) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < num_records; i++) {
+		atomic_init(&epoch->records[i].active, 0);
+	}
+
+	return 0;
+}
+
+void slavery_epoch_destroy(slavery_epoch_t *epoch) {
+	free(epoch->records);
+}
+
+void slavery_epoch_enter(slavery_epoch_t *epoch, const size_t record) {
+	// Sequentially consistent, so either the writer sees this reader or the reader sees the new pointer.
+	atomic_store(&epoch->records[record].active, atomic_load(&epoch->global));
+}
+
+void slavery_epoch_exit(slavery_epoch_t *epoch, const size_t record) {
+	atomic_store_explicit(&epoch->records[record].active, 0, memory_order_release);
+}
+
+void slavery_epoch_synchronize(slavery_epoch_t *epoch) {
+	uint_least64_t target = atomic_fetch_add(&epoch->global, 1) + 1;
+
+	// Readers that entered before the bump may still hold an old pointer, later ones can't.
+	for (size_t i = 0; i < epoch->num_records; i++) {
+		uint_least64_t active;
+
+		while ((active = atomic_load(&epoch->records[i].active)) != 0 && active < target) {
+			sched_yield();
+		}
+	}
+}
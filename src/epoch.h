@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @brief Epoch-based reclamation functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The epoch a reader entered at, or 0 while it is outside any read-side section.
+ */
+typedef struct slavery_epoch_record_t {
+	_Alignas(64) atomic_uint_least64_t active;
+} slavery_epoch_record_t;
+
+/**
+ * @brief Lets a writer wait until readers can no longer hold pointers it has unpublished.
+ *
+ * Each reader owns one record, so entering and leaving a read-side section is a single store with no shared
+ * cache line written.
+ */
+typedef struct slavery_epoch_t {
+	_Alignas(64) atomic_uint_least64_t global;
+	size_t num_records;
+	slavery_epoch_record_t *records;
+} slavery_epoch_t;
+
+int slavery_epoch_init(slavery_epoch_t *epoch, const size_t num_records);
+void slavery_epoch_destroy(slavery_epoch_t *epoch);
+void slavery_epoch_enter(slavery_epoch_t *epoch, const size_t record);
+void slavery_epoch_exit(slavery_epoch_t *epoch, const size_t record);
+void slavery_epoch_synchronize(slavery_epoch_t *epoch);
@@ -13,59 +13,352 @@
 #include "event.h"
 
 #include "button.h"
+#include "chord.h"
 #include "device.h"
+#include "feature.h"
+#include "function.h"
+#include "libslavery_p.h"
+#include "pool.h"
 #include "receiver.h"
 #include "utils.h"
 
-#include <pthread.h>
-#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void *slavery_event_dispatch(slavery_event_t *event) {
-	if (pthread_setname_np(pthread_self(), "event") != 0) {
-		log_warning(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+#define SLAVERY_EVENT_TIMER_SIZE 6
+
+static void slavery_event_on_tap_timer(slavery_timer_t *timer) {
+	slavery_device_t *device = timer->data;
+	slavery_t *slavery = device->receiver->slavery;
+	slavery_report_t *report = slavery_report_acquire(slavery->reports);
+	uint32_t generation = atomic_load_explicit(&device->tap.generation, memory_order_relaxed);
+
+	// This runs on whichever thread services the receiver, so the expiry is queued to the device's worker
+	// like any other event, keeping the tap state single threaded.
+	if (report == NULL) {
+		log_debug("report pool exhausted, dropping timer for device %u", device->index);
+
+		return;
+	}
+
+	report->receiver = device->receiver;
+	report->size = SLAVERY_EVENT_TIMER_SIZE;
+	report->data[0] = SLAVERY_REPORT_ID_TIMER;
+	report->data[1] = device->index;
+	memcpy(&report->data[2], &generation, sizeof(generation));
+
+	slavery_pool_submit(slavery->pool, report);
+	slavery_report_unref(report);
+}
+
+static void slavery_event_tap_arm(slavery_device_t *device, const unsigned int delay_ms) {
+	slavery_device_tap_t *tap = &device->tap;
+
+	if (tap->timer.callback == NULL) {
+		slavery_timer_init(&tap->timer, slavery_event_on_tap_timer, device);
+	}
+
+	// A new generation invalidates any expiry of the previous arming still queued to the worker.
+	atomic_fetch_add_explicit(&tap->generation, 1, memory_order_relaxed);
+	slavery_timer_arm(&device->receiver->timers, &tap->timer, (uint64_t)delay_ms * 1000000);
+
+	tap->armed = true;
+}
+
+static void slavery_event_tap_cancel(slavery_device_t *device) {
+	slavery_device_tap_t *tap = &device->tap;
+
+	if (tap->armed) {
+		atomic_fetch_add_explicit(&tap->generation, 1, memory_order_relaxed);
+		slavery_timer_cancel(&device->receiver->timers, &tap->timer);
+
+		tap->armed = false;
+	}
+}
+
+static const slavery_chord_rule_t *slavery_event_run(const slavery_chord_table_t *chords,
+                                                     const uint32_t mask,
+                                                     const slavery_config_action_t action) {
+	const slavery_chord_rule_t *rule = slavery_chord_table_find(chords, mask, action);
+
+	if (rule != NULL) {
+		slavery_chord_table_run(chords, rule);
 	}
 
-	log_debug("started");
+	return rule;
+}
 
-	slavery_device_t *device = NULL;
+static void slavery_event_update_taps(slavery_device_t *device,
+                                      const slavery_chord_table_t *chords,
+                                      const uint32_t previous,
+                                      const uint32_t pressed) {
+	const slavery_options_t *options = &device->receiver->slavery->options;
+	slavery_device_tap_t *tap = &device->tap;
 
-	for (size_t i = 0; i < event->receiver->num_devices; i++) {
-		if (event->receiver->devices[i]->index == event->data[1]) {
-			device = event->receiver->devices[i];
+	if ((pressed & ~previous) != 0) {
+		// Pressing the same chord again soon after releasing it continues a multi-tap, anything else starts
+		// over.
+		if (tap->state != SLAVERY_DEVICE_TAP_UP || pressed != tap->mask) {
+			tap->mask = pressed;
+			tap->count = 0;
 		}
+
+		tap->state = SLAVERY_DEVICE_TAP_DOWN;
+
+		if (slavery_chord_table_find(chords, pressed, SLAVERY_CONFIG_ACTION_HOLD) != NULL) {
+			slavery_event_tap_arm(device, options->hold_ms);
+		} else {
+			slavery_event_tap_cancel(device);
+		}
+
+		return;
 	}
 
-	if (device) {
-		log_debug("received event for device %u", device->index);
+	if (tap->state == SLAVERY_DEVICE_TAP_DOWN && previous == tap->mask) {
+		const slavery_chord_rule_t *double_tap =
+		    slavery_chord_table_find(chords, tap->mask, SLAVERY_CONFIG_ACTION_DOUBLE_TAP);
+		const slavery_chord_rule_t *triple_tap =
+		    slavery_chord_table_find(chords, tap->mask, SLAVERY_CONFIG_ACTION_TRIPLE_TAP);
 
-		slavery_button_t *buttons[device->num_buttons];
-		size_t num_pressed = 0;
-
-		for (size_t i = 0; i < device->num_buttons; i++) {
-			// Determine which buttons pressed.
-			if (event->data[3] & 0x01 && device->buttons[i]->cid == SLAVERY_CID_MOUSE_LEFT) {
-				buttons[num_pressed++] = device->buttons[i];
-			} else if (event->data[3] & 0x02 && device->buttons[i]->cid == SLAVERY_CID_MOUSE_RIGHT) {
-				buttons[num_pressed++] = device->buttons[i];
-			} else if (event->data[3] & 0x04 && device->buttons[i]->cid == SLAVERY_CID_MOUSE_MIDDLE) {
-				buttons[num_pressed++] = device->buttons[i];
-			} else if (event->data[3] & 0x08 && device->buttons[i]->cid == SLAVERY_CID_MOUSE_BACK) {
-				buttons[num_pressed++] = device->buttons[i];
-			} else if (event->data[3] & 0x10 && device->buttons[i]->cid == SLAVERY_CID_MOUSE_FORWARD) {
-				buttons[num_pressed++] = device->buttons[i];
+		tap->count++;
+
+		// A double tap only has to wait for a possible third tap when the chord has a triple tap rule.
+		if (tap->count == 3 || (tap->count == 2 && triple_tap == NULL)) {
+			const slavery_chord_rule_t *rule = tap->count == 3 ? triple_tap : double_tap;
+
+			if (rule != NULL) {
+				slavery_chord_table_run(chords, rule);
 			}
+
+			tap->state = SLAVERY_DEVICE_TAP_IDLE;
+			slavery_event_tap_cancel(device);
+		} else if (double_tap != NULL || triple_tap != NULL) {
+			tap->state = SLAVERY_DEVICE_TAP_UP;
+			slavery_event_tap_arm(device, options->multi_tap_ms);
+		} else {
+			tap->state = SLAVERY_DEVICE_TAP_IDLE;
+			slavery_event_tap_cancel(device);
 		}
+	} else if (tap->state != SLAVERY_DEVICE_TAP_UP) {
+		// Releasing the rest of a chord already counted as a tap doesn't end the wait for the next one.
+		tap->state = SLAVERY_DEVICE_TAP_IDLE;
+		slavery_event_tap_cancel(device);
+	}
+}
 
-		printf("buttons: %lu\n", num_pressed);
+static void slavery_event_expire_tap(slavery_device_t *device, const uint32_t generation) {
+	const slavery_chord_table_t *chords = atomic_load(&device->chords);
+	slavery_device_tap_t *tap = &device->tap;
 
-		// virtual_input(num_pressed > 0 ? 1 : 0);
-	} else {
-		log_debug("received event for an unrecognised device %u", event->data[1]);
+	if (generation != atomic_load_explicit(&tap->generation, memory_order_relaxed)) {
+		log_debug("discarding stale timer for device %u", device->index);
+
+		return;
+	}
+
+	tap->armed = false;
+
+	if (tap->state == SLAVERY_DEVICE_TAP_DOWN) {
+		tap->state = SLAVERY_DEVICE_TAP_HELD;
+
+		if (chords != NULL) {
+			slavery_event_run(chords, tap->mask, SLAVERY_CONFIG_ACTION_HOLD);
+		}
+	} else if (tap->state == SLAVERY_DEVICE_TAP_UP) {
+		tap->state = SLAVERY_DEVICE_TAP_IDLE;
+
+		if (chords != NULL && tap->count == 2) {
+			slavery_event_run(chords, tap->mask, SLAVERY_CONFIG_ACTION_DOUBLE_TAP);
+		}
+	}
+}
+
+static slavery_config_action_t slavery_event_classify_gesture(const slavery_device_gesture_t *gesture,
+                                                              const unsigned int threshold) {
+	uint32_t distance_x = gesture->dx < 0 ? -(uint32_t)gesture->dx : (uint32_t)gesture->dx;
+	uint32_t distance_y = gesture->dy < 0 ? -(uint32_t)gesture->dy : (uint32_t)gesture->dy;
+
+	// The overall direction of travel wins, whatever path was taken to get there.
+	if (distance_x < threshold && distance_y < threshold) {
+		return SLAVERY_CONFIG_ACTION_UNKNOWN;
+	}
+
+	if (distance_x > distance_y) {
+		return gesture->dx > 0 ? SLAVERY_CONFIG_ACTION_GESTURE_RIGHT : SLAVERY_CONFIG_ACTION_GESTURE_LEFT;
+	}
+
+	return gesture->dy > 0 ? SLAVERY_CONFIG_ACTION_GESTURE_DOWN : SLAVERY_CONFIG_ACTION_GESTURE_UP;
+}
+
+static void slavery_event_update_motion(slavery_device_t *device, const int16_t dx, const int16_t dy) {
+	const slavery_options_t *options = &device->receiver->slavery->options;
+	slavery_device_gesture_t *gesture = &device->gesture;
+
+	gesture->dx += dx;
+	gesture->dy += dy;
+
+	// Once the button has clearly moved it is making a gesture, so it mustn't also count as a hold or tap.
+	if (!gesture->moved && slavery_event_classify_gesture(gesture, options->gesture_threshold) !=
+	                           SLAVERY_CONFIG_ACTION_UNKNOWN) {
+		gesture->moved = true;
+		device->tap.state = SLAVERY_DEVICE_TAP_HELD;
+
+		slavery_event_tap_cancel(device);
+	}
+}
+
+static void slavery_event_finish_gesture(slavery_device_t *device,
+                                         const slavery_chord_table_t *chords,
+                                         const uint32_t previous) {
+	const slavery_options_t *options = &device->receiver->slavery->options;
+	slavery_device_gesture_t *gesture = &device->gesture;
+
+	if ((previous & chords->gestures) != 0 && gesture->moved) {
+		slavery_config_action_t action = slavery_event_classify_gesture(gesture, options->gesture_threshold);
+
+		log_debug("device %u gesture moved %d,%d", device->index, gesture->dx, gesture->dy);
+
+		slavery_event_run(chords, previous, action);
+	}
+
+	gesture->dx = 0;
+	gesture->dy = 0;
+	gesture->moved = false;
+}
+
+void slavery_event_update_buttons(slavery_device_t *device, const uint32_t pressed) {
+	const slavery_chord_table_t *chords = atomic_load(&device->chords);
+	uint32_t previous = device->pressed;
+
+	// Events for a device are always dispatched by the same worker, so its button state needs no locking.
+	device->pressed = pressed;
+
+	if (chords == NULL || pressed == previous) {
+		return;
+	}
+
+	log_debug("device %u buttons changed from %#x to %#x", device->index, previous, pressed);
+
+	// A chord is released as a whole before the buttons still held can start a new one.
+	if ((previous & ~pressed) != 0) {
+		slavery_event_run(chords, previous, SLAVERY_CONFIG_ACTION_RELEASED);
+		slavery_event_finish_gesture(device, chords, previous);
+	}
+
+	if ((pressed & ~previous) != 0) {
+		slavery_event_run(chords, pressed, SLAVERY_CONFIG_ACTION_PRESSED);
+	}
+
+	slavery_event_update_taps(device, chords, previous, pressed);
+}
+
+static bool slavery_event_is_reconnection(const slavery_report_t *event, const slavery_feature_t *feature) {
+	if (event->size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+		return false;
+	}
+
+	// The receiver announces a link coming back, and so does the device itself, either of which can be off.
+	if (event->data[0] == SLAVERY_REPORT_ID_CONTROL_SHORT &&
+	    event->data[2] == SLAVERY_RECEIVER_DEVICE_CONNECTION) {
+		return (event->data[4] & SLAVERY_RECEIVER_LINK_NOT_ESTABLISHED) == 0;
+	}
+
+	return feature != NULL && feature->id == SLAVERY_FEATURE_ID_WIRELESS_STATUS &&
+	       event->data[3] >> 4 == SLAVERY_EVENT_WIRELESS_STATUS_BROADCAST &&
+	       event->data[4] == SLAVERY_WIRELESS_STATUS_RECONNECTION;
+}
+
+static void slavery_event_dispatch_notification(const slavery_report_t *event) {
+	slavery_device_t *device = slavery_receiver_get_device_slot(event->receiver, event->data[1]);
+	const slavery_feature_t *feature = NULL;
+
+	if (device != NULL && event->size >= SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+		feature = slavery_feature_table_get(&device->features, event->data[2]);
+	}
+
+	// The device's later events wait while it is diverted again, so none are read with the wrong settings.
+	if (device != NULL && slavery_event_is_reconnection(event, feature)) {
+		slavery_device_reset_diversion(device);
+
+		return;
+	}
+
+	if (feature == NULL || feature->id != SLAVERY_FEATURE_ID_CONTROLS_V4) {
+		log_debug("received unsolicited control report %#04x for device %u", event->data[2], event->data[1]);
+
+		return;
+	}
+
+	switch ((slavery_event_controls_v4_t)(event->data[3] >> 4)) {
+		case SLAVERY_EVENT_CONTROLS_V4_DIVERTED_BUTTONS: {
+			uint32_t report_mask = (1u << SLAVERY_DEVICE_BUTTON_BITS) - 1;
+			uint32_t diverted = 0;
+
+			// Every diverted control still held is listed, up to four, so this replaces the upper bits.
+			for (ssize_t i = 4; i + 1 < event->size && i < 12; i += 2) {
+				slavery_cid_t cid = (slavery_cid_t)event->data[i] << 8 | event->data[i + 1];
+				ssize_t bit;
+
+				if (cid != 0 && (bit = slavery_device_cid_to_bit(device, cid)) >= 0) {
+					diverted |= 1u << bit;
+				}
+			}
+
+			slavery_event_update_buttons(device, (device->pressed & report_mask) | diverted);
+
+			break;
+		}
+
+		case SLAVERY_EVENT_CONTROLS_V4_DIVERTED_RAW_XY:
+			slavery_event_update_motion(device,
+			                            (int16_t)(event->data[4] << 8 | event->data[5]),
+			                            (int16_t)(event->data[6] << 8 | event->data[7]));
+
+			break;
+
+		default:
+			log_debug("received controls notification %#04x for device %u", event->data[3], device->index);
+	}
+}
+
+void slavery_event_dispatch(const slavery_report_t *event) {
+	if (event->data[0] == SLAVERY_REPORT_ID_TIMER) {
+		slavery_device_t *device = slavery_receiver_get_device_slot(event->receiver, event->data[1]);
+		uint32_t generation;
+
+		memcpy(&generation, &event->data[2], sizeof(generation));
+
+		if (device != NULL) {
+			slavery_event_expire_tap(device, generation);
+		}
+
+		return;
+	}
+
+	if (event->data[0] != SLAVERY_REPORT_ID_EVENT) {
+		slavery_event_dispatch_notification(event);
+
+		return;
+	}
+
+	// Keyboard and consumer reports from the same slot carry keys, not buttons, in the same bytes.
+	if (event->size < 5 || event->data[2] != SLAVERY_EVENT_TYPE_MOUSE) {
+		log_debug("ignoring event of type %#04x for device %u", event->data[2], event->data[1]);
+
+		return;
 	}
 
-	free(event->data);
-	free(event);
+	slavery_device_t *device = slavery_receiver_get_device_slot(event->receiver, event->data[1]);
 
-	return NULL;
+	if (device) {
+		log_debug("received event for device %u", device->index);
+
+		uint16_t button_bits = (uint16_t)event->data[4] << 8 | event->data[3];
+		uint32_t report_mask = (1u << SLAVERY_DEVICE_BUTTON_BITS) - 1;
+
+		// The report only covers the low bits, so diverted controls still held keep their bits.
+		slavery_event_update_buttons(device, (device->pressed & ~report_mask) | button_bits);
+	} else {
+		log_debug("received event for an unrecognised device %u", event->data[1]);
+	}
 }
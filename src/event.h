@@ -10,18 +10,13 @@
 
 #pragma once
 
+#include "report.h"
+#include "utils.h"
+
 #include <stdint.h>
 #include <sys/types.h>
 
-typedef struct slavery_receiver_t slavery_receiver_t;
-
-/**
- * @brief Describes an event for the protocol event system.
- */
-typedef struct slavery_event_t {
-	slavery_receiver_t *receiver;
-	size_t size;
-	uint8_t *data;
-} slavery_event_t;
+typedef struct slavery_device_t slavery_device_t;
 
-void *slavery_event_dispatch(slavery_event_t *event);
+void slavery_event_update_buttons(slavery_device_t *device, const uint32_t pressed);
+void slavery_event_dispatch(const slavery_report_t *event);
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief Device feature table implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#include "feature.h"
+
+#include <string.h>
+
+static size_t slavery_feature_table_hash(const uint16_t id) {
+	// Fibonacci hashing spreads the clustered IDs (0x0000, 0x0001, 0x0003...) across the table.
+	return ((uint32_t)id * 0x9e3779b1u) >> 24;
+}
+
+void slavery_feature_table_init(slavery_feature_table_t *table) {
+	memset(table, 0, sizeof(slavery_feature_table_t));
+
+	// The root feature is at a fixed index on every HID++ 2.0 device.
+	table->features[SLAVERY_FEATURE_INDEX_ROOT] = (slavery_feature_t){.id = SLAVERY_FEATURE_ID_ROOT};
+	table->num_features = 1;
+}
+
+void slavery_feature_table_insert(slavery_feature_table_t *table, const slavery_feature_t *feature) {
+	if (feature->index == SLAVERY_FEATURE_INDEX_ROOT ||
+	    feature->index == SLAVERY_FEATURE_INDEX_ERROR_HIDPP20) {
+		return;
+	}
+
+	size_t slot = slavery_feature_table_hash(feature->id);
+
+	// There are fewer usable indexes than slots, so there is always an empty slot to stop at.
+	while (table->id_slots[slot] != 0 && table->features[table->id_slots[slot]].id != feature->id) {
+		slot = (slot + 1) % SLAVERY_FEATURE_TABLE_SIZE;
+	}
+
+	if (table->id_slots[slot] == 0) {
+		table->num_features++;
+	}
+
+	table->features[feature->index] = *feature;
+	table->id_slots[slot] = feature->index;
+}
+
+ssize_t slavery_feature_table_find(const slavery_feature_table_t *table, const uint16_t id) {
+	if (id == SLAVERY_FEATURE_ID_ROOT) {
+		return SLAVERY_FEATURE_INDEX_ROOT;
+	}
+
+	for (size_t slot = slavery_feature_table_hash(id); table->id_slots[slot] != 0;
+	     slot = (slot + 1) % SLAVERY_FEATURE_TABLE_SIZE) {
+		if (table->features[table->id_slots[slot]].id == id) {
+			return table->id_slots[slot];
+		}
+	}
+
+	return -1;
+}
+
+const slavery_feature_t *slavery_feature_table_get(const slavery_feature_table_t *table,
+                                                   const uint8_t index) {
+	if (index != SLAVERY_FEATURE_INDEX_ROOT && table->features[index].index != index) {
+		return NULL;
+	}
+
+	return &table->features[index];
+}
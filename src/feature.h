@@ -10,18 +10,25 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
 
-#define FEATURE_ID_MAP(FEATURE_ID)                                    \
-	FEATURE_ID(SLAVERY_FEATURE_ID_ROOT, 0x0000, "root")               \
-	FEATURE_ID(SLAVERY_FEATURE_ID_FEATURE_SET, 0x0001, "feature_set") \
-	FEATURE_ID(SLAVERY_FEATURE_ID_FIRMWARE, 0x0003, "firmware")       \
-	FEATURE_ID(SLAVERY_FEATURE_ID_NAME_TYPE, 0x0005, "name/type")     \
-	FEATURE_ID(SLAVERY_FEATURE_ID_RESET, 0x0020, "reset")             \
-	FEATURE_ID(SLAVERY_FEATURE_ID_CRYPTO, 0x0021, "crypto")           \
-	FEATURE_ID(SLAVERY_FEATURE_ID_BATTERY, 0x1000, "battery")         \
-	FEATURE_ID(SLAVERY_FEATURE_ID_HOST, 0x1814, "host")               \
-	FEATURE_ID(SLAVERY_FEATURE_ID_CONTROLS_V4, 0x1b04, "controls_v4") \
+#define FEATURE_ID_MAP(FEATURE_ID)                                            \
+	FEATURE_ID(SLAVERY_FEATURE_ID_ROOT, 0x0000, "root")                       \
+	FEATURE_ID(SLAVERY_FEATURE_ID_FEATURE_SET, 0x0001, "feature_set")         \
+	FEATURE_ID(SLAVERY_FEATURE_ID_FIRMWARE, 0x0003, "firmware")               \
+	FEATURE_ID(SLAVERY_FEATURE_ID_NAME_TYPE, 0x0005, "name/type")             \
+	FEATURE_ID(SLAVERY_FEATURE_ID_RESET, 0x0020, "reset")                     \
+	FEATURE_ID(SLAVERY_FEATURE_ID_CRYPTO, 0x0021, "crypto")                   \
+	FEATURE_ID(SLAVERY_FEATURE_ID_BATTERY, 0x1000, "battery")                 \
+	FEATURE_ID(SLAVERY_FEATURE_ID_HOST, 0x1814, "host")                       \
+	FEATURE_ID(SLAVERY_FEATURE_ID_CONTROLS_V4, 0x1b04, "controls_v4")         \
+	FEATURE_ID(SLAVERY_FEATURE_ID_WIRELESS_STATUS, 0x1d4b, "wireless_status") \
+	FEATURE_ID(SLAVERY_FEATURE_ID_SMART_SHIFT, 0x2110, "smart_shift")         \
+	FEATURE_ID(SLAVERY_FEATURE_ID_HIRES_WHEEL, 0x2121, "hires_wheel")         \
+	FEATURE_ID(SLAVERY_FEATURE_ID_THUMB_WHEEL, 0x2150, "thumb_wheel")         \
+	FEATURE_ID(SLAVERY_FEATURE_ID_ADJUSTABLE_DPI, 0x2201, "adjustable_dpi")   \
 	FEATURE_ID_UNKNOWN(SLAVERY_FEATURE_ID_UNKNOWN, "unknown")
 
 /**
@@ -48,7 +55,6 @@ const char *slavery_feature_id_to_string(const slavery_feature_id_t feature_id)
 		FEATURE_ID_MAP(FEATURE_ID)
 #undef FEATURE_ID
 #undef FEATURE_ID_UNKNOWN
-#undef FEATURE_ID_MAP
 	}
 }
 
@@ -58,7 +64,8 @@ const char *slavery_feature_id_to_string(const slavery_feature_id_t feature_id)
 typedef enum
 {
 	SLAVERY_FEATURE_INDEX_ROOT = 0x00,
-	SLAVERY_FEATURE_INDEX_ERROR = 0x8f
+	SLAVERY_FEATURE_INDEX_ERROR = 0x8f,
+	SLAVERY_FEATURE_INDEX_ERROR_HIDPP20 = 0xff
 } slavery_feature_index_t;
 
 /**
@@ -70,3 +77,26 @@ typedef struct slavery_feature_t {
 	uint8_t version;
 	uint8_t flags;
 } slavery_feature_t;
+
+/**
+ * @brief Number of addressable feature indexes. Indexes are a byte, and 0xff is reserved for error reports.
+ */
+#define SLAVERY_FEATURE_TABLE_SIZE 256
+
+/**
+ * @brief Every feature a device supports, addressable by index or by ID in constant time.
+ *
+ * Features are stored directly at their index. IDs are found through an open-addressed hash of feature
+ * indexes, where 0 marks an empty slot since the root feature is always at index 0.
+ */
+typedef struct slavery_feature_table_t {
+	size_t num_features;
+	slavery_feature_t features[SLAVERY_FEATURE_TABLE_SIZE];
+	uint8_t id_slots[SLAVERY_FEATURE_TABLE_SIZE];
+} slavery_feature_table_t;
+
+void slavery_feature_table_init(slavery_feature_table_t *table);
+void slavery_feature_table_insert(slavery_feature_table_t *table, const slavery_feature_t *feature);
+ssize_t slavery_feature_table_find(const slavery_feature_table_t *table, const uint16_t id);
+const slavery_feature_t *slavery_feature_table_get(const slavery_feature_table_t *table,
+                                                   const uint8_t index);
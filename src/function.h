@@ -11,9 +11,10 @@
 #pragma once
 
 /**
- * @brief Encode a function with the software ID to produce request data.
+ * @brief Encode a function to produce request data. The low nibble holds the software ID, which is allocated
+ * when the request is submitted.
  */
-#define slavery_function_encode(function) ((function << 4) | SLAVERY_SOFTWARE_ID)
+#define slavery_function_encode(function) ((function) << 4)
 
 /**
  * @brief Functions under the 'root' feature.
@@ -99,3 +100,46 @@ typedef enum
 	SLAVERY_FUNCTION_CONTROLS_V4_GET_CID_REPORT_INFO = 0x02,
 	SLAVERY_FUNCTION_CONTROLS_V4_SET_CID_REPORT_INFO = 0x03
 } slavery_function_controls_v4_t;
+
+/**
+ * @brief Reporting flags set by SLAVERY_FUNCTION_CONTROLS_V4_SET_CID_REPORT_INFO. Each setting is only
+ * changed when its valid bit is set too.
+ */
+typedef enum
+{
+	SLAVERY_CONTROLS_V4_REPORT_DIVERT = 0x01,
+	SLAVERY_CONTROLS_V4_REPORT_DIVERT_VALID = 0x02,
+	SLAVERY_CONTROLS_V4_REPORT_PERSIST = 0x04,
+	SLAVERY_CONTROLS_V4_REPORT_PERSIST_VALID = 0x08,
+	SLAVERY_CONTROLS_V4_REPORT_RAW_XY = 0x10,
+	SLAVERY_CONTROLS_V4_REPORT_RAW_XY_VALID = 0x20
+} slavery_controls_v4_report_flag_t;
+
+/**
+ * @brief Notifications sent under the 'controls v4' feature, in place of a function.
+ */
+typedef enum
+{
+	SLAVERY_EVENT_CONTROLS_V4_DIVERTED_BUTTONS = 0x00,
+	SLAVERY_EVENT_CONTROLS_V4_DIVERTED_RAW_XY = 0x01
+} slavery_event_controls_v4_t;
+
+/**
+ * @brief Notifications sent under the 'wireless status' feature, in place of a function.
+ */
+typedef enum
+{
+	SLAVERY_EVENT_WIRELESS_STATUS_BROADCAST = 0x00
+} slavery_event_wireless_status_t;
+
+/**
+ * @brief Status given by SLAVERY_EVENT_WIRELESS_STATUS_BROADCAST when a device has its link back.
+ */
+#define SLAVERY_WIRELESS_STATUS_RECONNECTION 0x01
+
+/**
+ * @brief HID++ 1.0 notification a receiver sends, in place of a feature index, when a device's link comes or
+ * goes. SLAVERY_RECEIVER_LINK_NOT_ESTABLISHED is set in its first parameter when the link went.
+ */
+#define SLAVERY_RECEIVER_DEVICE_CONNECTION 0x41
+#define SLAVERY_RECEIVER_LINK_NOT_ESTABLISHED 0x40
@@ -0,0 +1,259 @@
+/**
+ * @file
+ * @brief Command launcher implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "launcher.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static int slavery_launcher_helper_spawn(const posix_spawnattr_t *attr,
+                                         const slavery_launcher_request_t *request,
+                                         char args[],
+                                         const size_t size,
+                                         pid_t *pid) {
+	if (request->argc == 0 || request->size != size || size == 0 || request->argc > size ||
+	    args[size - 1] != '\0') {
+		return EINVAL;
+	}
+
+	char *argv[request->argc + 1];
+	size_t argc = 0;
+
+	for (size_t offset = 0; offset < size; offset += strlen(&args[offset]) + 1) {
+		if (argc == request->argc) {
+			return EINVAL;
+		}
+
+		argv[argc++] = &args[offset];
+	}
+
+	if (argc != request->argc) {
+		return EINVAL;
+	}
+
+	argv[argc] = NULL;
+
+	return posix_spawnp(pid, argv[0], NULL, attr, argv, environ);
+}
+
+static void slavery_launcher_helper_run(int fd) {
+	uint8_t buffer[sizeof(slavery_launcher_request_t) + SLAVERY_LAUNCHER_MAX_COMMAND];
+	const slavery_launcher_request_t *request = (const slavery_launcher_request_t *)buffer;
+	struct sigaction action = {.sa_handler = SIG_IGN, .sa_flags = SA_NOCLDWAIT};
+	posix_spawnattr_t attr;
+	sigset_t signals;
+	ssize_t length;
+
+	// Only the request socket is kept, so commands don't inherit whatever the application had open.
+	if (fd != 3) {
+		dup2(fd, 3);
+		close(fd);
+		fd = 3;
+	}
+
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	close_range(4, ~0U, 0);
+
+	// Commands are never waited for, the kernel reaps them as they exit.
+	sigaction(SIGCHLD, &action, NULL);
+
+	// Each command starts in its own session with default signal handling, as if run from a desktop launcher.
+	posix_spawnattr_init(&attr);
+	sigemptyset(&signals);
+	posix_spawnattr_setsigmask(&attr, &signals);
+	sigfillset(&signals);
+	posix_spawnattr_setsigdefault(&attr, &signals);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSID);
+
+	while ((length = recv(fd, buffer, sizeof(buffer), 0)) != 0) {
+		if (length < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		slavery_launcher_reply_t reply = {.error = EINVAL};
+		pid_t pid = 0;
+
+		if ((size_t)length >= sizeof(slavery_launcher_request_t)) {
+			reply.requested_ns = request->requested_ns;
+			reply.error = slavery_launcher_helper_spawn(&attr,
+			                                            request,
+			                                            (char *)buffer + sizeof(slavery_launcher_request_t),
+			                                            length - sizeof(slavery_launcher_request_t),
+			                                            &pid);
+		}
+
+		reply.spawned_ns = time_monotonic_ns();
+		reply.pid = pid;
+
+		send(fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+	}
+
+	posix_spawnattr_destroy(&attr);
+
+	_exit(EXIT_SUCCESS);
+}
+
+static void *slavery_launcher_collect(slavery_launcher_t *launcher) {
+	slavery_launcher_reply_t reply;
+	ssize_t length;
+
+	while ((length = recv(launcher->fd, &reply, sizeof(reply), 0)) != 0) {
+		if (length < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "recv() failed on launcher socket");
+
+			break;
+		}
+
+		// Both ends read CLOCK_MONOTONIC, which is the same in every process.
+		uint64_t latency_ns = reply.spawned_ns - reply.requested_ns;
+
+		pthread_mutex_lock(&launcher->mutex);
+
+		if (reply.error != 0) {
+			launcher->stats.failed++;
+		} else {
+			launcher->stats.launched++;
+			launcher->stats.last_ns = latency_ns;
+			launcher->stats.total_ns += latency_ns;
+
+			if (latency_ns > launcher->stats.max_ns) {
+				launcher->stats.max_ns = latency_ns;
+			}
+		}
+
+		pthread_mutex_unlock(&launcher->mutex);
+
+		if (reply.error != 0) {
+			errno = reply.error;
+
+			log_warning_errno(SLAVERY_ERROR_OS, "failed to launch command");
+		} else {
+			log_debug("launched command as pid %d in %" PRIu64 "ns", reply.pid, latency_ns);
+		}
+	}
+
+	return NULL;
+}
+
+slavery_launcher_t *slavery_launcher_new() {
+	int fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "socketpair() failed");
+
+		return NULL;
+	}
+
+	if ((pid = fork()) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "fork() failed");
+
+		close(fds[0]);
+		close(fds[1]);
+
+		return NULL;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		slavery_launcher_helper_run(fds[1]);
+	}
+
+	close(fds[1]);
+
+	slavery_launcher_t *launcher = malloc(sizeof(slavery_launcher_t));
+
+	launcher->pid = pid;
+	launcher->fd = fds[0];
+	launcher->stats = (slavery_launcher_stats_t){0};
+
+	pthread_mutex_init(&launcher->mutex, NULL);
+
+	if ((errno = pthread_create(
+	         &launcher->thread, NULL, (pthread_callback_t)slavery_launcher_collect, launcher)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		close(launcher->fd);
+		waitpid(launcher->pid, NULL, 0);
+		pthread_mutex_destroy(&launcher->mutex);
+		free(launcher);
+
+		return NULL;
+	}
+
+	return launcher;
+}
+
+void slavery_launcher_free(slavery_launcher_t *launcher) {
+	// The helper exits once it has read every request, and closing its end of the socket ends the thread.
+	shutdown(launcher->fd, SHUT_WR);
+	pthread_join(launcher->thread, NULL);
+	waitpid(launcher->pid, NULL, 0);
+
+	close(launcher->fd);
+	pthread_mutex_destroy(&launcher->mutex);
+	free(launcher);
+}
+
+int slavery_launcher_run(slavery_launcher_t *launcher, const slavery_config_command_t *command) {
+	slavery_launcher_request_t request = {
+	    .requested_ns = time_monotonic_ns(), .argc = command->argc, .size = command->size};
+	struct iovec iov[] = {{.iov_base = &request, .iov_len = sizeof(request)},
+	                      {.iov_base = (void *)command->args, .iov_len = command->size}};
+	struct msghdr msg = {.msg_iov = iov, .msg_iovlen = 2};
+
+	// Never wait for the helper: if it is that far behind, the command is dropped rather than the event.
+	if (command->size > SLAVERY_LAUNCHER_MAX_COMMAND) {
+		errno = E2BIG;
+	} else if (sendmsg(launcher->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+		return 0;
+	}
+
+	log_warning_errno(SLAVERY_ERROR_OS, "failed to send %s to launcher", command->args);
+
+	pthread_mutex_lock(&launcher->mutex);
+
+	launcher->stats.dropped++;
+
+	pthread_mutex_unlock(&launcher->mutex);
+
+	return -1;
+}
+
+void slavery_launcher_get_stats(slavery_launcher_t *launcher, slavery_launcher_stats_t *stats) {
+	pthread_mutex_lock(&launcher->mutex);
+
+	*stats = launcher->stats;
+
+	pthread_mutex_unlock(&launcher->mutex);
+}
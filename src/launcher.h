@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief Command launcher functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "config.h"
+#include "libslavery.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief Largest command, arguments and all, the launcher accepts.
+ */
+#define SLAVERY_LAUNCHER_MAX_COMMAND 8192
+
+/**
+ * @brief Launch request sent to the helper, followed by the command's arguments.
+ */
+typedef struct slavery_launcher_request_t {
+	uint64_t requested_ns;
+	uint32_t argc;
+	uint32_t size;
+} slavery_launcher_request_t;
+
+/**
+ * @brief Helper's reply to a launch request.
+ */
+typedef struct slavery_launcher_reply_t {
+	uint64_t requested_ns;
+	uint64_t spawned_ns;
+	int32_t error;
+	int32_t pid;
+} slavery_launcher_reply_t;
+
+/**
+ * @brief Starts config entries' commands from a helper process.
+ *
+ * The helper is forked before anything else is set up, while the address space is still small and there is
+ * only one thread, and starts each command with posix_spawn(), which doesn't copy the caller's page tables.
+ * Requests go over a datagram socket without waiting, so an event worker never blocks on a process starting,
+ * and a thread here collects the replies to time each launch.
+ */
+typedef struct slavery_launcher_t {
+	pid_t pid;
+	int fd;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	slavery_launcher_stats_t stats;
+} slavery_launcher_t;
+
+slavery_launcher_t *slavery_launcher_new();
+void slavery_launcher_free(slavery_launcher_t *launcher);
+int slavery_launcher_run(slavery_launcher_t *launcher, const slavery_config_command_t *command);
+void slavery_launcher_get_stats(slavery_launcher_t *launcher, slavery_launcher_stats_t *stats);
@@ -1,105 +1,546 @@
+#define _GNU_SOURCE
+
 #include "libslavery_p.h"
+#include "cache.h"
+#include "capture.h"
+#include "chord.h"
+#include "config.h"
+#include "launcher.h"
 #include "monitor.h"
+#include "pool.h"
+#include "reactor.h"
+#include "report.h"
 #include "receiver.h"
+#include "transport.h"
+#include "uring.h"
+#include "virtual_input.h"
+#include "watch.h"
 #include "utils.h"
 
-#include <libudev.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+
+void slavery_options_init(slavery_options_t *options) {
+	options->num_workers = 2;
+	options->worker_queue_size = 256;
+	options->report_pool_size = 0;
+	options->reactor = false;
+	options->io_uring = false;
+	options->request_timeout_ms = 2000;
+	options->request_retries = 3;
+	options->request_backoff_ms = 20;
+	options->discovery = SLAVERY_DISCOVERY_SYSFS;
+	options->cache = true;
+	options->profiles = true;
+	options->cache_path = NULL;
+	options->hold_ms = 500;
+	options->multi_tap_ms = 250;
+	options->gesture_threshold = 50;
+	options->capture_path = NULL;
+	options->transport = NULL;
+}
 
 slavery_t *slavery_new() {
+	return slavery_new_with_options(NULL);
+}
+
+slavery_t *slavery_new_with_options(const slavery_options_t *options) {
 	slavery_t *slavery = malloc(sizeof(slavery_t));
+
+	if (options == NULL) {
+		slavery_options_init(&slavery->options);
+	} else {
+		slavery->options = *options;
+	}
+
+	slavery->transport =
+	    slavery->options.transport != NULL ? slavery->options.transport : &slavery_transport_hidraw;
+
+	// The launcher forks, so it goes first, before there are other threads or much memory to copy. Without it
+	// everything works except running commands.
+	if ((slavery->launcher = slavery_launcher_new()) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to start command launcher");
+	}
+
 	slavery->receivers = NULL;
 	slavery->num_receivers = 0;
-	slavery->monitor = slavery_monitor_new(slavery);
+	slavery->reactor = NULL;
+	slavery->uring = NULL;
+	slavery->cache = slavery->options.cache ? slavery_cache_open(slavery->options.cache_path) : NULL;
+	slavery->scan_timings = (slavery_scan_timings_t){0};
+	slavery->config = NULL;
+	slavery->watch = NULL;
+	slavery->input = NULL;
+
+	// Enough slots for every worker queue to be full, plus one being read by each listener.
+	size_t report_pool_size = slavery->options.report_pool_size;
+
+	if (report_pool_size == 0) {
+		report_pool_size = slavery->options.num_workers * slavery->options.worker_queue_size + 64;
+
+#ifdef SLAVERY_IO_URING
+		// io_uring keeps its provided buffers checked out of the pool for as long as they are unused.
+		if (slavery->options.io_uring) {
+			report_pool_size += SLAVERY_URING_NUM_BUFFERS;
+		}
+#endif
+	}
+
+	if ((slavery->reports = slavery_report_pool_new(report_pool_size)) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to create report pool");
+
+		if (slavery->cache != NULL) {
+			slavery_cache_free(slavery->cache);
+		}
+
+		if (slavery->launcher != NULL) {
+			slavery_launcher_free(slavery->launcher);
+		}
+
+		free(slavery);
+
+		return NULL;
+	}
+
+	if ((slavery->pool =
+	         slavery_pool_new(slavery->options.num_workers, slavery->options.worker_queue_size)) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to create worker pool");
+
+		slavery_report_pool_free(slavery->reports);
+
+		if (slavery->cache != NULL) {
+			slavery_cache_free(slavery->cache);
+		}
+
+		if (slavery->launcher != NULL) {
+			slavery_launcher_free(slavery->launcher);
+		}
+
+		free(slavery);
+
+		return NULL;
+	}
+
+#ifdef SLAVERY_IO_URING
+	if (slavery->options.io_uring && (slavery->uring = slavery_uring_new(slavery)) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to create io_uring backend, falling back");
+	}
+#endif
+
+	if (slavery->uring == NULL && slavery->options.reactor &&
+	    (slavery->reactor = slavery_reactor_new()) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to create reactor");
+
+#ifdef SLAVERY_IO_URING
+		if (slavery->uring != NULL) {
+			slavery_uring_free(slavery->uring);
+		}
+#endif
+
+		slavery_pool_free(slavery->pool);
+		slavery_report_pool_free(slavery->reports);
+
+		if (slavery->cache != NULL) {
+			slavery_cache_free(slavery->cache);
+		}
+
+		if (slavery->launcher != NULL) {
+			slavery_launcher_free(slavery->launcher);
+		}
+
+		free(slavery);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&slavery->receivers_mutex, NULL);
+	pthread_mutex_init(&slavery->diversion_mutex, NULL);
+
+	// Failing to capture is reported, but doesn't stop anything else working.
+	slavery->capture = NULL;
+
+	if (slavery->options.capture_path != NULL &&
+	    (slavery->capture = slavery_capture_new(slavery->options.capture_path)) == NULL) {
+		log_warning(SLAVERY_ERROR_IO, "failed to start capture");
+	}
+
+	// Hotplug comes from udev, so only hidraw receivers can be watched for.
+	slavery->monitor = slavery->transport == &slavery_transport_hidraw ? slavery_monitor_new(slavery) : NULL;
 
 	return slavery;
 }
 
 int slavery_free(slavery_t *slavery) {
+	if (slavery->watch != NULL) {
+		slavery_config_watch_free(slavery->watch);
+	}
+
+	if (slavery->monitor != NULL) {
+		slavery_monitor_free(slavery->monitor);
+	}
+
 	slavery_receiver_array_free(slavery->receivers, slavery->num_receivers);
 
+	if (slavery->reactor != NULL) {
+		slavery_reactor_free(slavery->reactor);
+	}
+
+#ifdef SLAVERY_IO_URING
+	if (slavery->uring != NULL) {
+		slavery_uring_free(slavery->uring);
+	}
+#endif
+
+	slavery_pool_free(slavery->pool);
+	slavery_report_pool_free(slavery->reports);
+
+	if (slavery->cache != NULL) {
+		slavery_cache_free(slavery->cache);
+	}
+
+	// Receivers and workers are gone, so nothing more can be captured.
+	if (slavery->capture != NULL) {
+		slavery_capture_free(slavery->capture);
+	}
+
+	// The helper is only stopped once no worker is left to send it commands.
+	if (slavery->launcher != NULL) {
+		slavery_launcher_free(slavery->launcher);
+	}
+
+	// Devices and their compiled rules are gone by now, so nothing refers to the config or virtual device.
+	if (slavery->config != NULL) {
+		slavery_config_free(slavery->config);
+	}
+
+	if (slavery->input != NULL) {
+		slavery_virtual_input_free(slavery->input);
+	}
+
+	pthread_mutex_destroy(&slavery->diversion_mutex);
+	pthread_mutex_destroy(&slavery->receivers_mutex);
 	free(slavery);
 
 	return 0;
 }
 
-ssize_t slavery_scan_receivers(slavery_t *slavery) {
-	log_debug("scanning for receivers...");
+static int slavery_apply_config(slavery_t *slavery,
+                                slavery_receiver_t *receivers[],
+                                const size_t num_receivers,
+                                const slavery_config_t *config) {
+	size_t num_devices = 0;
+	size_t num_old_chords = 0;
 
-	struct udev *udev;
-	struct udev_enumerate *enumerate;
-	struct udev_list_entry *device_list, *device_entry;
+	for (size_t i = 0; i < num_receivers; i++) {
+		num_devices += receivers[i]->num_devices;
+	}
 
-	slavery->num_receivers = 0;
-	slavery->receivers = NULL;
+	slavery_chord_table_t *old_chords[num_devices > 0 ? num_devices : 1];
 
-	if ((udev = udev_new()) == NULL) {
-		log_warning(SLAVERY_ERROR_UDEV, "udev_new() failed");
+	// Every device switches over before the single wait for readers of the tables being replaced.
+	for (size_t i = 0; i < num_receivers; i++) {
+		for (size_t j = 0; j < receivers[i]->num_devices; j++) {
+			slavery_chord_table_t *chords = slavery_device_swap_config(receivers[i]->devices[j], config);
 
-		return -1;
+			if (chords != NULL) {
+				old_chords[num_old_chords++] = chords;
+			}
+		}
+	}
+
+	if (num_old_chords > 0) {
+		slavery_epoch_synchronize(&slavery->pool->epoch);
+	}
+
+	for (size_t i = 0; i < num_old_chords; i++) {
+		slavery_chord_table_free(old_chords[i]);
+	}
+
+	// Controls are diverted only once the rules using them are live, and released once no rule does.
+	for (size_t i = 0; i < num_receivers; i++) {
+		for (size_t j = 0; j < receivers[i]->num_devices; j++) {
+			slavery_device_update_diversion(receivers[i]->devices[j]);
+		}
 	}
 
-	if ((enumerate = udev_enumerate_new(udev)) == NULL) {
-		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_new() failed");
+	return 0;
+}
+
+int slavery_set_config(slavery_t *slavery, slavery_config_t *config) {
+	pthread_mutex_lock(&slavery->receivers_mutex);
+
+	slavery_config_t *old_config = slavery->config;
+	slavery_virtual_input_t *old_input = NULL;
 
-		udev_unref(udev);
+	// Creating a device takes a while and makes every client see a new one, so it is only replaced when the
+	// config's outputs need different codes.
+	if (config != NULL && (slavery->input == NULL || old_config == NULL ||
+	                       !slavery_virtual_input_caps_equal(&config->caps, &old_config->caps))) {
+		old_input = slavery->input;
+		slavery->input = NULL;
 
+		if (config->caps.num_keys + config->caps.num_rels > 0) {
+			slavery->input = slavery_virtual_input_new(&config->caps);
+		}
+	}
+
+	slavery->config = config;
+	slavery_apply_config(slavery, slavery->receivers, slavery->num_receivers, config);
+
+	// The old tables have been reclaimed, and they were the only references to the old config and device.
+	if (old_config != NULL) {
+		slavery_config_free(old_config);
+	}
+
+	if (old_input != NULL) {
+		slavery_virtual_input_free(old_input);
+	}
+
+	pthread_mutex_unlock(&slavery->receivers_mutex);
+
+	return 0;
+}
+
+int slavery_watch_config(slavery_t *slavery, const char *path) {
+	slavery_config_t *config;
+
+	if ((config = slavery_config_new(path)) == NULL) {
 		return -1;
 	}
 
-	if (udev_enumerate_add_match_subsystem(enumerate, "hidraw") < 0) {
-		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_add_match_subsystem() failed");
+	if (slavery_set_config(slavery, config) < 0) {
+		return -1;
+	}
 
-		udev_enumerate_unref(enumerate);
-		udev_unref(udev);
+	if (slavery->watch == NULL && (slavery->watch = slavery_config_watch_new(slavery, path)) == NULL) {
+		log_warning(SLAVERY_ERROR_OS, "failed to watch config file %s", path);
 
 		return -1;
 	}
 
-	if (udev_enumerate_scan_devices(enumerate) < 0) {
-		log_warning(SLAVERY_ERROR_UDEV, "udev_enumerate_scan_devices() failed");
+	return 0;
+}
+
+void slavery_add_receiver(slavery_t *slavery, slavery_receiver_t *receiver) {
+	pthread_mutex_lock(&slavery->receivers_mutex);
+
+	// The config is applied under the same lock, so a reload can't miss a receiver or reach it twice.
+	if (slavery->config != NULL && receiver->num_devices > 0) {
+		slavery_apply_config(slavery, &receiver, 1, slavery->config);
+	}
+
+	slavery->receivers =
+	    realloc(slavery->receivers, sizeof(slavery_receiver_t *) * (slavery->num_receivers + 1));
+	slavery->receivers[slavery->num_receivers++] = receiver;
+
+	pthread_mutex_unlock(&slavery->receivers_mutex);
+}
+
+slavery_receiver_t *slavery_remove_receiver(slavery_t *slavery, const char *devnode) {
+	slavery_receiver_t *receiver = NULL;
+
+	pthread_mutex_lock(&slavery->receivers_mutex);
+
+	for (size_t i = 0; i < slavery->num_receivers; i++) {
+		if (strcmp(slavery->receivers[i]->devnode, devnode) == 0) {
+			receiver = slavery->receivers[i];
+
+			for (size_t j = i + 1; j < slavery->num_receivers; j++) {
+				slavery->receivers[j - 1] = slavery->receivers[j];
+			}
+
+			slavery->num_receivers--;
+
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&slavery->receivers_mutex);
+
+	return receiver;
+}
+
+typedef struct slavery_receiver_probe_t {
+	slavery_t *slavery;
+	char *devnode;
+	slavery_receiver_t *receiver;
+	pthread_t thread;
+	bool started;
+} slavery_receiver_probe_t;
+
+static void *slavery_receiver_probe_run(slavery_receiver_probe_t *probe) {
+	probe->receiver = slavery_receiver_from_devnode(probe->slavery, probe->devnode);
+
+	if (probe->receiver == NULL) {
+		log_debug("failed to create receiver from devnode %s, ignoring devnode", probe->devnode);
+	}
+
+	return NULL;
+}
+
+ssize_t slavery_scan_receivers(slavery_t *slavery) {
+	log_debug("scanning for receivers...");
 
-		udev_enumerate_unref(enumerate);
-		udev_unref(udev);
+	slavery_receiver_probe_t *probes = NULL;
+	char **devnodes;
+	ssize_t num_probes;
+	uint64_t start_ns = time_monotonic_ns();
 
+	// Candidates are filtered on vendor and product IDs before anything is opened, so unrelated HID devices
+	// are never touched.
+	if ((num_probes = slavery->transport->discover(slavery->transport, &slavery->options, &devnodes)) < 0) {
 		return -1;
 	}
 
-	device_list = udev_enumerate_get_list_entry(enumerate);
+	probes = calloc(num_probes, sizeof(slavery_receiver_probe_t));
 
-	udev_list_entry_foreach(device_entry, device_list) {
-		const char *sys_path = udev_list_entry_get_name(device_entry);
-		struct udev_device *device = udev_device_new_from_syspath(udev, sys_path);
-		const char *devnode = udev_device_get_devnode(device);
+	for (ssize_t i = 0; i < num_probes; i++) {
+		probes[i] = (slavery_receiver_probe_t){.slavery = slavery, .devnode = devnodes[i]};
+	}
 
-		log_debug("found devnode on %s, checking if it is a receiver", devnode);
+	free(devnodes);
 
-		slavery_receiver_t *receiver = slavery_receiver_from_devnode(devnode);
+	slavery->scan_timings.discover_ns = time_monotonic_ns() - start_ns;
+	start_ns = time_monotonic_ns();
+
+	// Open and identify every candidate at once, so a slow node doesn't hold up the rest.
+	for (ssize_t i = 0; i < num_probes; i++) {
+		probes[i].started = true;
+
+		if ((errno = pthread_create(
+		         &probes[i].thread, NULL, (pthread_callback_t)slavery_receiver_probe_run, &probes[i])) != 0) {
+			log_warning_errno(
+			    SLAVERY_ERROR_OS, "pthread_create() failed, probing %s inline", probes[i].devnode);
+
+			probes[i].started = false;
+			slavery_receiver_probe_run(&probes[i]);
+		}
+	}
 
-		if (receiver == NULL) {
-			log_debug("failed to create receiver from devnode %s, ignoring devnode", devnode);
+	pthread_mutex_lock(&slavery->receivers_mutex);
 
-			udev_device_unref(device);
+	slavery->num_receivers = 0;
+	slavery->receivers = NULL;
 
-			continue;
+	for (ssize_t i = 0; i < num_probes; i++) {
+		if (probes[i].started) {
+			pthread_join(probes[i].thread, NULL);
 		}
 
-		slavery->receivers =
-		    realloc(slavery->receivers, sizeof(slavery_receiver_t) * (slavery->num_receivers + 1));
-		slavery->receivers[slavery->num_receivers++] = receiver;
+		if (probes[i].receiver != NULL) {
+			slavery->receivers =
+			    realloc(slavery->receivers, sizeof(slavery_receiver_t) * (slavery->num_receivers + 1));
+			slavery->receivers[slavery->num_receivers++] = probes[i].receiver;
+		}
 
-		udev_device_unref(device);
+		free(probes[i].devnode);
 	}
 
-	udev_enumerate_unref(enumerate);
-	udev_unref(udev);
+	pthread_mutex_unlock(&slavery->receivers_mutex);
+
+	free(probes);
+
+	slavery->scan_timings.open_ns = time_monotonic_ns() - start_ns;
 
 	log_debug("found %u receivers", slavery->num_receivers);
+	log_debug("discovery took %luus, opening receivers took %luus",
+	          slavery->scan_timings.discover_ns / 1000,
+	          slavery->scan_timings.open_ns / 1000);
 
 	return slavery->num_receivers;
 }
 
+typedef struct slavery_device_scan_t {
+	slavery_receiver_t *receiver;
+	ssize_t num_devices;
+	pthread_t thread;
+	bool started;
+} slavery_device_scan_t;
+
+static void *slavery_device_scan_run(slavery_device_scan_t *scan) {
+	scan->num_devices = slavery_receiver_scan_devices(scan->receiver);
+
+	return NULL;
+}
+
+ssize_t slavery_scan_devices(slavery_t *slavery) {
+	// Hotplug and config reloads can't reach receivers while their devices are being replaced.
+	pthread_mutex_lock(&slavery->receivers_mutex);
+
+	log_debug("scanning for devices on %lu receivers...", slavery->num_receivers);
+
+	slavery_device_scan_t scans[slavery->num_receivers + 1];
+	uint64_t start_ns = time_monotonic_ns();
+	ssize_t num_devices = 0;
+
+	for (size_t i = 0; i < slavery->num_receivers; i++) {
+		scans[i].receiver = slavery->receivers[i];
+		scans[i].started = true;
+
+		if ((errno = pthread_create(
+		         &scans[i].thread, NULL, (pthread_callback_t)slavery_device_scan_run, &scans[i])) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed, scanning inline");
+
+			scans[i].started = false;
+			slavery_device_scan_run(&scans[i]);
+		}
+	}
+
+	for (size_t i = 0; i < slavery->num_receivers; i++) {
+		if (scans[i].started) {
+			pthread_join(scans[i].thread, NULL);
+		}
+
+		if (scans[i].num_devices > 0) {
+			num_devices += scans[i].num_devices;
+		}
+	}
+
+	slavery->scan_timings.devices_ns = time_monotonic_ns() - start_ns;
+
+	if (slavery->config != NULL) {
+		slavery_apply_config(slavery, slavery->receivers, slavery->num_receivers, slavery->config);
+	}
+
+	if (slavery->cache != NULL) {
+		slavery_cache_save(slavery->cache, slavery);
+	}
+
+	pthread_mutex_unlock(&slavery->receivers_mutex);
+
+	log_debug("found %ld devices in %luus", num_devices, slavery->scan_timings.devices_ns / 1000);
+
+	return num_devices;
+}
+
+void slavery_get_scan_timings(slavery_t *slavery, slavery_scan_timings_t *timings) {
+	*timings = slavery->scan_timings;
+}
+
+void slavery_get_launcher_stats(slavery_t *slavery, slavery_launcher_stats_t *stats) {
+	if (slavery->launcher == NULL) {
+		*stats = (slavery_launcher_stats_t){0};
+
+		return;
+	}
+
+	slavery_launcher_get_stats(slavery->launcher, stats);
+}
+
+size_t slavery_get_num_workers(slavery_t *slavery) {
+	return slavery->pool->num_workers;
+}
+
+void slavery_get_pool_stats(slavery_t *slavery, size_t worker_index, slavery_pool_stats_t *stats) {
+	slavery_pool_get_stats(slavery->pool, worker_index, stats);
+}
+
+void slavery_get_report_pool_stats(slavery_t *slavery, slavery_report_pool_stats_t *stats) {
+	slavery_report_pool_get_stats(slavery->reports, stats);
+}
+
 slavery_receiver_t *slavery_get_receiver(slavery_t *slavery, size_t receiver_index) {
 	return slavery->receivers[receiver_index];
 }
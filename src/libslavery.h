@@ -16,6 +16,7 @@
 
 #include "utils.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -46,7 +47,266 @@ typedef struct slavery_button_t slavery_button_t;
  */
 typedef struct slavery_monitor_t slavery_monitor_t;
 
+/**
+ * @brief Opaque type for a recorded trace being replayed.
+ */
+typedef struct slavery_replay_t slavery_replay_t;
+
+typedef struct slavery_transport_t slavery_transport_t;
+
+/**
+ * @brief Ways of finding receiver candidates among hidraw nodes.
+ */
+typedef enum
+{
+	/**
+	 * @brief Read vendor and product IDs straight from sysfs uevent files, falling back to udev if sysfs
+	 * isn't available.
+	 */
+	SLAVERY_DISCOVERY_SYSFS,
+
+	/**
+	 * @brief Enumerate hidraw devices with libudev and match on the HID parent's properties.
+	 */
+	SLAVERY_DISCOVERY_UDEV
+} slavery_discovery_backend_t;
+
+/**
+ * @brief Library options, set before creating a slavery context.
+ */
+typedef struct slavery_options_t {
+	/**
+	 * @brief Number of threads dispatching device events.
+	 */
+	size_t num_workers;
+
+	/**
+	 * @brief Number of events each worker can have queued before new events are dropped.
+	 */
+	size_t worker_queue_size;
+
+	/**
+	 * @brief Number of preallocated report slots shared by all receivers, or 0 to size it from the workers'
+	 * queues. When every slot is in use, events are dropped until one is released.
+	 */
+	size_t report_pool_size;
+
+	/**
+	 * @brief Service all receivers and the udev monitor from a single epoll thread, rather than a thread
+	 * each.
+	 */
+	bool reactor;
+
+	/**
+	 * @brief Service all receivers through io_uring, with multishot reads and batched request writes. Takes
+	 * precedence over the reactor, and is ignored when built without io_uring support.
+	 */
+	bool io_uring;
+
+	/**
+	 * @brief Milliseconds to wait for each HID++ response before giving up, or 0 to wait forever.
+	 */
+	unsigned int request_timeout_ms;
+
+	/**
+	 * @brief Number of times a request is retried after the device reports it is busy.
+	 */
+	unsigned int request_retries;
+
+	/**
+	 * @brief Milliseconds to wait before the first busy retry. Doubles for each further retry.
+	 */
+	unsigned int request_backoff_ms;
+
+	/**
+	 * @brief How receivers are found. Either way, only nodes with a receiver's vendor and product IDs are
+	 * opened.
+	 */
+	slavery_discovery_backend_t discovery;
+
+	/**
+	 * @brief Build devices from the on-disk device cache when their firmware hasn't changed, rather than
+	 * querying everything over the wireless link.
+	 */
+	bool cache;
+
+	/**
+	 * @brief Fill in known models from built-in profiles when their firmware matches exactly, rather than
+	 * discovering their features and buttons.
+	 */
+	bool profiles;
+
+	/**
+	 * @brief Path of the device cache, or NULL for $XDG_CACHE_HOME/slavery/devices.cache.
+	 */
+	const char *cache_path;
+
+	/**
+	 * @brief Milliseconds a chord has to stay pressed before its hold actions run.
+	 */
+	unsigned int hold_ms;
+
+	/**
+	 * @brief Milliseconds allowed between releasing a chord and pressing it again for the presses to count
+	 * towards a double or triple tap.
+	 */
+	unsigned int multi_tap_ms;
+
+	/**
+	 * @brief Distance in sensor counts a gesture button has to be moved along one axis, while held, for its
+	 * release to count as a gesture rather than a press.
+	 */
+	unsigned int gesture_threshold;
+
+	/**
+	 * @brief Path of a pcapng file to record every HID++ report read from or written to a receiver in, or
+	 * NULL not to capture. The file uses the Linux usbmon link type, with each receiver's hidraw minor as its
+	 * bus number and the HID++ device index as the device address.
+	 */
+	const char *capture_path;
+
+	/**
+	 * @brief How receivers are found and talked to, or NULL for their hidraw nodes. Hotplug monitoring is
+	 * only done for hidraw.
+	 */
+	const slavery_transport_t *transport;
+} slavery_options_t;
+
+/**
+ * @brief What a transport knows about a receiver it has opened.
+ */
+typedef struct slavery_transport_info_t {
+	uint16_t vendor_id;
+	uint16_t product_id;
+
+	/**
+	 * @brief Number telling receivers apart in captures, such as the N in /dev/hidrawN.
+	 */
+	uint16_t minor;
+
+	char name[256];
+	char address[256];
+} slavery_transport_info_t;
+
+/**
+ * @brief Finds receivers, and reads and writes their reports.
+ *
+ * A receiver is a file descriptor polled by whichever of io_uring, the reactor or a listener thread is in
+ * use, so open has to return a non-blocking descriptor that becomes readable with each report and gives one
+ * whole report per read. io_uring reads and writes the descriptor itself, without going through read and
+ * write.
+ */
+struct slavery_transport_t {
+	const char *name;
+
+	/**
+	 * @brief Passed back to the transport through every function, for its own state.
+	 */
+	void *data;
+
+	/**
+	 * @brief Lists receiver candidates, as paths allocated with malloc() in an array allocated the same way.
+	 *
+	 * @return ssize_t Number of paths, < 0 on error.
+	 */
+	ssize_t (*discover)(const slavery_transport_t *transport,
+	                    const slavery_options_t *options,
+	                    char ***paths);
+
+	/**
+	 * @return int Descriptor of the opened receiver, < 0 on error with errno set.
+	 */
+	int (*open)(const slavery_transport_t *transport, const char *path);
+
+	/**
+	 * @return int 0 on success, < 0 on error.
+	 */
+	int (*info)(const slavery_transport_t *transport, const int fd, slavery_transport_info_t *info);
+
+	/**
+	 * @return ssize_t Size of the report read, < 0 with errno set to EAGAIN when there are none left.
+	 */
+	ssize_t (*read)(const slavery_transport_t *transport, const int fd, uint8_t data[], const size_t size);
+
+	/**
+	 * @return ssize_t Number of bytes written, < 0 on error.
+	 */
+	ssize_t (*write)(const slavery_transport_t *transport,
+	                 const int fd,
+	                 const uint8_t data[],
+	                 const size_t size);
+
+	int (*close)(const slavery_transport_t *transport, const int fd);
+};
+
+/**
+ * @brief Receivers as hidraw nodes, found with slavery_options_t::discovery. The default transport.
+ */
+extern const slavery_transport_t slavery_transport_hidraw;
+
+/**
+ * @brief HID++ request counters for a device.
+ */
+typedef struct slavery_request_stats_t {
+	/**
+	 * @brief Requests sent, including retries.
+	 */
+	size_t requests;
+
+	/**
+	 * @brief Requests that received no response before their deadline.
+	 */
+	size_t timeouts;
+
+	/**
+	 * @brief Requests resent after the device reported it was busy.
+	 */
+	size_t retries;
+
+	/**
+	 * @brief Requests answered with an error report.
+	 */
+	size_t errors;
+} slavery_request_stats_t;
+
+/**
+ * @brief Sets the least severe level of message logged, which can be changed at any time from any thread.
+ * Messages below it cost a single comparison. Defaults to LOG_LEVEL_DEBUG in debug builds and
+ * LOG_LEVEL_WARNING otherwise.
+ *
+ * @param level Least severe level to log.
+ */
+void slavery_set_log_level(const slavery_log_level_t level);
+
+/**
+ * @brief Gets the least severe level of message logged.
+ *
+ * @return slavery_log_level_t Least severe level logged.
+ */
+slavery_log_level_t slavery_get_log_level();
+
+/**
+ * @brief Fills options with their default values.
+ *
+ * @param options Options to initialise.
+ */
+void slavery_options_init(slavery_options_t *options);
+
+/**
+ * @brief Creates a slavery context with default options.
+ *
+ * @return slavery_t* New context, or NULL on error.
+ */
 slavery_t *slavery_new();
+
+/**
+ * @brief Creates a slavery context.
+ *
+ * @param options Options to use, or NULL for defaults.
+ * @return slavery_t* New context, or NULL on error.
+ */
+slavery_t *slavery_new_with_options(const slavery_options_t *options);
+
 int slavery_free(slavery_t *slavery);
 
 /**
@@ -59,6 +319,285 @@ ssize_t slavery_scan_receivers(slavery_t *slavery);
 
 slavery_receiver_t *slavery_get_receiver(slavery_t *slavery, size_t receiver_index);
 
+/**
+ * @brief Detects compatible devices on every receiver, probing all receivers and device slots concurrently.
+ *
+ * @param slavery Context whose receivers to scan.
+ * @return ssize_t Total number of devices found, < 0 on error.
+ */
+ssize_t slavery_scan_devices(slavery_t *slavery);
+
+/**
+ * @brief Time spent in each phase of the last scan.
+ */
+typedef struct slavery_scan_timings_t {
+	/**
+	 * @brief Nanoseconds spent enumerating candidate hidraw nodes.
+	 */
+	uint64_t discover_ns;
+
+	/**
+	 * @brief Nanoseconds spent opening and identifying receivers.
+	 */
+	uint64_t open_ns;
+
+	/**
+	 * @brief Nanoseconds spent probing device slots on all receivers.
+	 */
+	uint64_t devices_ns;
+} slavery_scan_timings_t;
+
+/**
+ * @brief Get the time spent in each phase of the last scan.
+ *
+ * @param slavery Context to get timings for.
+ * @param timings Timings to fill.
+ */
+void slavery_get_scan_timings(slavery_t *slavery, slavery_scan_timings_t *timings);
+
+/**
+ * @brief Counters for commands run by config entries, and how long they took to start.
+ */
+typedef struct slavery_launcher_stats_t {
+	/**
+	 * @brief Commands started.
+	 */
+	size_t launched;
+
+	/**
+	 * @brief Commands that could not be started, such as those not found in $PATH.
+	 */
+	size_t failed;
+
+	/**
+	 * @brief Commands dropped because the launcher could not take them without blocking.
+	 */
+	size_t dropped;
+
+	/**
+	 * @brief Nanoseconds from the last command being requested to its process starting.
+	 */
+	uint64_t last_ns;
+
+	/**
+	 * @brief Longest time in nanoseconds any command took to start.
+	 */
+	uint64_t max_ns;
+
+	/**
+	 * @brief Total time in nanoseconds all started commands took to start, for working out the mean.
+	 */
+	uint64_t total_ns;
+} slavery_launcher_stats_t;
+
+/**
+ * @brief Get counters and start latencies for commands run by config entries.
+ *
+ * @param slavery Context to get stats for.
+ * @param stats Stats to fill, all zero if the launcher could not be started.
+ */
+void slavery_get_launcher_stats(slavery_t *slavery, slavery_launcher_stats_t *stats);
+
+/**
+ * @brief Counters for one event worker's queue.
+ */
+typedef struct slavery_pool_stats_t {
+	/**
+	 * @brief Events waiting in the queue.
+	 */
+	size_t depth;
+
+	/**
+	 * @brief Most events that have been waiting in the queue at once.
+	 */
+	size_t max_depth;
+
+	/**
+	 * @brief Events dropped because the queue was full.
+	 */
+	size_t dropped;
+
+	/**
+	 * @brief Events the worker has dispatched.
+	 */
+	size_t dispatched;
+} slavery_pool_stats_t;
+
+/**
+ * @brief Get the number of event workers, each with its own queue.
+ *
+ * @param slavery Context to get the number of workers for.
+ * @return size_t Number of workers.
+ */
+size_t slavery_get_num_workers(slavery_t *slavery);
+
+/**
+ * @brief Get the queue counters of an event worker.
+ *
+ * @param slavery Context to get stats for.
+ * @param worker_index Index of the worker, < slavery_get_num_workers().
+ * @param stats Stats to fill.
+ */
+void slavery_get_pool_stats(slavery_t *slavery, size_t worker_index, slavery_pool_stats_t *stats);
+
+/**
+ * @brief Counters for the slab reports are read into.
+ */
+typedef struct slavery_report_pool_stats_t {
+	/**
+	 * @brief Report slots in the slab.
+	 */
+	size_t size;
+
+	/**
+	 * @brief Slots holding a report that is being read, queued or dispatched.
+	 */
+	size_t in_use;
+
+	/**
+	 * @brief Times a slot was wanted while every one was in use. Responses still reach their requests, but
+	 * events read then are dropped.
+	 */
+	size_t exhausted;
+} slavery_report_pool_stats_t;
+
+/**
+ * @brief Get how much of the report slab is in use, and how often it has run out.
+ *
+ * @param slavery Context to get stats for.
+ * @param stats Stats to fill.
+ */
+void slavery_get_report_pool_stats(slavery_t *slavery, slavery_report_pool_stats_t *stats);
+
+/**
+ * @brief Latency percentiles for one stage of the event pipeline.
+ */
+typedef struct slavery_replay_latency_t {
+	uint64_t p50_ns;
+	uint64_t p90_ns;
+	uint64_t p99_ns;
+	uint64_t p999_ns;
+	uint64_t max_ns;
+} slavery_replay_latency_t;
+
+/**
+ * @brief Results of replaying a trace's events once.
+ */
+typedef struct slavery_replay_stats_t {
+	/**
+	 * @brief Events fed to the receiver.
+	 */
+	size_t events;
+
+	/**
+	 * @brief Events that made it through dispatch. The rest were dropped on the way, by a full report pool or
+	 * worker queue.
+	 */
+	size_t dispatched;
+
+	/**
+	 * @brief Requests made by the library during the run and answered from the trace.
+	 */
+	size_t answered;
+
+	/**
+	 * @brief Requests made by the library during the run with no recorded response, answered with an error.
+	 */
+	size_t refused;
+
+	/**
+	 * @brief Nanoseconds from the first event being fed to the last one being dispatched.
+	 */
+	uint64_t elapsed_ns;
+
+	/**
+	 * @brief From an event being written to the socket to the receiver reading it.
+	 */
+	slavery_replay_latency_t read;
+
+	/**
+	 * @brief From an event being read to a worker taking it off its queue.
+	 */
+	slavery_replay_latency_t queue;
+
+	/**
+	 * @brief From a worker taking an event to it being dispatched, running any chords it completes.
+	 */
+	slavery_replay_latency_t dispatch;
+
+	/**
+	 * @brief From an event being written to the socket to it being dispatched.
+	 */
+	slavery_replay_latency_t total;
+} slavery_replay_stats_t;
+
+/**
+ * @brief Loads a pcapng trace and sets up a context whose only receiver replays it.
+ *
+ * The trace is mapped rather than read. Devices are discovered by answering the library's requests with the
+ * responses recorded for them, so the trace has to include discovery, as one recorded without a device
+ * cache does. Only the first receiver found in the trace is replayed, and the cache is never used.
+ *
+ * @param path Trace file path.
+ * @param options Options for the context, or NULL for defaults.
+ * @param config_path Config file to apply to the replayed devices, or NULL for none.
+ * @return slavery_replay_t* New replay, or NULL on error.
+ */
+slavery_replay_t *slavery_replay_new(const char *path,
+                                     const slavery_options_t *options,
+                                     const char *config_path);
+
+/**
+ * @brief Feeds every event in the trace through the receiver once and waits for them to be dispatched.
+ *
+ * Nothing is allocated by the replay while it runs, so any allocations made in the meantime are the
+ * pipeline's own.
+ *
+ * @param replay Replay to run.
+ * @param fast true to feed events as fast as they are taken, false to keep the gaps between them in the
+ * trace.
+ * @return int 0 on success, < 0 if the trace has no events.
+ */
+int slavery_replay_run(slavery_replay_t *replay, const bool fast);
+
+/**
+ * @brief Gets throughput and per-stage latencies for the last run.
+ *
+ * @param replay Replay to get stats for.
+ * @param stats Stats to fill.
+ */
+void slavery_replay_get_stats(slavery_replay_t *replay, slavery_replay_stats_t *stats);
+
+/**
+ * @brief Frees a replay, along with its context.
+ *
+ * @param replay Replay to free.
+ */
+void slavery_replay_free(slavery_replay_t *replay);
+
+/**
+ * @brief Applies a config to every device, now and as devices are found.
+ *
+ * Each device's compiled rules are swapped in atomically, so events keep being handled throughout. The
+ * previous config is freed once no event can still be using it.
+ *
+ * @param slavery Context to configure.
+ * @param config Config to apply, owned by the context from then on, or NULL to remove all rules.
+ * @return int 0 on success, < 0 on error.
+ */
+int slavery_set_config(slavery_t *slavery, slavery_config_t *config);
+
+/**
+ * @brief Loads a config file and applies it again each time the file changes.
+ *
+ * A change that fails to parse is logged and leaves the current config in place.
+ *
+ * @param slavery Context to configure.
+ * @param path Config file path.
+ * @return int 0 on success, < 0 on error.
+ */
+int slavery_watch_config(slavery_t *slavery, const char *path);
+
 /**
  * @brief Frees all memory created under the context of an array of receivers.
  *
@@ -95,11 +634,23 @@ slavery_device_t *slavery_receiver_get_device(slavery_receiver_t *receiver, cons
 /**
  * @brief Reads config file from a file path.
  *
+ * The path may be a JSON config or one compiled by slavery_config_compile(). A JSON config is loaded from its
+ * compiled form in the user's cache, which is rebuilt first if the JSON has changed since.
+ *
  * @param path Config file path.
  * @return slavery_config_t* Config object.
  */
 slavery_config_t *slavery_config_new(const char *path);
 
+/**
+ * @brief Compiles a JSON config into the binary form slavery_config_new() maps without parsing.
+ *
+ * @param path JSON config file path.
+ * @param output_path Compiled config path, or NULL for the cached copy slavery_config_new() looks for.
+ * @return int 0 on success, -1 on failure.
+ */
+int slavery_config_compile(const char *path, const char *output_path);
+
 /**
  * @brief Free config data.
  *
@@ -116,14 +667,25 @@ void slavery_config_free(slavery_config_t *config);
 void slavery_device_array_free(slavery_device_t *devices[], const ssize_t num_devices);
 
 /**
- * @brief Set device config.
+ * @brief Set device config. Kept for existing callers, use slavery_set_config() instead.
  *
- * @param device Device to apply config to.
+ * The config is applied to every device through slavery_set_config(), which takes ownership of it, so the
+ * caller mustn't free it.
+ *
+ * @param device Device whose context to apply config to.
  * @param config Config to apply.
  * @return int 0 on success, < 0 on error.
  */
 int slavery_device_set_config(slavery_device_t *device, const slavery_config_t *config);
 
+/**
+ * @brief Get HID++ request counters for a device.
+ *
+ * @param device Device to get counters for.
+ * @param stats Counters to fill.
+ */
+void slavery_device_get_request_stats(slavery_device_t *device, slavery_request_stats_t *stats);
+
 /**
  * @brief Frees all memory for a device.
  *
@@ -1,17 +1,56 @@
 #pragma once
 
+#include "libslavery.h"
+
+#include <pthread.h>
 #include <sys/types.h>
 
 typedef struct slavery_receiver_t slavery_receiver_t;
 typedef struct slavery_monitor_t slavery_monitor_t;
+typedef struct slavery_pool_t slavery_pool_t;
+typedef struct slavery_reactor_t slavery_reactor_t;
+typedef struct slavery_cache_t slavery_cache_t;
+typedef struct slavery_report_pool_t slavery_report_pool_t;
+typedef struct slavery_uring_t slavery_uring_t;
+typedef struct slavery_config_watch_t slavery_config_watch_t;
+typedef struct slavery_launcher_t slavery_launcher_t;
+typedef struct slavery_capture_t slavery_capture_t;
+typedef struct slavery_virtual_input_t slavery_virtual_input_t;
 
 typedef struct slavery_t {
+	slavery_options_t options;
+	const slavery_transport_t *transport;
+	// Guards the receivers and their devices, the config and the virtual device. No I/O thread takes it, so
+	// requests can be made while holding it.
+	pthread_mutex_t receivers_mutex;
 	size_t num_receivers;
 	slavery_receiver_t **receivers;
 	slavery_monitor_t *monitor;
+	slavery_pool_t *pool;
+	slavery_report_pool_t *reports;
+	slavery_reactor_t *reactor;
+	slavery_uring_t *uring;
+	slavery_cache_t *cache;
+	slavery_scan_timings_t scan_timings;
+	slavery_config_t *config;
+	// Guards each device's record of its diverted controls, which workers also reset on reconnection.
+	pthread_mutex_t diversion_mutex;
+	slavery_config_watch_t *watch;
+	slavery_virtual_input_t *input;
+	slavery_launcher_t *launcher;
+	slavery_capture_t *capture;
 } slavery_t;
 
+void slavery_options_init(slavery_options_t *options);
 slavery_t *slavery_new();
+slavery_t *slavery_new_with_options(const slavery_options_t *options);
 int slavery_free(slavery_t *slavery);
 ssize_t slavery_scan_receivers(slavery_t *slavery);
 slavery_receiver_t *slavery_get_receiver(slavery_t *slavery, size_t receiver_index);
+ssize_t slavery_scan_devices(slavery_t *slavery);
+void slavery_get_scan_timings(slavery_t *slavery, slavery_scan_timings_t *timings);
+void slavery_get_launcher_stats(slavery_t *slavery, slavery_launcher_stats_t *stats);
+int slavery_set_config(slavery_t *slavery, slavery_config_t *config);
+int slavery_watch_config(slavery_t *slavery, const char *path);
+void slavery_add_receiver(slavery_t *slavery, slavery_receiver_t *receiver);
+slavery_receiver_t *slavery_remove_receiver(slavery_t *slavery, const char *devnode);
@@ -0,0 +1,363 @@
+/**
+ * @file
+ * @brief Asynchronous logger implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "log.h"
+
+#include "libslavery.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef DEBUG
+slavery_log_level_t slavery_log_level = LOG_LEVEL_DEBUG;
+#else
+slavery_log_level_t slavery_log_level = LOG_LEVEL_WARNING;
+#endif
+
+static const char *slavery_log_level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+static slavery_log_t slavery_log = {.mutex = PTHREAD_MUTEX_INITIALIZER, .fd = -1};
+static pthread_once_t slavery_log_once = PTHREAD_ONCE_INIT;
+static __thread slavery_log_ring_t *slavery_log_thread_ring = NULL;
+
+static void slavery_log_ring_close(void *data) {
+	slavery_log_ring_t *ring = data;
+
+	// The writer frees the ring once it has caught up, the thread never touches it again.
+	slavery_log_thread_ring = NULL;
+	atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+static void slavery_log_wake() {
+	uint64_t value = 1;
+
+	if (write(slavery_log.fd, &value, sizeof(value)) < 0) {
+		// The counter is already non-zero, so the writer is due to wake anyway.
+	}
+}
+
+static void *slavery_log_run(void *data) {
+	UNUSED(data);
+
+	struct pollfd pollfd = {.fd = slavery_log.fd, .events = POLLIN};
+	uint64_t value;
+
+	// Failing to name the thread isn't logged, as the writer must never write to its own ring.
+	pthread_setname_np(pthread_self(), "log");
+
+	while (true) {
+		// Only being woken matters, not how many times.
+		if (poll(&pollfd, 1, SLAVERY_LOG_FLUSH_MS) > 0 && read(slavery_log.fd, &value, sizeof(value)) < 0) {
+			value = 0;
+		}
+
+		slavery_log_flush();
+	}
+
+	return NULL;
+}
+
+static void slavery_log_init() {
+	pthread_key_create(&slavery_log.key, slavery_log_ring_close);
+
+	// Messages still queued when the program exits, including the one log_error() exits after, are written
+	// on the way out.
+	atexit(slavery_log_flush);
+
+	if ((slavery_log.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		return;
+	}
+
+	if (pthread_create(&slavery_log.thread, NULL, slavery_log_run, NULL) == 0) {
+		pthread_detach(slavery_log.thread);
+
+		slavery_log.running = true;
+	}
+}
+
+static slavery_log_ring_t *slavery_log_ring_get() {
+	if (slavery_log_thread_ring != NULL) {
+		return slavery_log_thread_ring;
+	}
+
+	pthread_once(&slavery_log_once, slavery_log_init);
+
+	slavery_log_ring_t *ring = calloc(1, sizeof(slavery_log_ring_t));
+
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	pthread_getname_np(pthread_self(), ring->thread_name, sizeof(ring->thread_name));
+	pthread_setspecific(slavery_log.key, ring);
+
+	pthread_mutex_lock(&slavery_log.mutex);
+
+	ring->next = slavery_log.rings;
+	slavery_log.rings = ring;
+
+	pthread_mutex_unlock(&slavery_log.mutex);
+
+	slavery_log_thread_ring = ring;
+
+	return ring;
+}
+
+static void slavery_log_push(const slavery_log_level_t level,
+                             const bool has_error,
+                             const slavery_error_t error,
+                             const int errno_value,
+                             const char *file,
+                             const char *func,
+                             const int line,
+                             const char *fmt,
+                             va_list args) {
+	slavery_log_ring_t *ring = slavery_log_ring_get();
+
+	if (ring == NULL) {
+		return;
+	}
+
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	// A full ring drops the message rather than wait for the writer, and the writer reports how many went. An
+	// error is often the last thing logged before exiting, so it empties the rings itself to make room.
+	if (head - tail == SLAVERY_LOG_RING_SIZE && level >= LOG_LEVEL_ERROR) {
+		slavery_log_flush();
+
+		tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	} else if (head - tail == SLAVERY_LOG_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+
+		if (slavery_log.running) {
+			slavery_log_wake();
+		}
+
+		return;
+	}
+
+	slavery_log_record_t *record = &ring->records[head & (SLAVERY_LOG_RING_SIZE - 1)];
+
+	record->time_ns = time_monotonic_ns();
+	record->file = file;
+	record->func = func;
+	record->line = line;
+	record->level = level;
+	record->has_error = has_error;
+	record->error = error;
+	record->errno_value = errno_value;
+
+	vsnprintf(record->message, sizeof(record->message), fmt, args);
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	// Warnings and errors go out straight away, anything else on the writer's next pass unless the ring is
+	// filling up. Without a writer thread, every message is written as it is logged.
+	if (!slavery_log.running) {
+		slavery_log_flush();
+	} else if (level >= LOG_LEVEL_WARNING || head + 1 - tail >= SLAVERY_LOG_RING_SIZE / 2) {
+		slavery_log_wake();
+	}
+}
+
+static size_t slavery_log_format(char buffer[],
+                                 const size_t size,
+                                 const slavery_log_ring_t *ring,
+                                 const slavery_log_record_t *record) {
+	const char *level = slavery_log_level_names[record->level];
+	char errno_string[128];
+	int length;
+
+	if (!record->has_error) {
+		length = snprintf(buffer,
+		                  size,
+		                  "%s: %s:%s:%d: [thread: %s]: %s\n",
+		                  level,
+		                  record->file,
+		                  record->func,
+		                  record->line,
+		                  ring->thread_name,
+		                  record->message);
+	} else if (record->errno_value < 0) {
+		length = snprintf(buffer,
+		                  size,
+		                  "%s: %s:%s:%d: %s: [thread: %s]: %s\n",
+		                  level,
+		                  record->file,
+		                  record->func,
+		                  record->line,
+		                  slavery_error_to_string(record->error),
+		                  ring->thread_name,
+		                  record->message);
+	} else {
+		length = snprintf(buffer,
+		                  size,
+		                  "%s: %s:%s:%d: %s: [thread: %s]: %s: syscall(): \"%s\"\n",
+		                  level,
+		                  record->file,
+		                  record->func,
+		                  record->line,
+		                  slavery_error_to_string(record->error),
+		                  ring->thread_name,
+		                  record->message,
+		                  strerror_r(record->errno_value, errno_string, sizeof(errno_string)));
+	}
+
+	return length < 0 ? 0 : (size_t)length;
+}
+
+static void slavery_log_write(const char buffer[], const size_t size) {
+	size_t written = 0;
+
+	while (written < size) {
+		ssize_t result = write(STDERR_FILENO, buffer + written, size - written);
+
+		if (result < 0 && errno != EINTR) {
+			return;
+		}
+
+		written += result > 0 ? result : 0;
+	}
+}
+
+void slavery_log_flush() {
+	char buffer[16384];
+	size_t used = 0;
+	int local_errno = errno;
+
+	pthread_mutex_lock(&slavery_log.mutex);
+
+	// Each ring is already in order, so always taking the oldest record at the front of any ring writes every
+	// thread's messages interleaved as they happened.
+	while (true) {
+		slavery_log_ring_t *oldest = NULL;
+		const slavery_log_record_t *record = NULL;
+
+		for (slavery_log_ring_t *ring = slavery_log.rings; ring != NULL; ring = ring->next) {
+			size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+			if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+				continue;
+			}
+
+			const slavery_log_record_t *candidate = &ring->records[tail & (SLAVERY_LOG_RING_SIZE - 1)];
+
+			if (record == NULL || candidate->time_ns < record->time_ns) {
+				oldest = ring;
+				record = candidate;
+			}
+		}
+
+		if (oldest == NULL) {
+			break;
+		}
+
+		size_t length = slavery_log_format(buffer + used, sizeof(buffer) - used, oldest, record);
+
+		if (used + length >= sizeof(buffer)) {
+			slavery_log_write(buffer, used);
+
+			used = 0;
+			length = slavery_log_format(buffer, sizeof(buffer), oldest, record);
+
+			if (length >= sizeof(buffer)) {
+				length = sizeof(buffer) - 1;
+			}
+		}
+
+		used += length;
+
+		atomic_fetch_add_explicit(&oldest->tail, 1, memory_order_release);
+	}
+
+	slavery_log_write(buffer, used);
+
+	for (slavery_log_ring_t **next = &slavery_log.rings; *next != NULL;) {
+		slavery_log_ring_t *ring = *next;
+		size_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+
+		if (dropped > 0) {
+			int length = snprintf(buffer,
+			                      sizeof(buffer),
+			                      "%s: [thread: %s]: %zu log messages dropped\n",
+			                      slavery_log_level_names[LOG_LEVEL_WARNING],
+			                      ring->thread_name,
+			                      dropped);
+
+			slavery_log_write(buffer, length);
+		}
+
+		// A closed ring has had its last message written once it is empty.
+		if (atomic_load_explicit(&ring->closed, memory_order_acquire) &&
+		    atomic_load_explicit(&ring->head, memory_order_acquire) ==
+		        atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+			*next = ring->next;
+
+			free(ring);
+		} else {
+			next = &ring->next;
+		}
+	}
+
+	pthread_mutex_unlock(&slavery_log.mutex);
+
+	errno = local_errno;
+}
+
+void log_x(const slavery_log_level_t level,
+           const char *file,
+           const char *func,
+           const int line,
+           const char *fmt,
+           ...) {
+	int local_errno = errno;
+	va_list args;
+
+	va_start(args, fmt);
+	slavery_log_push(level, false, SLAVERY_ERROR_UNKNOWN, -1, file, func, line, fmt, args);
+	va_end(args);
+
+	errno = local_errno;
+}
+
+void log_x_error(const slavery_log_level_t level,
+                 const slavery_error_t error,
+                 const bool with_errno,
+                 const char *file,
+                 const char *func,
+                 const int line,
+                 const char *fmt,
+                 ...) {
+	int local_errno = errno;
+	va_list args;
+
+	va_start(args, fmt);
+	slavery_log_push(level, true, error, with_errno ? local_errno : -1, file, func, line, fmt, args);
+	va_end(args);
+
+	errno = local_errno;
+}
+
+void slavery_set_log_level(const slavery_log_level_t level) {
+	__atomic_store_n(&slavery_log_level, level, __ATOMIC_RELAXED);
+}
+
+slavery_log_level_t slavery_get_log_level() {
+	return __atomic_load_n(&slavery_log_level, __ATOMIC_RELAXED);
+}
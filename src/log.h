@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Asynchronous logger functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * @brief Records in each thread's ring. Must be a power of 2.
+ */
+#define SLAVERY_LOG_RING_SIZE 128
+
+/**
+ * @brief Longest message kept, including its NUL. Longer messages are cut short.
+ */
+#define SLAVERY_LOG_MESSAGE_SIZE 232
+
+/**
+ * @brief Milliseconds the writer sleeps between draining rings when nothing wakes it sooner.
+ */
+#define SLAVERY_LOG_FLUSH_MS 100
+
+/**
+ * @brief One log call, with only its message formatted. Everything else is turned into text by the writer.
+ *
+ * file and func are string literals, so keeping pointers to them is enough. errno_value is < 0 when the call
+ * didn't ask for errno to be logged.
+ */
+typedef struct slavery_log_record_t {
+	uint64_t time_ns;
+	const char *file;
+	const char *func;
+	int32_t line;
+	uint8_t level;
+	bool has_error;
+	uint8_t error;
+	int32_t errno_value;
+	char message[SLAVERY_LOG_MESSAGE_SIZE];
+} slavery_log_record_t;
+
+/**
+ * @brief A logging thread's records, written only by that thread and read only by the writer.
+ *
+ * Rings are kept after their thread exits until the writer has emptied them.
+ */
+typedef struct slavery_log_ring_t slavery_log_ring_t;
+
+typedef struct slavery_log_ring_t {
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) atomic_size_t tail;
+	atomic_size_t dropped;
+	atomic_bool closed;
+	char thread_name[16];
+	slavery_log_ring_t *next;
+	slavery_log_record_t records[SLAVERY_LOG_RING_SIZE];
+} slavery_log_ring_t;
+
+/**
+ * @brief The process-wide logger: every thread's ring, and the writer that empties them.
+ */
+typedef struct slavery_log_t {
+	pthread_mutex_t mutex;
+	pthread_key_t key;
+	pthread_t thread;
+	int fd;
+	bool running;
+	slavery_log_ring_t *rings;
+} slavery_log_t;
+
+void slavery_log_flush();
@@ -0,0 +1,718 @@
+/**
+ * @file
+ * @brief Mock receiver transport implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "mock.h"
+
+#include "function.h"
+#include "transport.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MOCK_CONTROL(cid, task_id, flags, function_position, group, group_remap_mask, additional_flags) \
+	{{(cid) >> 8,                                                                                     \
+	  (cid)&0xff,                                                                                     \
+	  (task_id) >> 8,                                                                                 \
+	  (task_id)&0xff,                                                                                 \
+	  flags,                                                                                          \
+	  function_position,                                                                              \
+	  group,                                                                                          \
+	  group_remap_mask,                                                                               \
+	  additional_flags}}
+
+// What an MX Master 3 answered with, written out here rather than taken from its profile, so enumerating
+// from the profile is checked against a device the profile wasn't built from.
+static const slavery_feature_t slavery_mock_mx_master_3_features[] = {
+    {.id = SLAVERY_FEATURE_ID_ROOT, .index = 0x00, .version = 0x02, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_FEATURE_SET, .index = 0x01, .version = 0x02, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_FIRMWARE, .index = 0x02, .version = 0x03, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_NAME_TYPE, .index = 0x03, .version = 0x04, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_WIRELESS_STATUS, .index = 0x04, .version = 0x00, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_RESET, .index = 0x05, .version = 0x00, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_CRYPTO, .index = 0x06, .version = 0x01, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_BATTERY, .index = 0x07, .version = 0x02, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_HOST, .index = 0x08, .version = 0x01, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_CONTROLS_V4, .index = 0x09, .version = 0x04, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_ADJUSTABLE_DPI, .index = 0x0a, .version = 0x02, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_SMART_SHIFT, .index = 0x0b, .version = 0x00, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_HIRES_WHEEL, .index = 0x0c, .version = 0x01, .flags = 0x00},
+    {.id = SLAVERY_FEATURE_ID_THUMB_WHEEL, .index = 0x0d, .version = 0x00, .flags = 0x00},
+    {.id = 0x00c2, .index = 0x0e, .version = 0x00, .flags = 0x00},
+    {.id = 0x1802, .index = 0x0f, .version = 0x00, .flags = 0x60},
+    {.id = 0x1803, .index = 0x10, .version = 0x00, .flags = 0x60},
+    {.id = 0x1806, .index = 0x11, .version = 0x04, .flags = 0x60},
+    {.id = 0x1812, .index = 0x12, .version = 0x00, .flags = 0x60},
+    {.id = 0x1805, .index = 0x13, .version = 0x00, .flags = 0x60},
+    {.id = 0x1830, .index = 0x14, .version = 0x00, .flags = 0x60},
+    {.id = 0x1890, .index = 0x15, .version = 0x06, .flags = 0x60},
+    {.id = 0x1891, .index = 0x16, .version = 0x06, .flags = 0x60},
+    {.id = 0x18a1, .index = 0x17, .version = 0x00, .flags = 0x60},
+    {.id = 0x1e00, .index = 0x18, .version = 0x00, .flags = 0x40},
+    {.id = 0x1eb0, .index = 0x19, .version = 0x00, .flags = 0x60},
+    {.id = 0x1861, .index = 0x1a, .version = 0x00, .flags = 0x60},
+    {.id = 0x1e22, .index = 0x1b, .version = 0x00, .flags = 0x60},
+};
+
+static const slavery_profile_button_t slavery_mock_mx_master_3_controls[] = {
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_LEFT, 0x0038, 0x01, 0x00, 0x01, 0x00, 0x00),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_RIGHT, 0x0039, 0x01, 0x00, 0x01, 0x00, 0x00),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_MIDDLE, 0x003a, 0x71, 0x00, 0x02, 0x0e, 0x01),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_BACK, 0x003c, 0x71, 0x00, 0x02, 0x0e, 0x01),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_FORWARD, 0x003e, 0x71, 0x00, 0x02, 0x0e, 0x01),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_THUMB, 0x00a9, 0x71, 0x00, 0x02, 0x0e, 0x01),
+    MOCK_CONTROL(SLAVERY_CID_MOUSE_TOP, 0x00aa, 0x71, 0x00, 0x02, 0x0e, 0x01),
+    MOCK_CONTROL(0x00d7, 0x00b4, 0xa0, 0x00, 0x00, 0x00, 0x01),
+};
+
+#undef MOCK_CONTROL
+
+// The firmware payload is type, 3 character prefix, number, revision and a 16 bit build.
+const slavery_mock_device_t slavery_mock_mx_master_3 = {
+    .name = "Wireless Mouse MX Master 3",
+    .type = SLAVERY_DEVICE_TYPE_MOUSE,
+    .protocol_major = 4,
+    .protocol_minor = 5,
+    .firmware = {0x00, 'R', 'B', 'M', 0x14, 0x00, 0x00, 0x09},
+    .num_features = sizeof(slavery_mock_mx_master_3_features) / sizeof(slavery_feature_t),
+    .features = slavery_mock_mx_master_3_features,
+    .num_controls = sizeof(slavery_mock_mx_master_3_controls) / sizeof(slavery_profile_button_t),
+    .controls = slavery_mock_mx_master_3_controls,
+};
+
+static const slavery_feature_t *slavery_mock_find_index(const slavery_mock_device_t *device,
+                                                        const uint8_t index) {
+	for (size_t i = 0; i < device->num_features; i++) {
+		if (device->features[i].index == index) {
+			return &device->features[i];
+		}
+	}
+
+	return NULL;
+}
+
+static const slavery_feature_t *slavery_mock_find_id(const slavery_mock_device_t *device, const uint16_t id) {
+	for (size_t i = 0; i < device->num_features; i++) {
+		if (device->features[i].id == id) {
+			return &device->features[i];
+		}
+	}
+
+	return NULL;
+}
+
+static ssize_t slavery_mock_find_control(const slavery_mock_device_t *device, const slavery_cid_t cid) {
+	for (size_t i = 0; i < device->num_controls && i < SLAVERY_MOCK_MAX_CONTROLS; i++) {
+		if (((slavery_cid_t)device->controls[i].info[0] << 8 | device->controls[i].info[1]) == cid) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static const slavery_mock_device_t *slavery_mock_get_attached(slavery_mock_t *mock,
+                                                              const size_t receiver_index,
+                                                              const uint8_t device_index) {
+	if (receiver_index >= mock->num_receivers || device_index > SLAVERY_DEVICE_INDEX_6) {
+		return NULL;
+	}
+
+	return atomic_load(&mock->receivers[receiver_index].slots[device_index].device);
+}
+
+static uint8_t slavery_mock_answer_root(const slavery_mock_device_t *device,
+                                        const uint8_t request[],
+                                        uint8_t response[]) {
+	const slavery_feature_t *feature;
+
+	switch (request[3] >> 4) {
+		case SLAVERY_FUNCTION_ROOT_GET_FEATURE_INDEX:
+			// A feature the device doesn't have is at index 0, rather than an error.
+			if ((feature = slavery_mock_find_id(device, (uint16_t)request[4] << 8 | request[5])) != NULL) {
+				response[4] = feature->index;
+				response[5] = feature->flags;
+				response[6] = feature->version;
+			}
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_ROOT_GET_PROTOCOL_VERSION:
+			response[4] = device->protocol_major;
+			response[5] = device->protocol_minor;
+			response[6] = request[6];
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+	}
+
+	return SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+}
+
+static uint8_t slavery_mock_answer_feature_set(const slavery_mock_device_t *device,
+                                               const uint8_t request[],
+                                               uint8_t response[]) {
+	const slavery_feature_t *feature;
+
+	switch (request[3] >> 4) {
+		case SLAVERY_FUNCTION_FEATURE_SET_GET_COUNT:
+			// Indexes run from 1 to the count, with any the model leaves out reported as feature 0.
+			for (size_t i = 0; i < device->num_features; i++) {
+				if (device->features[i].index > response[4]) {
+					response[4] = device->features[i].index;
+				}
+			}
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_FEATURE_SET_GET_FEATURE_ID:
+			if ((feature = slavery_mock_find_index(device, request[4])) != NULL) {
+				response[4] = feature->id >> 8;
+				response[5] = feature->id & 0xff;
+				response[6] = feature->flags;
+				response[7] = feature->version;
+			}
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+	}
+
+	return SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+}
+
+static uint8_t slavery_mock_answer_firmware(const slavery_mock_device_t *device,
+                                            const uint8_t request[],
+                                            uint8_t response[]) {
+	switch (request[3] >> 4) {
+		case SLAVERY_FUNCTION_FIRMWARE_GET_ENTITIES:
+			response[4] = 1;
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_FIRMWARE_GET_VERSION:
+			if (request[4] != 0) {
+				return SLAVERY_HIDPP_ERROR_INVALID_VALUE;
+			}
+
+			memcpy(response + 4, device->firmware, SLAVERY_DEVICE_FIRMWARE_SIZE);
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+	}
+
+	return SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+}
+
+static uint8_t slavery_mock_answer_name_type(const slavery_mock_device_t *device,
+                                             const uint8_t request[],
+                                             uint8_t response[]) {
+	size_t length = strlen(device->name);
+
+	switch (request[3] >> 4) {
+		case SLAVERY_FUNCTION_NAME_TYPE_GET_NAME_LENGTH:
+			response[4] = length;
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_NAME_TYPE_GET_NAME:
+			if (request[4] > length) {
+				return SLAVERY_HIDPP_ERROR_INVALID_VALUE;
+			}
+
+			// Each chunk fills the rest of a long report.
+			memcpy(response + 4,
+			       device->name + request[4],
+			       length - request[4] < SLAVERY_PACKET_LENGTH_CONTROL_LONG - 4
+			           ? length - request[4]
+			           : SLAVERY_PACKET_LENGTH_CONTROL_LONG - 4);
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_NAME_TYPE_GET_TYPE:
+			response[4] = device->type;
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+	}
+
+	return SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+}
+
+static uint8_t slavery_mock_answer_controls_v4(const slavery_mock_device_t *device,
+                                               slavery_mock_slot_t *slot,
+                                               const uint8_t request[],
+                                               uint8_t response[]) {
+	slavery_cid_t cid = (slavery_cid_t)request[4] << 8 | request[5];
+	ssize_t control;
+
+	switch (request[3] >> 4) {
+		case SLAVERY_FUNCTION_CONTROLS_V4_GET_COUNT:
+			response[4] = device->num_controls;
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_CONTROLS_V4_GET_BUTTON_INFO:
+			if (request[4] >= device->num_controls) {
+				return SLAVERY_HIDPP_ERROR_INVALID_VALUE;
+			}
+
+			memcpy(response + 4, device->controls[request[4]].info, sizeof(slavery_profile_button_t));
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+
+		case SLAVERY_FUNCTION_CONTROLS_V4_GET_CID_REPORT_INFO:
+		case SLAVERY_FUNCTION_CONTROLS_V4_SET_CID_REPORT_INFO:
+			if ((control = slavery_mock_find_control(device, cid)) < 0) {
+				return SLAVERY_HIDPP_ERROR_INVALID_VALUE;
+			}
+
+			// Each setting only changes along with its valid bit, which sits just above it.
+			if (request[3] >> 4 == SLAVERY_FUNCTION_CONTROLS_V4_SET_CID_REPORT_INFO) {
+				uint8_t reporting = atomic_load(&slot->reporting[control]);
+
+				for (uint8_t flag = SLAVERY_CONTROLS_V4_REPORT_DIVERT;
+				     flag <= SLAVERY_CONTROLS_V4_REPORT_RAW_XY;
+				     flag <<= 2) {
+					if (request[6] & flag << 1) {
+						reporting = (reporting & ~flag) | (request[6] & flag);
+					}
+				}
+
+				atomic_store(&slot->reporting[control], reporting);
+			}
+
+			response[4] = request[4];
+			response[5] = request[5];
+			response[6] = atomic_load(&slot->reporting[control]);
+
+			return SLAVERY_HIDPP_ERROR_SUCCESS;
+	}
+
+	return SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+}
+
+static void slavery_mock_answer(slavery_mock_t *mock,
+                                slavery_mock_receiver_t *receiver,
+                                const uint8_t request[],
+                                const size_t size) {
+	const slavery_mock_device_t *device = NULL;
+	slavery_mock_slot_t *slot = NULL;
+	const slavery_feature_t *feature = NULL;
+	uint8_t response[SLAVERY_PACKET_LENGTH_CONTROL_LONG] = {
+	    SLAVERY_REPORT_ID_CONTROL_LONG, request[1], request[2], request[3]};
+	uint8_t error = SLAVERY_HIDPP_ERROR_INVALID_FEATURE;
+
+	if (size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT || (request[0] != SLAVERY_REPORT_ID_CONTROL_SHORT &&
+	                                                   request[0] != SLAVERY_REPORT_ID_CONTROL_LONG)) {
+		log_debug("mock ignoring report of size %zu", size);
+
+		return;
+	}
+
+	atomic_fetch_add_explicit(&mock->requests, 1, memory_order_relaxed);
+
+	if (request[1] >= SLAVERY_DEVICE_INDEX_1 && request[1] <= SLAVERY_DEVICE_INDEX_6) {
+		slot = &receiver->slots[request[1]];
+		device = atomic_load_explicit(&slot->device, memory_order_acquire);
+	}
+
+	// The receiver answers for an empty slot itself, with a HID++ 1.0 error.
+	if (device == NULL) {
+		uint8_t error_response[SLAVERY_PACKET_LENGTH_CONTROL_SHORT] = {SLAVERY_REPORT_ID_CONTROL_SHORT,
+		                                                               request[1],
+		                                                               SLAVERY_FEATURE_INDEX_ERROR,
+		                                                               request[2],
+		                                                               request[3],
+		                                                               SLAVERY_HIDPP_ERROR_UNKNOWN_DEVICE,
+		                                                               0x00};
+
+		send(receiver->fd, error_response, sizeof(error_response), MSG_NOSIGNAL);
+
+		return;
+	}
+
+	if (request[2] == SLAVERY_FEATURE_INDEX_ROOT) {
+		error = slavery_mock_answer_root(device, request, response);
+	} else if ((feature = slavery_mock_find_index(device, request[2])) != NULL) {
+		switch (feature->id) {
+			case SLAVERY_FEATURE_ID_FEATURE_SET:
+				error = slavery_mock_answer_feature_set(device, request, response);
+
+				break;
+
+			case SLAVERY_FEATURE_ID_FIRMWARE:
+				error = slavery_mock_answer_firmware(device, request, response);
+
+				break;
+
+			case SLAVERY_FEATURE_ID_NAME_TYPE:
+				error = slavery_mock_answer_name_type(device, request, response);
+
+				break;
+
+			case SLAVERY_FEATURE_ID_CONTROLS_V4:
+				error = slavery_mock_answer_controls_v4(device, slot, request, response);
+
+				break;
+
+			default:
+				error = SLAVERY_HIDPP_ERROR_INVALID_FUNCTION;
+		}
+	}
+
+	if (error != SLAVERY_HIDPP_ERROR_SUCCESS) {
+		memset(response + 2, 0, sizeof(response) - 2);
+		response[2] = SLAVERY_FEATURE_INDEX_ERROR_HIDPP20;
+		response[3] = request[2];
+		response[4] = request[3];
+		response[5] = error;
+	}
+
+	send(receiver->fd, response, sizeof(response), MSG_NOSIGNAL);
+}
+
+static void *slavery_mock_run(slavery_mock_t *mock) {
+	struct pollfd fds[SLAVERY_MOCK_MAX_RECEIVERS + 1] = {{.fd = mock->stop_fd, .events = POLLIN}};
+	uint8_t request[SLAVERY_PACKET_LENGTH_MAX];
+
+	if ((errno = pthread_setname_np(pthread_self(), "mock")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	for (size_t i = 0; i < mock->num_receivers; i++) {
+		fds[i + 1] = (struct pollfd){.fd = mock->receivers[i].fd, .events = POLLIN};
+	}
+
+	while (true) {
+		if (poll(fds, mock->num_receivers + 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "poll()");
+
+			return NULL;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			return NULL;
+		}
+
+		for (size_t i = 0; i < mock->num_receivers; i++) {
+			if (fds[i + 1].revents == 0) {
+				continue;
+			}
+
+			ssize_t size = recv(fds[i + 1].fd, request, sizeof(request), MSG_DONTWAIT);
+
+			// A receiver closed by the library is left alone from then on.
+			if (size > 0) {
+				slavery_mock_answer(mock, &mock->receivers[i], request, size);
+			} else if (size == 0 || (errno != EAGAIN && errno != EINTR)) {
+				fds[i + 1].fd = -1;
+			}
+		}
+	}
+}
+
+static ssize_t slavery_mock_discover(const slavery_transport_t *transport,
+                                     const slavery_options_t *options,
+                                     char ***paths) {
+	slavery_mock_t *mock = transport->data;
+
+	UNUSED(options);
+
+	*paths = malloc(sizeof(char *) * mock->num_receivers);
+
+	for (size_t i = 0; i < mock->num_receivers; i++) {
+		asprintf(&(*paths)[i], "mock:%zu", i);
+	}
+
+	return mock->num_receivers;
+}
+
+static int slavery_mock_open(const slavery_transport_t *transport, const char *path) {
+	slavery_mock_t *mock = transport->data;
+	size_t receiver_index;
+
+	if (sscanf(path, "mock:%zu", &receiver_index) != 1 || receiver_index >= mock->num_receivers) {
+		errno = ENOENT;
+
+		return -1;
+	}
+
+	if (atomic_exchange(&mock->receivers[receiver_index].opened, true)) {
+		errno = EBUSY;
+
+		return -1;
+	}
+
+	return mock->receivers[receiver_index].receiver_fd;
+}
+
+static int slavery_mock_info(const slavery_transport_t *transport,
+                             const int fd,
+                             slavery_transport_info_t *info) {
+	slavery_mock_t *mock = transport->data;
+
+	for (size_t i = 0; i < mock->num_receivers; i++) {
+		if (mock->receivers[i].receiver_fd == fd) {
+			info->vendor_id = SLAVERY_USB_VENDOR_ID_LOGITECH;
+			info->product_id = SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER;
+			info->minor = i;
+
+			snprintf(info->name, sizeof(info->name), "Mock Unifying Receiver");
+			snprintf(info->address, sizeof(info->address), "mock:%zu", i);
+
+			return 0;
+		}
+	}
+
+	errno = EBADF;
+
+	return -1;
+}
+
+slavery_mock_t *slavery_mock_new(const size_t num_receivers) {
+	if (num_receivers > SLAVERY_MOCK_MAX_RECEIVERS) {
+		log_warning(SLAVERY_ERROR_OS, "a mock can't have more than %u receivers", SLAVERY_MOCK_MAX_RECEIVERS);
+
+		errno = EINVAL;
+
+		return NULL;
+	}
+
+	slavery_mock_t *mock = calloc(1, sizeof(slavery_mock_t));
+
+	mock->stop_fd = -1;
+	mock->transport = slavery_transport_socket;
+	mock->transport.name = "mock";
+	mock->transport.data = mock;
+	mock->transport.discover = slavery_mock_discover;
+	mock->transport.open = slavery_mock_open;
+	mock->transport.info = slavery_mock_info;
+	mock->num_receivers = num_receivers;
+	atomic_init(&mock->requests, 0);
+
+	for (size_t i = 0; i < num_receivers; i++) {
+		slavery_mock_receiver_t *receiver = &mock->receivers[i];
+		int fds[2];
+
+		// Packets keep report boundaries, as hidraw does. Only the library's end is non-blocking, so the
+		// mock waits rather than drops reports when the library falls behind.
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "socketpair() failed");
+
+			mock->num_receivers = i;
+			slavery_mock_free(mock);
+
+			return NULL;
+		}
+
+		if (fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "fcntl() failed");
+
+			close(fds[0]);
+			close(fds[1]);
+			mock->num_receivers = i;
+			slavery_mock_free(mock);
+
+			return NULL;
+		}
+
+		receiver->fd = fds[0];
+		receiver->receiver_fd = fds[1];
+		atomic_init(&receiver->opened, false);
+
+		for (uint8_t device_index = 0; device_index <= SLAVERY_DEVICE_INDEX_6; device_index++) {
+			atomic_init(&receiver->slots[device_index].device, NULL);
+		}
+	}
+
+	if ((mock->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		slavery_mock_free(mock);
+
+		return NULL;
+	}
+
+	if ((errno = pthread_create(&mock->thread, NULL, (pthread_callback_t)slavery_mock_run, mock)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		close(mock->stop_fd);
+		mock->stop_fd = -1;
+		slavery_mock_free(mock);
+
+		return NULL;
+	}
+
+	return mock;
+}
+
+void slavery_mock_free(slavery_mock_t *mock) {
+	// Receivers the library still has open see their mock end hang up.
+	if (mock->stop_fd >= 0) {
+		if (eventfd_write(mock->stop_fd, 1) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write()");
+		}
+
+		pthread_join(mock->thread, NULL);
+		close(mock->stop_fd);
+	}
+
+	for (size_t i = 0; i < mock->num_receivers; i++) {
+		close(mock->receivers[i].fd);
+
+		if (!atomic_load(&mock->receivers[i].opened)) {
+			close(mock->receivers[i].receiver_fd);
+		}
+	}
+
+	free(mock);
+}
+
+int slavery_mock_attach(slavery_mock_t *mock,
+                        const size_t receiver_index,
+                        const uint8_t device_index,
+                        const slavery_mock_device_t *device) {
+	if (receiver_index >= mock->num_receivers || device_index < SLAVERY_DEVICE_INDEX_1 ||
+	    device_index > SLAVERY_DEVICE_INDEX_6 || device->num_controls > SLAVERY_MOCK_MAX_CONTROLS) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	slavery_mock_slot_t *slot = &mock->receivers[receiver_index].slots[device_index];
+
+	for (size_t i = 0; i < SLAVERY_MOCK_MAX_CONTROLS; i++) {
+		atomic_store(&slot->reporting[i], 0);
+	}
+	atomic_store_explicit(&slot->device, device, memory_order_release);
+
+	return 0;
+}
+
+int slavery_mock_send(slavery_mock_t *mock,
+                      const size_t receiver_index,
+                      const uint8_t data[],
+                      const size_t size) {
+	if (receiver_index >= mock->num_receivers) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	return send(mock->receivers[receiver_index].fd, data, size, MSG_NOSIGNAL) == (ssize_t)size ? 0 : -1;
+}
+
+int slavery_mock_press(slavery_mock_t *mock,
+                       const size_t receiver_index,
+                       const uint8_t device_index,
+                       const uint16_t buttons) {
+	// Button bits are little endian, after the mouse report type.
+	uint8_t data[SLAVERY_PACKET_LENGTH_EVENT] = {
+	    SLAVERY_REPORT_ID_EVENT, device_index, SLAVERY_EVENT_TYPE_MOUSE, buttons & 0xff, buttons >> 8};
+
+	return slavery_mock_send(mock, receiver_index, data, sizeof(data));
+}
+
+int slavery_mock_press_diverted(slavery_mock_t *mock,
+                                const size_t receiver_index,
+                                const uint8_t device_index,
+                                const slavery_cid_t cids[],
+                                const size_t num_cids) {
+	uint8_t data[SLAVERY_PACKET_LENGTH_CONTROL_LONG] = {SLAVERY_REPORT_ID_CONTROL_LONG, device_index};
+	const slavery_mock_device_t *device = slavery_mock_get_attached(mock, receiver_index, device_index);
+	const slavery_feature_t *feature;
+
+	if (device == NULL || (feature = slavery_mock_find_id(device, SLAVERY_FEATURE_ID_CONTROLS_V4)) == NULL ||
+	    num_cids > 4) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	// Every diverted control still held is listed, so an empty list releases them all.
+	data[2] = feature->index;
+	data[3] = SLAVERY_EVENT_CONTROLS_V4_DIVERTED_BUTTONS << 4;
+
+	for (size_t i = 0; i < num_cids; i++) {
+		data[4 + i * 2] = cids[i] >> 8;
+		data[5 + i * 2] = cids[i] & 0xff;
+	}
+
+	return slavery_mock_send(mock, receiver_index, data, sizeof(data));
+}
+
+int slavery_mock_move_diverted(slavery_mock_t *mock,
+                               const size_t receiver_index,
+                               const uint8_t device_index,
+                               const int16_t dx,
+                               const int16_t dy) {
+	uint8_t data[SLAVERY_PACKET_LENGTH_CONTROL_LONG] = {SLAVERY_REPORT_ID_CONTROL_LONG, device_index};
+	const slavery_mock_device_t *device = slavery_mock_get_attached(mock, receiver_index, device_index);
+	const slavery_feature_t *feature;
+
+	if (device == NULL || (feature = slavery_mock_find_id(device, SLAVERY_FEATURE_ID_CONTROLS_V4)) == NULL) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	// Deltas are big endian, and only sent while a control diverted with raw XY is held.
+	data[2] = feature->index;
+	data[3] = SLAVERY_EVENT_CONTROLS_V4_DIVERTED_RAW_XY << 4;
+	data[4] = (uint16_t)dx >> 8;
+	data[5] = (uint16_t)dx & 0xff;
+	data[6] = (uint16_t)dy >> 8;
+	data[7] = (uint16_t)dy & 0xff;
+
+	return slavery_mock_send(mock, receiver_index, data, sizeof(data));
+}
+
+int slavery_mock_reconnect(slavery_mock_t *mock, const size_t receiver_index, const uint8_t device_index) {
+	uint8_t data[SLAVERY_PACKET_LENGTH_CONTROL_SHORT] = {
+	    SLAVERY_REPORT_ID_CONTROL_SHORT, device_index, SLAVERY_RECEIVER_DEVICE_CONNECTION};
+
+	if (slavery_mock_get_attached(mock, receiver_index, device_index) == NULL) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	// A device that lost its link comes back with every control reporting as it does by default.
+	for (size_t i = 0; i < SLAVERY_MOCK_MAX_CONTROLS; i++) {
+		atomic_store(&mock->receivers[receiver_index].slots[device_index].reporting[i], 0);
+	}
+
+	return slavery_mock_send(mock, receiver_index, data, sizeof(data));
+}
+
+int slavery_mock_get_reporting(slavery_mock_t *mock,
+                               const size_t receiver_index,
+                               const uint8_t device_index,
+                               const slavery_cid_t cid) {
+	const slavery_mock_device_t *device = slavery_mock_get_attached(mock, receiver_index, device_index);
+	ssize_t control;
+
+	if (device == NULL || (control = slavery_mock_find_control(device, cid)) < 0) {
+		errno = EINVAL;
+
+		return -1;
+	}
+
+	return atomic_load(&mock->receivers[receiver_index].slots[device_index].reporting[control]);
+}
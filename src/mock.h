@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief Mock receiver transport functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "button.h"
+#include "device.h"
+#include "feature.h"
+#include "libslavery.h"
+#include "profile.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Receivers a mock can stand in for.
+ */
+#define SLAVERY_MOCK_MAX_RECEIVERS 8
+
+/**
+ * @brief Controls a mock device can have.
+ */
+#define SLAVERY_MOCK_MAX_CONTROLS 32
+
+/**
+ * @brief What a mock device answers with. Features are listed with their indexes, and controls as their
+ * GET_BUTTON_INFO payloads, the same way as in a profile.
+ */
+typedef struct slavery_mock_device_t {
+	const char *name;
+	slavery_device_type_t type;
+	uint8_t protocol_major;
+	uint8_t protocol_minor;
+	uint8_t firmware[SLAVERY_DEVICE_FIRMWARE_SIZE];
+	size_t num_features;
+	const slavery_feature_t *features;
+	size_t num_controls;
+	const slavery_profile_button_t *controls;
+} slavery_mock_device_t;
+
+/**
+ * @brief A device index on a mock receiver, with the reporting flags its controls were last given.
+ */
+typedef struct slavery_mock_slot_t {
+	_Atomic(const slavery_mock_device_t *) device;
+	atomic_uchar reporting[SLAVERY_MOCK_MAX_CONTROLS];
+} slavery_mock_slot_t;
+
+/**
+ * @brief One end of a socket pair for the mock to answer on, and the other for the library to open.
+ */
+typedef struct slavery_mock_receiver_t {
+	int fd;
+	int receiver_fd;
+	atomic_bool opened;
+	slavery_mock_slot_t slots[SLAVERY_DEVICE_INDEX_6 + 1];
+} slavery_mock_receiver_t;
+
+/**
+ * @brief A transport whose receivers are socket pairs answered by a thread, from device models attached to
+ * their slots, so everything above the transport runs as it would with real receivers.
+ *
+ * HID++ 2.0 root, feature set, firmware, name/type and controls requests are answered, as is a receiver for
+ * an empty slot. Reports the devices send can be scripted with slavery_mock_send() and the functions built on
+ * it, and the reporting flags the library gave each control read back with slavery_mock_get_reporting().
+ * Receivers are found as mock:N, and can each be opened once.
+ */
+typedef struct slavery_mock_t {
+	slavery_transport_t transport;
+	size_t num_receivers;
+	slavery_mock_receiver_t receivers[SLAVERY_MOCK_MAX_RECEIVERS];
+	int stop_fd;
+	pthread_t thread;
+	atomic_size_t requests;
+} slavery_mock_t;
+
+/**
+ * @brief An MX Master 3, modelled on its own rather than from the built-in profile.
+ */
+extern const slavery_mock_device_t slavery_mock_mx_master_3;
+
+slavery_mock_t *slavery_mock_new(const size_t num_receivers);
+void slavery_mock_free(slavery_mock_t *mock);
+int slavery_mock_attach(slavery_mock_t *mock,
+                        const size_t receiver_index,
+                        const uint8_t device_index,
+                        const slavery_mock_device_t *device);
+int slavery_mock_send(slavery_mock_t *mock,
+                      const size_t receiver_index,
+                      const uint8_t data[],
+                      const size_t size);
+int slavery_mock_press(slavery_mock_t *mock,
+                       const size_t receiver_index,
+                       const uint8_t device_index,
+                       const uint16_t buttons);
+int slavery_mock_press_diverted(slavery_mock_t *mock,
+                                const size_t receiver_index,
+                                const uint8_t device_index,
+                                const slavery_cid_t cids[],
+                                const size_t num_cids);
+int slavery_mock_move_diverted(slavery_mock_t *mock,
+                               const size_t receiver_index,
+                               const uint8_t device_index,
+                               const int16_t dx,
+                               const int16_t dy);
+int slavery_mock_reconnect(slavery_mock_t *mock, const size_t receiver_index, const uint8_t device_index);
+int slavery_mock_get_reporting(slavery_mock_t *mock,
+                               const size_t receiver_index,
+                               const uint8_t device_index,
+                               const slavery_cid_t cid);
@@ -8,23 +8,51 @@
  * @license $(PROJECT_LICENSE)
  */
 
+#define _GNU_SOURCE
+
 #include "monitor.h"
 
+#include "discovery.h"
 #include "libslavery_p.h"
 #include "receiver.h"
 #include "utils.h"
 
 #include <errno.h>
-#include <fcntl.h>
 #include <libudev.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static void slavery_monitor_stop_hotplug(slavery_monitor_t *monitor) {
+	pthread_mutex_lock(&monitor->hotplug_mutex);
+	monitor->stopping = true;
+	pthread_cond_signal(&monitor->hotplug_cond);
+	pthread_mutex_unlock(&monitor->hotplug_mutex);
+
+	if ((errno = pthread_join(monitor->hotplug_thread, NULL)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+	}
+
+	// Changes that arrived too late to be made are dropped along with the monitor.
+	while (monitor->changes != NULL) {
+		slavery_monitor_change_t *change = monitor->changes;
+
+		monitor->changes = change->next;
+
+		free(change->devnode);
+		free(change);
+	}
+
+	pthread_cond_destroy(&monitor->hotplug_cond);
+	pthread_mutex_destroy(&monitor->hotplug_mutex);
+}
 
 slavery_monitor_t *slavery_monitor_new(slavery_t *slavery) {
 	slavery_monitor_t *monitor = malloc(sizeof(slavery_monitor_t));
 	struct udev *udev;
-	int fd;
 
 	monitor->slavery = slavery;
 
@@ -65,10 +93,8 @@ slavery_monitor_t *slavery_monitor_new(slavery_t *slavery) {
 		return NULL;
 	}
 
-	fd = udev_monitor_get_fd(monitor->udev_monitor);
-
-	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) == -1) {
-		log_warning_errno(SLAVERY_ERROR_IO, "fcntl() failed");
+	if ((monitor->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
 
 		udev_monitor_unref(monitor->udev_monitor);
 		udev_unref(udev);
@@ -77,10 +103,56 @@ slavery_monitor_t *slavery_monitor_new(slavery_t *slavery) {
 		return NULL;
 	}
 
+	monitor->udev = udev;
+
+	// The udev monitor socket is non-blocking, so it is drained on each wakeup.
+	if (slavery->reactor != NULL) {
+		monitor->handler.fd = udev_monitor_get_fd(monitor->udev_monitor);
+		monitor->handler.callback = slavery_monitor_on_readable;
+		monitor->handler.data = monitor;
+		monitor->changes = NULL;
+		monitor->changes_tail = &monitor->changes;
+		monitor->stopping = false;
+
+		pthread_mutex_init(&monitor->hotplug_mutex, NULL);
+		pthread_cond_init(&monitor->hotplug_cond, NULL);
+
+		if ((errno = pthread_create(&monitor->hotplug_thread,
+		                            NULL,
+		                            (pthread_callback_t)slavery_monitor_hotplug_run,
+		                            monitor)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+			pthread_cond_destroy(&monitor->hotplug_cond);
+			pthread_mutex_destroy(&monitor->hotplug_mutex);
+			close(monitor->stop_fd);
+			udev_monitor_unref(monitor->udev_monitor);
+			udev_unref(udev);
+			free(monitor);
+
+			return NULL;
+		}
+
+		if (slavery_reactor_add(slavery->reactor, &monitor->handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to add monitor to reactor");
+
+			slavery_monitor_stop_hotplug(monitor);
+			close(monitor->stop_fd);
+			udev_monitor_unref(monitor->udev_monitor);
+			udev_unref(udev);
+			free(monitor);
+
+			return NULL;
+		}
+
+		return monitor;
+	}
+
 	if ((errno = pthread_create(
 	         &monitor->monitor_thread, NULL, (pthread_callback_t)slavery_monitor_run, monitor)) != 0) {
 		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
 
+		close(monitor->stop_fd);
 		udev_monitor_unref(monitor->udev_monitor);
 		udev_unref(udev);
 		free(monitor);
@@ -93,68 +165,182 @@ slavery_monitor_t *slavery_monitor_new(slavery_t *slavery) {
 
 int slavery_monitor_free(slavery_monitor_t *monitor) {
 	log_debug("freeing monitor at %p", monitor);
-	log_debug("stopping monitor thread");
 
-	if ((errno = pthread_cancel(monitor->monitor_thread)) != 0) {
-		if (errno == ESRCH) {
-			log_debug("monitor thread has already finished");
-		} else {
-			log_warning_errno(SLAVERY_ERROR_OS, "pthread_cancel()");
+	if (monitor->slavery->reactor != NULL) {
+		log_debug("removing monitor from reactor");
+
+		if (slavery_reactor_remove(monitor->slavery->reactor, &monitor->handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to remove monitor from reactor");
 
 			return -1;
 		}
-	}
 
-	if ((errno = pthread_join(monitor->monitor_thread, NULL)) != 0) {
-		log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+		// A receiver still being added is scanned to the end and freed along with the others.
+		log_debug("stopping hotplug thread");
+
+		slavery_monitor_stop_hotplug(monitor);
+	} else {
+		log_debug("stopping monitor thread");
 
-		return -1;
+		if (eventfd_write(monitor->stop_fd, 1) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write()");
+
+			return -1;
+		}
+
+		if ((errno = pthread_join(monitor->monitor_thread, NULL)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+
+			return -1;
+		}
 	}
 
+	close(monitor->stop_fd);
+	udev_monitor_unref(monitor->udev_monitor);
+	udev_unref(monitor->udev);
+	free(monitor);
+
 	return 0;
 }
 
+static void slavery_monitor_add_receiver(slavery_monitor_t *monitor, const char *devnode) {
+	slavery_receiver_t *receiver = slavery_receiver_from_devnode(monitor->slavery, devnode);
+
+	if (receiver == NULL) {
+		log_debug("failed to create receiver from devnode %s, ignoring devnode", devnode);
+	} else {
+		if (slavery_receiver_scan_devices(receiver) < 0) {
+			log_debug("failed to scan devices on receiver %s", devnode);
+		} else {
+			slavery_add_receiver(monitor->slavery, receiver);
+		}
+	}
+}
+
+static void slavery_monitor_remove_receiver(slavery_monitor_t *monitor, const char *devnode) {
+	slavery_receiver_t *receiver = slavery_remove_receiver(monitor->slavery, devnode);
+
+	if (receiver != NULL) {
+		slavery_receiver_free(receiver);
+	}
+}
+
+void *slavery_monitor_hotplug_run(slavery_monitor_t *monitor) {
+	if ((errno = pthread_setname_np(pthread_self(), "hotplug")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	pthread_mutex_lock(&monitor->hotplug_mutex);
+
+	while (!monitor->stopping) {
+		slavery_monitor_change_t *change = monitor->changes;
+
+		if (change == NULL) {
+			pthread_cond_wait(&monitor->hotplug_cond, &monitor->hotplug_mutex);
+
+			continue;
+		}
+
+		if ((monitor->changes = change->next) == NULL) {
+			monitor->changes_tail = &monitor->changes;
+		}
+
+		pthread_mutex_unlock(&monitor->hotplug_mutex);
+
+		if (change->add) {
+			slavery_monitor_add_receiver(monitor, change->devnode);
+		} else {
+			slavery_monitor_remove_receiver(monitor, change->devnode);
+		}
+
+		free(change->devnode);
+		free(change);
+
+		pthread_mutex_lock(&monitor->hotplug_mutex);
+	}
+
+	pthread_mutex_unlock(&monitor->hotplug_mutex);
+
+	log_debug("stopped");
+
+	return NULL;
+}
+
+void slavery_monitor_handle_device(slavery_monitor_t *monitor, struct udev_device *device) {
+	const char *devnode = udev_device_get_devnode(device);
+	const char *action = udev_device_get_action(device);
+	bool add = strcmp(action, "add") == 0;
+
+	if (add && !slavery_discovery_match_udev_device(device)) {
+		log_debug("ignoring %s, not a receiver", devnode);
+
+		return;
+	}
+
+	if (monitor->slavery->reactor != NULL && (add || strcmp(action, "remove") == 0)) {
+		// Scanning waits on responses delivered by the reactor, so it can't run on the reactor thread.
+		// Removals are queued behind it, so a receiver is never removed before it has been added.
+		slavery_monitor_change_t *change = malloc(sizeof(slavery_monitor_change_t));
+
+		change->devnode = strdup(devnode);
+		change->add = add;
+		change->next = NULL;
+
+		pthread_mutex_lock(&monitor->hotplug_mutex);
+		*monitor->changes_tail = change;
+		monitor->changes_tail = &change->next;
+		pthread_cond_signal(&monitor->hotplug_cond);
+		pthread_mutex_unlock(&monitor->hotplug_mutex);
+	} else if (add) {
+		slavery_monitor_add_receiver(monitor, devnode);
+	} else if (strcmp(action, "remove") == 0) {
+		slavery_monitor_remove_receiver(monitor, devnode);
+	}
+
+	printf("device change %s %s\n", devnode, action);
+}
+
+void slavery_monitor_receive_devices(slavery_monitor_t *monitor) {
+	struct udev_device *device;
+
+	while ((device = udev_monitor_receive_device(monitor->udev_monitor)) != NULL) {
+		slavery_monitor_handle_device(monitor, device);
+
+		udev_device_unref(device);
+	}
+}
+
+void slavery_monitor_on_readable(void *data, const uint32_t events) {
+	UNUSED(events);
+
+	slavery_monitor_receive_devices(data);
+}
+
 void *slavery_monitor_run(slavery_monitor_t *monitor) {
+	if ((errno = pthread_setname_np(pthread_self(), "monitor")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	struct pollfd fds[] = {{.fd = udev_monitor_get_fd(monitor->udev_monitor), .events = POLLIN},
+	                       {.fd = monitor->stop_fd, .events = POLLIN}};
+
 	while (true) {
-		struct udev_device *device = udev_monitor_receive_device(monitor->udev_monitor);
-		const char *devnode = udev_device_get_devnode(device);
-		const char *action = udev_device_get_action(device);
-
-		if (strcmp(action, "add") == 0) {
-			slavery_receiver_t *receiver = slavery_receiver_from_devnode(devnode);
-
-			if (receiver == NULL) {
-				log_debug("failed to create receiver from devnode %s, ignoring devnode", devnode);
-			} else {
-				if (slavery_receiver_scan_devices(receiver) < 0) {
-					log_debug("failed to scan devices on receiver %s", devnode);
-				} else {
-					monitor->slavery->receivers =
-					    realloc(monitor->slavery->receivers,
-					            sizeof(slavery_receiver_t) * (monitor->slavery->num_receivers + 1));
-					monitor->slavery->receivers[monitor->slavery->num_receivers++] = receiver;
-				}
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
 			}
-		} else if (strcmp(action, "remove") == 0) {
-			for (size_t i = 0; i < monitor->slavery->num_receivers; i++) {
-				slavery_receiver_t *receiver = slavery_get_receiver(monitor->slavery, i);
 
-				if (strcmp(receiver->devnode, devnode) == 0) {
-					slavery_receiver_free(receiver);
+			log_warning_errno(SLAVERY_ERROR_OS, "poll()");
 
-					for (size_t j = i + 1; j < monitor->slavery->num_receivers; j++) {
-						monitor->slavery->receivers[j - 1] = monitor->slavery->receivers[j];
-					}
+			return NULL;
+		}
 
-					monitor->slavery->num_receivers--;
+		if (fds[1].revents & POLLIN) {
+			log_debug("stopped");
 
-					break;
-				}
-			}
+			return NULL;
 		}
 
-		printf("device change %s %s\n", devnode, action);
-
-		udev_device_unref(device);
+		slavery_monitor_receive_devices(monitor);
 	}
 }
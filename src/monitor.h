@@ -10,17 +10,51 @@
 
 #pragma once
 
+#include "reactor.h"
+
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 typedef struct slavery_t slavery_t;
+struct udev;
+struct udev_device;
 struct udev_monitor;
 
+/**
+ * @brief A receiver being added or removed, waiting for the hotplug thread.
+ */
+typedef struct slavery_monitor_change_t {
+	char *devnode;
+	bool add;
+	struct slavery_monitor_change_t *next;
+} slavery_monitor_change_t;
+
+/**
+ * @brief Watches udev for receivers being plugged in and removed.
+ *
+ * With a reactor, changes are handed to a hotplug thread in the order they arrive, since scanning a new
+ * receiver waits on responses the reactor delivers.
+ */
 typedef struct slavery_monitor_t {
 	slavery_t *slavery;
+	struct udev *udev;
 	struct udev_monitor *udev_monitor;
 	pthread_t monitor_thread;
+	int stop_fd;
+	slavery_reactor_handler_t handler;
+	pthread_t hotplug_thread;
+	pthread_mutex_t hotplug_mutex;
+	pthread_cond_t hotplug_cond;
+	slavery_monitor_change_t *changes;
+	slavery_monitor_change_t **changes_tail;
+	bool stopping;
 } slavery_monitor_t;
 
 slavery_monitor_t *slavery_monitor_new(slavery_t *slavery);
 int slavery_monitor_free(slavery_monitor_t *monitor);
+void slavery_monitor_handle_device(slavery_monitor_t *monitor, struct udev_device *device);
+void slavery_monitor_receive_devices(slavery_monitor_t *monitor);
+void slavery_monitor_on_readable(void *data, const uint32_t events);
 void *slavery_monitor_run(slavery_monitor_t *monitor);
+void *slavery_monitor_hotplug_run(slavery_monitor_t *monitor);
@@ -0,0 +1,282 @@
+/**
+ * @file
+ * @brief Event worker pool implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "pool.h"
+
+#include "receiver.h"
+#include "replay.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int slavery_pool_queue_init(slavery_pool_queue_t *queue, size_t queue_size) {
+	size_t capacity = 2;
+
+	while (capacity < queue_size) {
+		capacity <<= 1;
+	}
+
+	if ((queue->cells = malloc(sizeof(slavery_pool_cell_t) * capacity)) == NULL) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < capacity; i++) {
+		atomic_init(&queue->cells[i].sequence, i);
+	}
+
+	queue->mask = capacity - 1;
+	atomic_init(&queue->enqueue_pos, 0);
+	atomic_init(&queue->dequeue_pos, 0);
+	atomic_init(&queue->depth, 0);
+	atomic_init(&queue->max_depth, 0);
+	atomic_init(&queue->dropped, 0);
+	atomic_init(&queue->dispatched, 0);
+
+	if (sem_init(&queue->items, 0, 0) < 0) {
+		free(queue->cells);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+static void slavery_pool_queue_destroy(slavery_pool_queue_t *queue) {
+	sem_destroy(&queue->items);
+	free(queue->cells);
+}
+
+static bool slavery_pool_queue_push(slavery_pool_queue_t *queue, slavery_report_t *report) {
+	size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+	slavery_pool_cell_t *cell;
+
+	while (true) {
+		cell = &queue->cells[pos & queue->mask];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(
+			        &queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	cell->report = report;
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+	return true;
+}
+
+static bool slavery_pool_queue_pop(slavery_pool_queue_t *queue, slavery_report_t **report) {
+	size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+	slavery_pool_cell_t *cell;
+
+	while (true) {
+		cell = &queue->cells[pos & queue->mask];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(
+			        &queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
+	}
+
+	*report = cell->report;
+	atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+
+	return true;
+}
+
+slavery_pool_t *slavery_pool_new(const size_t num_workers, const size_t queue_size) {
+	log_debug("creating pool with %lu workers and queue size %lu", num_workers, queue_size);
+
+	slavery_pool_t *pool = malloc(sizeof(slavery_pool_t));
+	pool->num_workers = num_workers > 0 ? num_workers : 1;
+	pool->workers = calloc(pool->num_workers, sizeof(slavery_pool_worker_t));
+	atomic_init(&pool->running, true);
+
+	// Workers are the only threads reading configs, so each gets an epoch record.
+	if (slavery_epoch_init(&pool->epoch, pool->num_workers) < 0) {
+		log_warning(SLAVERY_ERROR_OS, "failed to allocate epoch records");
+
+		free(pool->workers);
+		free(pool);
+
+		return NULL;
+	}
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		slavery_pool_worker_t *worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+
+		if (slavery_pool_queue_init(&worker->queue, queue_size) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "failed to allocate worker queue");
+
+			pool->num_workers = i;
+			slavery_pool_free(pool);
+
+			return NULL;
+		}
+
+		if ((errno = pthread_create(
+		         &worker->thread, NULL, (pthread_callback_t)slavery_pool_worker_run, worker)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+			slavery_pool_queue_destroy(&worker->queue);
+
+			pool->num_workers = i;
+			slavery_pool_free(pool);
+
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+int slavery_pool_free(slavery_pool_t *pool) {
+	log_debug("freeing pool at %p", pool);
+
+	atomic_store(&pool->running, false);
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		sem_post(&pool->workers[i].queue.items);
+	}
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		if ((errno = pthread_join(pool->workers[i].thread, NULL)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+		}
+
+		slavery_pool_queue_destroy(&pool->workers[i].queue);
+	}
+
+	slavery_epoch_destroy(&pool->epoch);
+	free(pool->workers);
+	free(pool);
+
+	return 0;
+}
+
+int slavery_pool_submit(slavery_pool_t *pool, slavery_report_t *report) {
+	// Route by receiver and device index so a device's events always land on the same worker, in order.
+	size_t hash = ((uintptr_t)report->receiver >> 4) * 31 + (report->size > 1 ? report->data[1] : 0);
+	slavery_pool_queue_t *queue = &pool->workers[hash % pool->num_workers].queue;
+
+	atomic_fetch_add_explicit(&report->receiver->pending_events, 1, memory_order_relaxed);
+
+	// The queue holds its own reference, dropped by the worker once the report is dispatched.
+	if (!slavery_pool_queue_push(queue, slavery_report_ref(report))) {
+		slavery_report_unref(report);
+		atomic_fetch_sub_explicit(&report->receiver->pending_events, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+
+		log_debug("worker queue full, dropping event");
+
+		return -1;
+	}
+
+	size_t depth = atomic_fetch_add_explicit(&queue->depth, 1, memory_order_relaxed) + 1;
+	size_t max_depth = atomic_load_explicit(&queue->max_depth, memory_order_relaxed);
+
+	while (depth > max_depth &&
+	       !atomic_compare_exchange_weak_explicit(
+	           &queue->max_depth, &max_depth, depth, memory_order_relaxed, memory_order_relaxed)) {
+		continue;
+	}
+
+	sem_post(&queue->items);
+
+	return 0;
+}
+
+void slavery_pool_get_stats(slavery_pool_t *pool, const size_t worker_index, slavery_pool_stats_t *stats) {
+	slavery_pool_queue_t *queue = &pool->workers[worker_index].queue;
+
+	stats->depth = atomic_load_explicit(&queue->depth, memory_order_relaxed);
+	stats->max_depth = atomic_load_explicit(&queue->max_depth, memory_order_relaxed);
+	stats->dropped = atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+	stats->dispatched = atomic_load_explicit(&queue->dispatched, memory_order_relaxed);
+}
+
+void *slavery_pool_worker_run(slavery_pool_worker_t *worker) {
+	char name[16];
+
+	snprintf(name, sizeof(name), "worker/%lu", worker->index);
+
+	if ((errno = pthread_setname_np(pthread_self(), name)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	log_debug("started");
+
+	slavery_pool_queue_t *queue = &worker->queue;
+	slavery_report_t *report;
+
+	while (true) {
+		if (sem_wait(&queue->items) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "sem_wait() failed");
+
+			break;
+		}
+
+		if (!slavery_pool_queue_pop(queue, &report)) {
+			if (!atomic_load(&worker->pool->running)) {
+				break;
+			}
+
+			continue;
+		}
+
+		atomic_fetch_sub_explicit(&queue->depth, 1, memory_order_relaxed);
+
+		slavery_receiver_t *receiver = report->receiver;
+		uint64_t dequeued_ns = receiver->replay != NULL ? time_monotonic_ns() : 0;
+
+		slavery_epoch_enter(&worker->pool->epoch, worker->index);
+		slavery_event_dispatch(report);
+		slavery_epoch_exit(&worker->pool->epoch, worker->index);
+
+		if (receiver->replay != NULL) {
+			slavery_replay_observe(receiver->replay, report, dequeued_ns);
+		}
+
+		slavery_report_unref(report);
+
+		atomic_fetch_add_explicit(&queue->dispatched, 1, memory_order_relaxed);
+		atomic_fetch_sub_explicit(&receiver->pending_events, 1, memory_order_release);
+	}
+
+	log_debug("stopped");
+
+	return NULL;
+}
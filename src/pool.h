@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Event worker pool functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "epoch.h"
+#include "event.h"
+#include "libslavery.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A single preallocated slot in a worker queue.
+ */
+typedef struct slavery_pool_cell_t {
+	atomic_size_t sequence;
+	slavery_report_t *report;
+} slavery_pool_cell_t;
+
+/**
+ * @brief Bounded lock-free multi-producer queue feeding a single worker.
+ *
+ * Producers are receiver listeners, the consumer is the worker owning the queue. All events for a given
+ * receiver/device pair are routed to the same queue, so they are dispatched in the order they were read.
+ */
+typedef struct slavery_pool_queue_t {
+	size_t mask;
+	slavery_pool_cell_t *cells;
+	_Alignas(64) atomic_size_t enqueue_pos;
+	_Alignas(64) atomic_size_t dequeue_pos;
+	sem_t items;
+	atomic_size_t depth;
+	atomic_size_t max_depth;
+	atomic_size_t dropped;
+	atomic_size_t dispatched;
+} slavery_pool_queue_t;
+
+typedef struct slavery_pool_t slavery_pool_t;
+
+/**
+ * @brief A pool worker thread and its queue.
+ */
+typedef struct slavery_pool_worker_t {
+	slavery_pool_t *pool;
+	size_t index;
+	pthread_t thread;
+	slavery_pool_queue_t queue;
+} slavery_pool_worker_t;
+
+/**
+ * @brief Fixed-size pool of event workers.
+ */
+typedef struct slavery_pool_t {
+	size_t num_workers;
+	slavery_pool_worker_t *workers;
+	atomic_bool running;
+	slavery_epoch_t epoch;
+} slavery_pool_t;
+
+slavery_pool_t *slavery_pool_new(const size_t num_workers, const size_t queue_size);
+int slavery_pool_free(slavery_pool_t *pool);
+int slavery_pool_submit(slavery_pool_t *pool, slavery_report_t *report);
+void slavery_pool_get_stats(slavery_pool_t *pool, const size_t worker_index, slavery_pool_stats_t *stats);
+void *slavery_pool_worker_run(slavery_pool_worker_t *worker);
@@ -0,0 +1,151 @@
+/**
+ * @file
+ * @brief Built-in model profile implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "profile.h"
+
+#include "receiver.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FEATURE(feature_id, feature_index, feature_version, feature_flags) \
+	{.id = feature_id, .index = feature_index, .version = feature_version, .flags = feature_flags},
+#define BUTTON(cid, task_id, flags, function_position, group, group_remap_mask, additional_flags) \
+	{{(cid) >> 8,                                                                                 \
+	  (cid)&0xff,                                                                                 \
+	  (task_id) >> 8,                                                                             \
+	  (task_id)&0xff,                                                                             \
+	  flags,                                                                                      \
+	  function_position,                                                                          \
+	  group,                                                                                      \
+	  group_remap_mask,                                                                           \
+	  additional_flags}},
+#define PROFILE(profile_id, name, type, protocol, prefix, number, revision, build, features, buttons) \
+	static const slavery_feature_t profile_id##_FEATURES[] = {features(FEATURE)};                     \
+	static const slavery_profile_button_t profile_id##_BUTTONS[] = {buttons(BUTTON)};
+PROFILE_MAP(PROFILE)
+#undef PROFILE
+#undef BUTTON
+#undef FEATURE
+
+static const slavery_profile_t slavery_profiles[SLAVERY_PROFILE_COUNT] = {
+#define PROFILE(profile_id, name, type, protocol, prefix, number, revision, build, features, buttons) \
+	[profile_id] = {name,                                                                             \
+	                type,                                                                             \
+	                protocol,                                                                         \
+	                prefix,                                                                           \
+	                number,                                                                           \
+	                revision,                                                                         \
+	                build,                                                                            \
+	                sizeof(profile_id##_FEATURES) / sizeof(slavery_feature_t),                        \
+	                profile_id##_FEATURES,                                                            \
+	                sizeof(profile_id##_BUTTONS) / sizeof(slavery_profile_button_t),                  \
+	                profile_id##_BUTTONS},
+	PROFILE_MAP(PROFILE)
+#undef PROFILE
+};
+
+const slavery_profile_t *slavery_profile_get(const slavery_profile_id_t profile_id) {
+	return &slavery_profiles[profile_id];
+}
+
+const slavery_profile_t *slavery_profile_find(const uint8_t firmware[]) {
+	// The firmware payload is type, 3 character prefix, number, revision and a 16 bit build.
+	for (size_t i = 0; i < SLAVERY_PROFILE_COUNT; i++) {
+		const slavery_profile_t *profile = &slavery_profiles[i];
+
+		if (memcmp(firmware + 1, profile->firmware_prefix, sizeof(profile->firmware_prefix)) == 0 &&
+		    firmware[4] == profile->firmware_number && firmware[5] == profile->firmware_revision &&
+		    ((uint16_t)firmware[6] << 8 | firmware[7]) == profile->firmware_build) {
+			return profile;
+		}
+	}
+
+	return NULL;
+}
+
+slavery_device_t *slavery_profile_get_device(slavery_receiver_t *receiver,
+                                             const uint8_t device_index,
+                                             uint8_t firmware[]) {
+	slavery_device_t *device = calloc(1, sizeof(slavery_device_t));
+	const slavery_profile_t *profile;
+	slavery_feature_t firmware_feature;
+
+	device->receiver = receiver;
+	device->index = device_index;
+
+	slavery_feature_table_init(&device->features);
+
+	// Identifying the model takes two requests: where the firmware feature is, then the firmware version.
+	if (slavery_device_get_feature(device, SLAVERY_FEATURE_ID_FIRMWARE, &firmware_feature) < 0) {
+		free(device);
+
+		return NULL;
+	}
+
+	slavery_feature_table_insert(&device->features, &firmware_feature);
+
+	if (slavery_device_get_firmware(device) < 0) {
+		free(device);
+
+		return NULL;
+	}
+
+	// Discovery goes on from here for a model without a profile, so the version isn't asked for again.
+	memcpy(firmware, device->firmware, SLAVERY_DEVICE_FIRMWARE_SIZE);
+
+	if ((profile = slavery_profile_find(device->firmware)) == NULL) {
+		log_debug("no profile for device on %s:%u", receiver->devnode, device_index);
+
+		free(device);
+
+		errno = ENOENT;
+
+		return NULL;
+	}
+
+	// A device reporting the firmware feature somewhere else isn't the model the profile describes.
+	slavery_feature_table_init(&device->features);
+
+	for (size_t i = 0; i < profile->num_features; i++) {
+		slavery_feature_table_insert(&device->features, &profile->features[i]);
+	}
+
+	if (slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_FIRMWARE) != firmware_feature.index) {
+		log_debug("device on %s:%u doesn't match profile %s", receiver->devnode, device_index, profile->name);
+
+		free(device);
+
+		errno = ENOENT;
+
+		return NULL;
+	}
+
+	log_debug("using profile %s for device on %s:%u", profile->name, receiver->devnode, device_index);
+
+	device->protocol_version = strdup(profile->protocol_version);
+	device->type = profile->type;
+	device->name = strdup(profile->name);
+	device->num_buttons = profile->num_buttons;
+	device->buttons = malloc(device->num_buttons * sizeof(slavery_button_t *));
+
+	for (size_t i = 0; i < device->num_buttons; i++) {
+		uint8_t response_data[SLAVERY_PACKET_LENGTH_CONTROL_LONG] = {0};
+
+		memcpy(response_data + 4, profile->buttons[i].info, sizeof(profile->buttons[i].info));
+
+		device->buttons[i] = slavery_device_parse_button(device, i, response_data);
+	}
+
+	return device;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file
+ * @brief Built-in model profiles, used in place of protocol discovery for known devices.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "button.h"
+#include "device.h"
+#include "feature.h"
+#include "utils.h"
+
+#include <stdint.h>
+
+/**
+ * @brief MX Master 3 features, as (feature ID, index, version, flags), listed the way FeatureSet enumerates
+ * them so a device built from the profile matches a discovered one. Flags mark features as hidden (0x40) and
+ * internal (0x20), and are only kept so the two match.
+ */
+#define PROFILE_MX_MASTER_3_FEATURES(FEATURE)                     \
+	FEATURE(SLAVERY_FEATURE_ID_ROOT, 0x00, 0x02, 0x00)            \
+	FEATURE(SLAVERY_FEATURE_ID_FEATURE_SET, 0x01, 0x02, 0x00)     \
+	FEATURE(SLAVERY_FEATURE_ID_FIRMWARE, 0x02, 0x03, 0x00)        \
+	FEATURE(SLAVERY_FEATURE_ID_NAME_TYPE, 0x03, 0x04, 0x00)       \
+	FEATURE(SLAVERY_FEATURE_ID_WIRELESS_STATUS, 0x04, 0x00, 0x00) \
+	FEATURE(SLAVERY_FEATURE_ID_RESET, 0x05, 0x00, 0x00)           \
+	FEATURE(SLAVERY_FEATURE_ID_CRYPTO, 0x06, 0x01, 0x00)          \
+	FEATURE(SLAVERY_FEATURE_ID_BATTERY, 0x07, 0x02, 0x00)         \
+	FEATURE(SLAVERY_FEATURE_ID_HOST, 0x08, 0x01, 0x00)            \
+	FEATURE(SLAVERY_FEATURE_ID_CONTROLS_V4, 0x09, 0x04, 0x00)     \
+	FEATURE(SLAVERY_FEATURE_ID_ADJUSTABLE_DPI, 0x0a, 0x02, 0x00)  \
+	FEATURE(SLAVERY_FEATURE_ID_SMART_SHIFT, 0x0b, 0x00, 0x00)     \
+	FEATURE(SLAVERY_FEATURE_ID_HIRES_WHEEL, 0x0c, 0x01, 0x00)     \
+	FEATURE(SLAVERY_FEATURE_ID_THUMB_WHEEL, 0x0d, 0x00, 0x00)     \
+	FEATURE(0x00c2, 0x0e, 0x00, 0x00)                             \
+	FEATURE(0x1802, 0x0f, 0x00, 0x60)                             \
+	FEATURE(0x1803, 0x10, 0x00, 0x60)                             \
+	FEATURE(0x1806, 0x11, 0x04, 0x60)                             \
+	FEATURE(0x1812, 0x12, 0x00, 0x60)                             \
+	FEATURE(0x1805, 0x13, 0x00, 0x60)                             \
+	FEATURE(0x1830, 0x14, 0x00, 0x60)                             \
+	FEATURE(0x1890, 0x15, 0x06, 0x60)                             \
+	FEATURE(0x1891, 0x16, 0x06, 0x60)                             \
+	FEATURE(0x18a1, 0x17, 0x00, 0x60)                             \
+	FEATURE(0x1e00, 0x18, 0x00, 0x40)                             \
+	FEATURE(0x1eb0, 0x19, 0x00, 0x60)                             \
+	FEATURE(0x1861, 0x1a, 0x00, 0x60)                             \
+	FEATURE(0x1e22, 0x1b, 0x00, 0x60)
+
+/**
+ * @brief MX Master 3 controls, as the fields of their GET_BUTTON_INFO responses: (CID, task ID, flags,
+ * function position, group, group remap mask, additional flags).
+ */
+#define PROFILE_MX_MASTER_3_BUTTONS(BUTTON)                                 \
+	BUTTON(SLAVERY_CID_MOUSE_LEFT, 0x0038, 0x01, 0x00, 0x01, 0x00, 0x00)    \
+	BUTTON(SLAVERY_CID_MOUSE_RIGHT, 0x0039, 0x01, 0x00, 0x01, 0x00, 0x00)   \
+	BUTTON(SLAVERY_CID_MOUSE_MIDDLE, 0x003a, 0x71, 0x00, 0x02, 0x0e, 0x01)  \
+	BUTTON(SLAVERY_CID_MOUSE_BACK, 0x003c, 0x71, 0x00, 0x02, 0x0e, 0x01)    \
+	BUTTON(SLAVERY_CID_MOUSE_FORWARD, 0x003e, 0x71, 0x00, 0x02, 0x0e, 0x01) \
+	BUTTON(SLAVERY_CID_MOUSE_THUMB, 0x00a9, 0x71, 0x00, 0x02, 0x0e, 0x01)   \
+	BUTTON(SLAVERY_CID_MOUSE_TOP, 0x00aa, 0x71, 0x00, 0x02, 0x0e, 0x01)     \
+	BUTTON(0x00d7, 0x00b4, 0xa0, 0x00, 0x00, 0x00, 0x01)
+
+/**
+ * @brief Known models, as (profile ID, name, device type, protocol version, firmware prefix, firmware number,
+ * firmware revision, firmware build, features, buttons). Firmware numbers are BCD, as reported by the device,
+ * and must match exactly for a profile to be used.
+ */
+#define PROFILE_MAP(PROFILE)              \
+	PROFILE(SLAVERY_PROFILE_MX_MASTER_3,  \
+	        "Wireless Mouse MX Master 3", \
+	        SLAVERY_DEVICE_TYPE_MOUSE,    \
+	        "4.5",                        \
+	        "RBM",                        \
+	        0x14,                         \
+	        0x00,                         \
+	        0x0009,                       \
+	        PROFILE_MX_MASTER_3_FEATURES, \
+	        PROFILE_MX_MASTER_3_BUTTONS)
+
+/**
+ * @brief Built-in profile IDs.
+ */
+typedef enum
+{
+#define PROFILE(profile_id, name, type, protocol, prefix, number, revision, build, features, buttons) \
+	profile_id,
+	PROFILE_MAP(PROFILE)
+#undef PROFILE
+	SLAVERY_PROFILE_COUNT
+} slavery_profile_id_t;
+
+/**
+ * @brief A control, kept as the payload of its GET_BUTTON_INFO response.
+ */
+typedef struct slavery_profile_button_t {
+	uint8_t info[SLAVERY_PACKET_LENGTH_CONTROL_LONG - 4];
+} slavery_profile_button_t;
+
+/**
+ * @brief Everything discovery would find out about a known model.
+ */
+typedef struct slavery_profile_t {
+	const char *name;
+	slavery_device_type_t type;
+	const char *protocol_version;
+	char firmware_prefix[3];
+	uint8_t firmware_number;
+	uint8_t firmware_revision;
+	uint16_t firmware_build;
+	size_t num_features;
+	const slavery_feature_t *features;
+	size_t num_buttons;
+	const slavery_profile_button_t *buttons;
+} slavery_profile_t;
+
+const slavery_profile_t *slavery_profile_get(const slavery_profile_id_t profile_id);
+const slavery_profile_t *slavery_profile_find(const uint8_t firmware[]);
+slavery_device_t *slavery_profile_get_device(slavery_receiver_t *receiver,
+                                             const uint8_t device_index,
+                                             uint8_t firmware[]);
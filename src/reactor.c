@@ -0,0 +1,188 @@
+/**
+ * @file
+ * @brief Single-threaded epoll event loop implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "reactor.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define SLAVERY_REACTOR_MAX_EVENTS 16
+
+slavery_reactor_t *slavery_reactor_new() {
+	log_debug("creating reactor");
+
+	slavery_reactor_t *reactor = malloc(sizeof(slavery_reactor_t));
+	struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+
+	atomic_init(&reactor->generation, 0);
+	atomic_init(&reactor->running, true);
+
+	if ((reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "epoll_create1() failed");
+
+		free(reactor);
+
+		return NULL;
+	}
+
+	if ((reactor->wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		close(reactor->epoll_fd);
+		free(reactor);
+
+		return NULL;
+	}
+
+	// The wakeup eventfd is the only registration without a handler.
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wakeup_fd, &event) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "epoll_ctl() failed");
+
+		close(reactor->wakeup_fd);
+		close(reactor->epoll_fd);
+		free(reactor);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&reactor->mutex, NULL);
+
+	if ((errno = pthread_create(&reactor->thread, NULL, (pthread_callback_t)slavery_reactor_run, reactor)) !=
+	    0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		pthread_mutex_destroy(&reactor->mutex);
+		close(reactor->wakeup_fd);
+		close(reactor->epoll_fd);
+		free(reactor);
+
+		return NULL;
+	}
+
+	return reactor;
+}
+
+int slavery_reactor_free(slavery_reactor_t *reactor) {
+	log_debug("freeing reactor at %p", reactor);
+
+	atomic_store(&reactor->running, false);
+
+	if (eventfd_write(reactor->wakeup_fd, 1) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write() failed");
+
+		return -1;
+	}
+
+	if ((errno = pthread_join(reactor->thread, NULL)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+
+		return -1;
+	}
+
+	pthread_mutex_destroy(&reactor->mutex);
+	close(reactor->wakeup_fd);
+	close(reactor->epoll_fd);
+	free(reactor);
+
+	return 0;
+}
+
+int slavery_reactor_add(slavery_reactor_t *reactor, slavery_reactor_handler_t *handler) {
+	struct epoll_event event = {.events = EPOLLIN, .data.ptr = handler};
+
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, handler->fd, &event) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "epoll_ctl() failed");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+int slavery_reactor_remove(slavery_reactor_t *reactor, slavery_reactor_handler_t *handler) {
+	bool on_reactor_thread = pthread_equal(pthread_self(), reactor->thread);
+
+	// Once this returns the handler's owner may be freed, so make sure the reactor isn't part way through
+	// a batch that still references it. Bumping the generation makes the reactor discard its current batch;
+	// registrations are level-triggered, so anything still pending is reported again.
+	if (!on_reactor_thread) {
+		pthread_mutex_lock(&reactor->mutex);
+	}
+
+	int result = epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, handler->fd, NULL);
+
+	atomic_fetch_add(&reactor->generation, 1);
+
+	if (!on_reactor_thread) {
+		pthread_mutex_unlock(&reactor->mutex);
+	}
+
+	if (result < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "epoll_ctl() failed");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void *slavery_reactor_run(slavery_reactor_t *reactor) {
+	if ((errno = pthread_setname_np(pthread_self(), "reactor")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	log_debug("started");
+
+	struct epoll_event events[SLAVERY_REACTOR_MAX_EVENTS];
+
+	while (atomic_load(&reactor->running)) {
+		unsigned int generation = atomic_load(&reactor->generation);
+		int num_events = epoll_wait(reactor->epoll_fd, events, SLAVERY_REACTOR_MAX_EVENTS, -1);
+
+		if (num_events < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "epoll_wait() failed");
+
+			break;
+		}
+
+		pthread_mutex_lock(&reactor->mutex);
+
+		for (int i = 0; i < num_events && atomic_load(&reactor->generation) == generation; i++) {
+			slavery_reactor_handler_t *handler = events[i].data.ptr;
+
+			if (handler == NULL) {
+				eventfd_t value;
+
+				eventfd_read(reactor->wakeup_fd, &value);
+
+				continue;
+			}
+
+			handler->callback(handler->data, events[i].events);
+		}
+
+		pthread_mutex_unlock(&reactor->mutex);
+	}
+
+	log_debug("stopped");
+
+	return NULL;
+}
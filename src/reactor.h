@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @brief Single-threaded epoll event loop functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Called on the reactor thread when a registered file descriptor is ready.
+ */
+typedef void (*slavery_reactor_callback_t)(void *data, const uint32_t events);
+
+/**
+ * @brief Registration of a file descriptor with the reactor, embedded in its owner.
+ */
+typedef struct slavery_reactor_handler_t {
+	int fd;
+	slavery_reactor_callback_t callback;
+	void *data;
+} slavery_reactor_handler_t;
+
+/**
+ * @brief Multiplexes receivers and the udev monitor onto a single thread.
+ */
+typedef struct slavery_reactor_t {
+	int epoll_fd;
+	int wakeup_fd;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	atomic_uint generation;
+	atomic_bool running;
+} slavery_reactor_t;
+
+slavery_reactor_t *slavery_reactor_new();
+int slavery_reactor_free(slavery_reactor_t *reactor);
+int slavery_reactor_add(slavery_reactor_t *reactor, slavery_reactor_handler_t *handler);
+int slavery_reactor_remove(slavery_reactor_t *reactor, slavery_reactor_handler_t *handler);
+void *slavery_reactor_run(slavery_reactor_t *reactor);
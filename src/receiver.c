@@ -13,18 +13,28 @@
 #include "receiver.h"
 
 #include "button.h"
+#include "cache.h"
+#include "capture.h"
 #include "device.h"
 #include "event.h"
 #include "feature.h"
+#include "pool.h"
+#include "profile.h"
+#include "reactor.h"
+#include "replay.h"
+#include "transport.h"
+#include "uring.h"
 #include "utils.h"
 
 #include <errno.h>
-#include <fcntl.h>
-#include <linux/hidraw.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ioctl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
 #include <unistd.h>
 
 const uint16_t SLAVERY_USB_VENDOR_ID_LOGITECH = 0x046d;
@@ -46,45 +56,72 @@ void slavery_receiver_array_free(slavery_receiver_t *receivers[], const ssize_t
 
 int slavery_receiver_free(slavery_receiver_t *receiver) {
 	log_debug("freeing receiver %s", receiver->devnode);
-	log_debug("stopping listener thread");
 
-	if ((errno = pthread_cancel(receiver->listener_thread)) != 0) {
-		if (errno == ESRCH) {
-			log_debug("listener thread has already finished");
-		} else {
-			log_warning_errno(SLAVERY_ERROR_OS, "pthread_cancel()");
+#ifdef SLAVERY_IO_URING
+	if (receiver->slavery->uring != NULL) {
+		log_debug("removing receiver from io_uring");
+
+		if (slavery_uring_remove(receiver->slavery->uring, receiver) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to remove receiver from io_uring");
 
 			return -1;
 		}
-	}
+	} else
+#endif
+	    if (receiver->slavery->reactor != NULL) {
+		log_debug("removing receiver from reactor");
 
-	if ((errno = pthread_join(receiver->listener_thread, NULL)) != 0) {
-		log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+		if (atomic_exchange(&receiver->listening, false) &&
+		    slavery_reactor_remove(receiver->slavery->reactor, &receiver->handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to remove receiver from reactor");
 
-		return -1;
-	}
+			return -1;
+		}
 
-	log_debug("closing file descriptors");
+		if (slavery_reactor_remove(receiver->slavery->reactor, &receiver->timer_handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to remove receiver timers from reactor");
 
-	if (close(receiver->control_pipe[0]) < 0) {
-		log_warning_errno(SLAVERY_ERROR_IO, "close()");
+			return -1;
+		}
+	} else {
+		log_debug("stopping listener thread");
 
-		return -1;
+		if (eventfd_write(receiver->stop_fd, 1) < 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write()");
+
+			return -1;
+		}
+
+		if ((errno = pthread_join(receiver->listener_thread, NULL)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+
+			return -1;
+		}
 	}
 
-	if (close(receiver->control_pipe[1]) < 0) {
+	log_debug("waiting for queued events to be dispatched");
+
+	while (atomic_load_explicit(&receiver->pending_events, memory_order_acquire) > 0) {
+		sched_yield();
+	}
+
+	log_debug("closing file descriptors");
+
+	if (close(receiver->stop_fd) < 0) {
 		log_warning_errno(SLAVERY_ERROR_IO, "close()");
 
 		return -1;
 	}
 
-	if (close(receiver->fd) < 0) {
+	if (receiver->transport->close(receiver->transport, receiver->fd) < 0) {
 		log_warning_errno(SLAVERY_ERROR_IO, "close()");
 
 		return -1;
 	}
 
 	slavery_device_array_free(receiver->devices, receiver->num_devices);
+	slavery_timer_wheel_destroy(&receiver->timers);
+	slavery_request_table_destroy(&receiver->requests);
 
 	free(receiver->devnode);
 	free(receiver->name);
@@ -94,15 +131,77 @@ int slavery_receiver_free(slavery_receiver_t *receiver) {
 	return 0;
 }
 
+/**
+ * @brief Slots probed at once. Each can keep a full window of requests in flight without the others having to
+ * wait for room in the request table.
+ */
+#define SLAVERY_RECEIVER_MAX_SLOT_PROBES (SLAVERY_REQUEST_TABLE_SIZE / SLAVERY_SOFTWARE_ID_COUNT)
+
+typedef struct slavery_receiver_slot_scan_t {
+	slavery_receiver_t *receiver;
+	atomic_uint next_device_index;
+	slavery_device_t *devices[SLAVERY_DEVICE_INDEX_6 + 1];
+} slavery_receiver_slot_scan_t;
+
+typedef struct slavery_receiver_slot_probe_t {
+	slavery_receiver_slot_scan_t *scan;
+	pthread_t thread;
+	bool started;
+} slavery_receiver_slot_probe_t;
+
+static void *slavery_receiver_slot_probe_run(slavery_receiver_slot_probe_t *probe) {
+	slavery_receiver_slot_scan_t *scan = probe->scan;
+	unsigned int device_index;
+
+	while ((device_index = atomic_fetch_add(&scan->next_device_index, 1)) <= SLAVERY_DEVICE_INDEX_6) {
+		scan->devices[device_index] = slavery_receiver_get_device(scan->receiver, device_index);
+	}
+
+	return NULL;
+}
+
 ssize_t slavery_receiver_scan_devices(slavery_receiver_t *receiver) {
 	log_debug("getting devices connected to receiver %s...", receiver->devnode);
 
+	slavery_receiver_slot_scan_t scan = {.receiver = receiver};
+	slavery_receiver_slot_probe_t probes[SLAVERY_RECEIVER_MAX_SLOT_PROBES];
+	uint64_t start_ns = time_monotonic_ns();
+
 	receiver->num_devices = 0;
 	receiver->devices = NULL;
 
+	atomic_init(&scan.next_device_index, SLAVERY_DEVICE_INDEX_1);
+
+	for (uint8_t device_index = 0; device_index <= SLAVERY_DEVICE_INDEX_6; device_index++) {
+		atomic_store(&receiver->device_slots[device_index], NULL);
+	}
+
+	// Requests to different slots are correlated independently, so slots are probed a few at a time, each
+	// probe taking the next slot as it finishes. Empty slots answer at once, so the scan takes about as long
+	// as the slowest device.
+	for (size_t i = 0; i < SLAVERY_RECEIVER_MAX_SLOT_PROBES; i++) {
+		probes[i] = (slavery_receiver_slot_probe_t){.scan = &scan, .started = true};
+
+		if ((errno = pthread_create(&probes[i].thread,
+		                            NULL,
+		                            (pthread_callback_t)slavery_receiver_slot_probe_run,
+		                            &probes[i])) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed, probing inline");
+
+			probes[i].started = false;
+			slavery_receiver_slot_probe_run(&probes[i]);
+		}
+	}
+
+	for (size_t i = 0; i < SLAVERY_RECEIVER_MAX_SLOT_PROBES; i++) {
+		if (probes[i].started) {
+			pthread_join(probes[i].thread, NULL);
+		}
+	}
+
 	for (uint8_t device_index = SLAVERY_DEVICE_INDEX_1; device_index <= SLAVERY_DEVICE_INDEX_6;
 	     device_index++) {
-		slavery_device_t *device = slavery_receiver_get_device(receiver, device_index);
+		slavery_device_t *device = scan.devices[device_index];
 
 		if (device == NULL) {
 			log_debug("no device on %s:%u", receiver->devnode, device_index);
@@ -110,23 +209,73 @@ ssize_t slavery_receiver_scan_devices(slavery_receiver_t *receiver) {
 			continue;
 		}
 
+		slavery_device_build_button_table(device);
+
 		receiver->devices =
 		    realloc(receiver->devices, sizeof(slavery_device_t) * (receiver->num_devices + 1));
 		receiver->devices[receiver->num_devices++] = device;
+		atomic_store_explicit(&receiver->device_slots[device_index], device, memory_order_release);
 	}
 
-	log_debug("found %u devices on receiver %s", receiver->num_devices, receiver->devnode);
+	log_debug("found %u devices on receiver %s in %luus",
+	          receiver->num_devices,
+	          receiver->devnode,
+	          (time_monotonic_ns() - start_ns) / 1000);
 
 	return receiver->num_devices;
 }
 
+slavery_device_t *slavery_receiver_get_device_slot(slavery_receiver_t *receiver, const uint8_t device_index) {
+	if (device_index > SLAVERY_DEVICE_INDEX_6) {
+		return NULL;
+	}
+
+	return atomic_load_explicit(&receiver->device_slots[device_index], memory_order_acquire);
+}
+
 slavery_device_t *slavery_receiver_get_device(slavery_receiver_t *receiver, const uint8_t device_index) {
 	log_debug("trying to communicate with device on %s:%u...", receiver->devnode, device_index);
 
-	slavery_device_t *device = malloc(sizeof(slavery_device_t));
+	slavery_cache_t *cache = receiver->slavery->cache;
+	slavery_device_t *device;
+
+	if (cache != NULL) {
+		if ((device = slavery_cache_get_device(cache, receiver, device_index)) != NULL) {
+			return device;
+		}
+
+		// Only a missing or stale entry is worth a full discovery, anything else means there's no device.
+		if (errno != ENOENT && errno != ESTALE) {
+			return NULL;
+		}
+	}
+
+	uint8_t firmware[SLAVERY_DEVICE_FIRMWARE_SIZE] = {0};
+	bool firmware_read = false;
+
+	if (receiver->slavery->options.profiles) {
+		if ((device = slavery_profile_get_device(receiver, device_index, firmware)) != NULL) {
+			if (cache != NULL) {
+				slavery_cache_mark_dirty(cache);
+			}
+
+			return device;
+		}
+
+		if (errno != ENOENT) {
+			return NULL;
+		}
+
+		// Identifying the model read the firmware version, if the device has a firmware feature at all.
+		firmware_read = true;
+	}
+
+	device = calloc(1, sizeof(slavery_device_t));
 	device->receiver = receiver;
 	device->index = device_index;
 
+	memcpy(device->firmware, firmware, SLAVERY_DEVICE_FIRMWARE_SIZE);
+
 	if (slavery_device_get_features(device) < 0) {
 		log_debug("failed to get device features for %s:%u", receiver->devnode, device_index);
 
@@ -184,20 +333,24 @@ slavery_device_t *slavery_receiver_get_device(slavery_receiver_t *receiver, cons
 
 	device->buttons = malloc(device->num_buttons * sizeof(slavery_button_t *));
 
-	for (size_t i = 0; i < device->num_buttons; i++) {
-		device->buttons[i] = slavery_device_get_button(device, i);
+	if (slavery_device_get_buttons(device) < 0) {
+		log_debug("failed to get button information for %s:%u", receiver->devnode, device_index);
 
-		if (device->buttons[i] == NULL) {
-			log_debug("failed to get information for button %u", i);
+		free(device->buttons);
+		free(device->protocol_version);
+		free(device->name);
+		free(device);
 
-			free(device->buttons);
-			free(device->protocol_version);
-			free(device->name);
-			free(device);
+		return NULL;
+	}
 
-			return NULL;
-		}
+	if (cache != NULL &&
+	    (firmware_read ? slavery_feature_id_to_index(device, SLAVERY_FEATURE_ID_FIRMWARE) >= 0
+	                   : slavery_device_get_firmware(device) == 0)) {
+		slavery_cache_mark_dirty(cache);
+	}
 
+	for (size_t i = 0; i < device->num_buttons; i++) {
 		// TODO: remove this - this is for testing remapping.
 		if (device->buttons[i]->cid == 0x00c3) {
 			slavery_device_remap_button(device, device->buttons[i]);
@@ -207,62 +360,192 @@ slavery_device_t *slavery_receiver_get_device(slavery_receiver_t *receiver, cons
 	return device;
 }
 
-slavery_receiver_t *slavery_receiver_from_devnode(const char *devnode) {
+static int slavery_receiver_start(slavery_receiver_t *receiver) {
+	slavery_t *slavery = receiver->slavery;
+
+	receiver->num_devices = 0;
+	receiver->devices = NULL;
+
+	for (uint8_t device_index = 0; device_index <= SLAVERY_DEVICE_INDEX_6; device_index++) {
+		atomic_init(&receiver->device_slots[device_index], NULL);
+	}
+
+	receiver->replay = NULL;
+
+	slavery_request_table_init(&receiver->requests);
+
+	if ((receiver->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		slavery_request_table_destroy(&receiver->requests);
+
+		return -1;
+	}
+
+	// Tap and hold timers for every device on the receiver share one wheel, serviced alongside its reports.
+	if (slavery_timer_wheel_init(&receiver->timers) < 0) {
+		log_warning(SLAVERY_ERROR_OS, "failed to create timer wheel");
+
+		close(receiver->stop_fd);
+		slavery_request_table_destroy(&receiver->requests);
+
+		return -1;
+	}
+
+	log_debug("found receiver %s on %s", receiver->name, receiver->devnode);
+
+#ifdef SLAVERY_IO_URING
+	if (slavery->uring != NULL) {
+		log_debug("adding receiver to io_uring...");
+
+		if (slavery_uring_add(slavery->uring, receiver) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to add receiver to io_uring");
+
+			slavery_timer_wheel_destroy(&receiver->timers);
+			close(receiver->stop_fd);
+			slavery_request_table_destroy(&receiver->requests);
+
+			return -1;
+		}
+
+		return 0;
+	}
+#endif
+
+	if (slavery->reactor != NULL) {
+		log_debug("adding receiver to reactor...");
+
+		receiver->handler.fd = receiver->fd;
+		receiver->handler.callback = slavery_receiver_on_readable;
+		receiver->handler.data = receiver;
+		receiver->timer_handler.fd = receiver->timers.fd;
+		receiver->timer_handler.callback = slavery_receiver_on_timer;
+		receiver->timer_handler.data = receiver;
+		atomic_init(&receiver->listening, true);
+
+		if (slavery_reactor_add(slavery->reactor, &receiver->timer_handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to add receiver timers to reactor");
+
+			slavery_timer_wheel_destroy(&receiver->timers);
+			close(receiver->stop_fd);
+			slavery_request_table_destroy(&receiver->requests);
+
+			return -1;
+		}
+
+		if (slavery_reactor_add(slavery->reactor, &receiver->handler) < 0) {
+			log_warning(SLAVERY_ERROR_OS, "failed to add receiver to reactor");
+
+			slavery_reactor_remove(slavery->reactor, &receiver->timer_handler);
+
+			slavery_timer_wheel_destroy(&receiver->timers);
+			close(receiver->stop_fd);
+			slavery_request_table_destroy(&receiver->requests);
+
+			return -1;
+		}
+
+		return 0;
+	}
+
+	log_debug("starting receiver listener thread...");
+
+	if ((errno = pthread_create(
+	         &receiver->listener_thread, NULL, (pthread_callback_t)slavery_receiver_listen, receiver)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		slavery_timer_wheel_destroy(&receiver->timers);
+		close(receiver->stop_fd);
+		slavery_request_table_destroy(&receiver->requests);
+
+		return -1;
+	}
+
+	log_debug("receiver listener thread started");
+
+	// virtual_input_create_device();
+
+	return 0;
+}
+
+slavery_receiver_t *slavery_receiver_from_devnode(slavery_t *slavery, const char *devnode) {
 	log_debug("trying to create a receiver from devnod %s...", devnode);
 
 	slavery_receiver_t *receiver = malloc(sizeof(slavery_receiver_t));
-	struct hidraw_devinfo info;
-	int length;
+	const slavery_transport_t *transport = slavery->transport;
+	slavery_transport_info_t info;
 
-	if ((receiver->fd = open(devnode, O_RDWR)) < 0) {
-		log_warning_errno(SLAVERY_ERROR_IO, "open() failed");
+	receiver->slavery = slavery;
+	receiver->transport = transport;
+	atomic_init(&receiver->pending_events, 0);
+
+	if ((receiver->fd = transport->open(transport, devnode)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to open %s", devnode);
 
 		free(receiver);
 
 		return NULL;
 	}
 
-	if ((ioctl(receiver->fd, HIDIOCGRAWINFO, &info)) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWINFO) failed");
+	if (transport->info(transport, receiver->fd, &info) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to identify %s", devnode);
 
-		close(receiver->fd);
+		transport->close(transport, receiver->fd);
 		free(receiver);
 
 		return NULL;
 	}
 
-	if ((uint16_t)info.vendor != SLAVERY_USB_VENDOR_ID_LOGITECH ||
-	    (uint16_t)info.product != SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER) {
+	if (info.vendor_id != SLAVERY_USB_VENDOR_ID_LOGITECH ||
+	    info.product_id != SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER) {
 		log_debug("found mismatching vendor ID/product ID, ignoring devnode");
 
-		close(receiver->fd);
+		transport->close(transport, receiver->fd);
 		free(receiver);
 
 		return NULL;
 	}
 
+	// Captures tell receivers apart by their minor, such as the N in /dev/hidrawN.
 	receiver->devnode = strdup(devnode);
-	receiver->vendor_id = info.vendor;
-	receiver->product_id = info.product;
-	receiver->name = malloc(256);
-
-	if ((length = ioctl(receiver->fd, HIDIOCGRAWNAME(256), receiver->name)) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWNAME) failed");
-
-		close(receiver->fd);
+	receiver->minor = info.minor;
+	receiver->vendor_id = info.vendor_id;
+	receiver->product_id = info.product_id;
+	receiver->name = strdup(info.name);
+	receiver->address = strdup(info.address);
+
+	if (slavery_receiver_start(receiver) < 0) {
+		transport->close(transport, receiver->fd);
+		free(receiver->devnode);
 		free(receiver->name);
+		free(receiver->address);
 		free(receiver);
 
 		return NULL;
 	}
 
-	receiver->name = realloc(receiver->name, length);
-	receiver->address = malloc(256);
+	return receiver;
+}
 
-	if ((length = ioctl(receiver->fd, HIDIOCGRAWPHYS(256), receiver->address)) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWPHYS) failed");
+slavery_receiver_t *slavery_receiver_from_fd(slavery_t *slavery, const int fd, const char *name) {
+	log_debug("creating a receiver for %s on fd %d...", name, fd);
 
-		close(receiver->fd);
+	slavery_receiver_t *receiver = malloc(sizeof(slavery_receiver_t));
+
+	// Whatever is at the other end stands in for a unifying receiver, so there is nothing to identify.
+	receiver->slavery = slavery;
+	receiver->transport = &slavery_transport_socket;
+	receiver->fd = fd;
+	receiver->devnode = strdup(name);
+	receiver->minor = 0;
+	receiver->vendor_id = SLAVERY_USB_VENDOR_ID_LOGITECH;
+	receiver->product_id = SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER;
+	receiver->name = strdup(name);
+	receiver->address = strdup(name);
+	atomic_init(&receiver->pending_events, 0);
+
+	if (slavery_receiver_start(receiver) < 0) {
+		free(receiver->devnode);
 		free(receiver->name);
 		free(receiver->address);
 		free(receiver);
@@ -270,87 +553,151 @@ slavery_receiver_t *slavery_receiver_from_devnode(const char *devnode) {
 		return NULL;
 	}
 
-	receiver->address = realloc(receiver->address, length);
-	receiver->num_devices = 0;
-	receiver->devices = NULL;
+	return receiver;
+}
 
-	if (pipe2(receiver->control_pipe, O_DIRECT) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "pipe2() failed");
+static inline void slavery_receiver_capture(slavery_receiver_t *receiver,
+                                            const slavery_capture_direction_t direction,
+                                            const uint8_t data[],
+                                            const size_t size) {
+	if (receiver->slavery->capture != NULL) {
+		slavery_capture_report(receiver->slavery->capture, receiver->minor, direction, data, size);
+	}
+}
 
-		close(receiver->fd);
-		free(receiver->name);
-		free(receiver->address);
-		free(receiver);
+void slavery_receiver_handle_report(slavery_receiver_t *receiver, slavery_report_t *report) {
+	slavery_receiver_capture(receiver, SLAVERY_CAPTURE_DIRECTION_IN, report->data, report->size);
 
-		return NULL;
+	if (receiver->replay != NULL) {
+		slavery_replay_read(receiver->replay, report);
 	}
 
-	if (slavery_receiver_get_report_descriptor(receiver) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to get report descriptor");
+	switch (report->data[0]) {
+		case SLAVERY_REPORT_ID_EVENT: {
+			if (log_enabled(LOG_LEVEL_DEBUG)) {
+				char hex[report->size * 5];
 
-		close(receiver->control_pipe[0]);
-		close(receiver->control_pipe[1]);
-		close(receiver->fd);
-		free(receiver->name);
-		free(receiver->address);
-		free(receiver);
+				log_debug("queueing event of size %ld: %s",
+				          report->size,
+				          bytes_to_hex(report->data, report->size, hex));
+			}
 
-		return NULL;
-	}
+			slavery_pool_submit(receiver->slavery->pool, report);
 
-	log_debug("found receiver %s on %s", receiver->name, receiver->devnode);
-	log_debug("starting receiver listener thread...");
+			break;
+		}
 
-	if ((errno = pthread_create(
-	         &receiver->listener_thread, NULL, (pthread_callback_t)slavery_receiver_listen, receiver)) != 0) {
-		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+		default: {
+			if (slavery_request_table_complete(&receiver->requests, report->data, report->size)) {
+				break;
+			}
 
-		close(receiver->control_pipe[0]);
-		close(receiver->control_pipe[1]);
-		close(receiver->fd);
-		free(receiver->name);
-		free(receiver->address);
-		free(receiver);
+			if (log_enabled(LOG_LEVEL_DEBUG)) {
+				char hex[report->size * 5];
 
-		return NULL;
+				log_debug("queueing unsolicited control report of size %ld: %s",
+				          report->size,
+				          bytes_to_hex(report->data, report->size, hex));
+			}
+
+			// Nobody is waiting for this report, so treat it as a notification rather than a response.
+			slavery_pool_submit(receiver->slavery->pool, report);
+		}
 	}
+}
 
-	log_debug("receiver listener thread started");
+void slavery_receiver_handle_scratch(slavery_receiver_t *receiver, const uint8_t data[], const size_t size) {
+	slavery_receiver_capture(receiver, SLAVERY_CAPTURE_DIRECTION_IN, data, size);
 
-	// virtual_input_create_device();
+	if (receiver->replay != NULL) {
+		slavery_replay_read(receiver->replay, NULL);
+	}
 
-	return receiver;
+	// With every slot taken, responses still have to reach their waiters, but events are dropped.
+	if (!slavery_request_table_complete(&receiver->requests, data, size)) {
+		log_debug("report pool exhausted, dropping report");
+	}
 }
 
-int slavery_receiver_get_report_descriptor(slavery_receiver_t *receiver) {
-	log_debug("getting report descriptor for receiver %s...", receiver->devnode);
+ssize_t slavery_receiver_read_reports(slavery_receiver_t *receiver) {
+	slavery_report_pool_t *pool = receiver->slavery->reports;
+	const slavery_transport_t *transport = receiver->transport;
+	uint8_t scratch_data[SLAVERY_PACKET_LENGTH_MAX];
+	ssize_t num_reports = 0;
 
-	struct hidraw_report_descriptor desc;
+	// The receiver is non-blocking, and each read returns exactly one report.
+	while (true) {
+		// Reports are read straight into a pool slot, then shared with every consumer without copying.
+		slavery_report_t *report = slavery_report_acquire(pool);
+		uint8_t *report_data = report != NULL ? report->data : scratch_data;
+		ssize_t report_size =
+		    transport->read(transport, receiver->fd, report_data, SLAVERY_PACKET_LENGTH_MAX);
 
-	if ((ioctl(receiver->fd, HIDIOCGRDESCSIZE, &desc.size)) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRDESCSIZE) failed");
+		if (report_size <= 0) {
+			int read_errno = errno;
 
-		return -1;
+			if (report != NULL) {
+				slavery_report_unref(report);
+			}
+
+			// hidraw never returns 0, but a socket does once its other end has hung up.
+			if (report_size == 0) {
+				log_debug("receiver %s hung up", receiver->devnode);
+
+				return -1;
+			}
+
+			if (read_errno == EAGAIN || read_errno == EWOULDBLOCK) {
+				return num_reports;
+			}
+
+			if (read_errno == EINTR) {
+				continue;
+			}
+
+			errno = read_errno;
+
+			log_warning_errno(SLAVERY_ERROR_IO, "read()");
+
+			return -1;
+		}
+
+		num_reports++;
+
+		if (report == NULL) {
+			slavery_receiver_handle_scratch(receiver, scratch_data, report_size);
+
+			continue;
+		}
+
+		report->receiver = receiver;
+		report->size = report_size;
+
+		slavery_receiver_handle_report(receiver, report);
+		slavery_report_unref(report);
 	}
+}
 
-	if ((ioctl(receiver->fd, HIDIOCGRDESC, &desc)) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRDESC) failed");
+void slavery_receiver_on_readable(void *data, const uint32_t events) {
+	slavery_receiver_t *receiver = data;
 
-		return -1;
+	if (slavery_receiver_read_reports(receiver) < 0 || events & (EPOLLERR | EPOLLHUP)) {
+		log_debug("receiver %s went away, removing from reactor", receiver->devnode);
+
+		if (atomic_exchange(&receiver->listening, false)) {
+			slavery_reactor_remove(receiver->slavery->reactor, &receiver->handler);
+		}
 	}
+}
 
-#ifdef DEBUG
-	char hex[desc.size * 5];
+void slavery_receiver_on_timer(void *data, const uint32_t events) {
+	slavery_receiver_t *receiver = data;
 
-	log_debug(
-	    "received report descriptor of size %u: %s", desc.size, bytes_to_hex(desc.value, desc.size, hex));
-#endif
+	UNUSED(events);
 
-	return 0;
+	slavery_timer_wheel_expire(&receiver->timers);
 }
 
-// FIXME: hidraw read read/writes full records, my pipe doesn't necessarily
-// FIXME: sending control events to pipe when not actively requested -> pipe grows and isn't read from.
 void *slavery_receiver_listen(slavery_receiver_t *receiver) {
 	if ((errno = pthread_setname_np(pthread_self(), "listener")) != 0) {
 		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
@@ -358,126 +705,289 @@ void *slavery_receiver_listen(slavery_receiver_t *receiver) {
 
 	log_debug("started");
 
-	uint8_t response_data[SLAVERY_PACKET_LENGTH_MAX];
+	struct pollfd fds[] = {{.fd = receiver->fd, .events = POLLIN},
+	                       {.fd = receiver->stop_fd, .events = POLLIN},
+	                       {.fd = receiver->timers.fd, .events = POLLIN}};
 
 	while (true) {
-		ssize_t response_size = read(receiver->fd, response_data, SLAVERY_PACKET_LENGTH_MAX);
+		if (poll(fds, 3, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
 
-		if (response_size < 0) {
-			log_warning_errno(SLAVERY_ERROR_IO, "read()");
+			log_warning_errno(SLAVERY_ERROR_OS, "poll()");
 
 			return NULL;
 		}
 
-		switch (response_data[0]) {
-			case SLAVERY_REPORT_ID_EVENT: {
-#ifdef DEBUG
-				char hex[response_size * 5];
+		if (fds[1].revents & POLLIN) {
+			log_debug("stopped");
 
-				log_debug("starting worker to handle event of size %ld: %s",
-				          response_size,
-				          bytes_to_hex(response_data, response_size, hex));
-#endif
+			return NULL;
+		}
 
-				pthread_attr_t attr;
+		if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			log_debug("receiver %s went away", receiver->devnode);
 
-				if ((errno = pthread_attr_init(&attr)) != 0) {
-					log_warning_errno(SLAVERY_ERROR_OS, "pthread_attr_init() failed");
+			return NULL;
+		}
 
-					return NULL;
-				}
+		if (fds[2].revents & POLLIN) {
+			slavery_timer_wheel_expire(&receiver->timers);
+		}
 
-				if ((errno = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED)) != 0) {
-					log_warning_errno(SLAVERY_ERROR_OS, "pthread_attr_setdetachstate() failed");
+		if (fds[0].revents & POLLIN && slavery_receiver_read_reports(receiver) < 0) {
+			return NULL;
+		}
+	}
+}
 
-					return NULL;
-				}
+static int slavery_receiver_write(slavery_receiver_t *receiver,
+                                  const uint8_t request_data[],
+                                  const size_t request_size,
+                                  const bool defer) {
+	slavery_receiver_capture(receiver, SLAVERY_CAPTURE_DIRECTION_OUT, request_data, request_size);
 
-				slavery_event_t *event = malloc(sizeof(slavery_event_t));
-				event->receiver = receiver;
-				event->size = response_size;
-				event->data = malloc(response_size);
-				memcpy(event->data, response_data, response_size);
+#ifdef SLAVERY_IO_URING
+	if (receiver->slavery->uring != NULL) {
+		return slavery_uring_write(receiver->slavery->uring, receiver, request_data, request_size, defer);
+	}
+#else
+	(void)defer;
+#endif
 
-				if ((errno = pthread_create(
-				         (pthread_t[]){0}, &attr, (pthread_callback_t)slavery_event_dispatch, event)) != 0) {
-					log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+	const slavery_transport_t *transport = receiver->transport;
 
-					free(event->data);
-					free(event);
+	ssize_t written = transport->write(transport, receiver->fd, request_data, request_size);
 
-					return NULL;
-				}
+	return written == (ssize_t)request_size ? 0 : -1;
+}
 
-				if ((errno = pthread_attr_destroy(&attr)) != 0) {
-					log_warning_errno(SLAVERY_ERROR_OS, "pthread_attr_destroy() failed");
+static int slavery_receiver_flush(slavery_receiver_t *receiver) {
+#ifdef SLAVERY_IO_URING
+	if (receiver->slavery->uring != NULL) {
+		return slavery_uring_flush(receiver->slavery->uring);
+	}
+#else
+	(void)receiver;
+#endif
 
-					free(event->data);
-					free(event);
+	return 0;
+}
 
-					return NULL;
-				}
+static slavery_request_t *slavery_receiver_request_queue(slavery_receiver_t *receiver,
+                                                         uint8_t request_data[],
+                                                         const size_t request_size,
+                                                         const bool defer,
+                                                         const bool block) {
+	const slavery_options_t *options = &receiver->slavery->options;
+	slavery_request_t *request;
+	struct timespec deadline;
 
-				break;
-			}
+	if (options->request_timeout_ms > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-			default: {
-#ifdef DEBUG
-				char hex[response_size * 5];
+		deadline.tv_sec += options->request_timeout_ms / 1000;
+		deadline.tv_nsec += (options->request_timeout_ms % 1000) * 1000000L;
 
-				log_debug("redirecting control event of size %ld: %s",
-				          response_size,
-				          bytes_to_hex(response_data, response_size, hex));
-#endif
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
 
-				slavery_receiver_control_write_response(receiver, response_data, response_size);
-			}
+	if ((request = slavery_request_table_submit(&receiver->requests,
+	                                            request_data,
+	                                            options->request_timeout_ms > 0 ? &deadline : NULL,
+	                                            block)) == NULL) {
+		if (errno == ETIMEDOUT) {
+			log_warning(SLAVERY_ERROR_TIMEOUT,
+			            "no request slot for %s:%u after %ums",
+			            receiver->devnode,
+			            request_data[1],
+			            options->request_timeout_ms);
 		}
+
+		return NULL;
 	}
 
-	return NULL;
+	if (slavery_receiver_write(receiver, request_data, request_size, defer) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to write request");
+
+		slavery_request_table_cancel(&receiver->requests, request);
+
+		return NULL;
+	}
+
+	return request;
 }
 
-// FIXME add flow control.
-int slavery_receiver_control_read_response(slavery_receiver_t *receiver,
-                                           uint8_t response_data[],
-                                           ssize_t response_size) {
-	if (read(receiver->control_pipe[0], response_data, response_size) < 0) {
-		log_warning(SLAVERY_ERROR_IO, "failed to read control event response");
+slavery_request_t *slavery_receiver_request_submit(slavery_receiver_t *receiver,
+                                                   uint8_t request_data[],
+                                                   const size_t request_size) {
+	return slavery_receiver_request_queue(receiver, request_data, request_size, false, true);
+}
+
+int slavery_receiver_request_wait(slavery_receiver_t *receiver,
+                                  slavery_request_t *request,
+                                  uint8_t response_data[]) {
+	const slavery_options_t *options = &receiver->slavery->options;
+	uint8_t device_index = request->device_index;
+
+	if (slavery_request_table_wait(&receiver->requests, request, response_data) < 0) {
+		log_warning(SLAVERY_ERROR_TIMEOUT,
+		            "no response from %s:%u after %ums",
+		            receiver->devnode,
+		            device_index,
+		            options->request_timeout_ms);
+
+		errno = ETIMEDOUT;
 
 		return -1;
 	}
 
-	if (response_data[2] == SLAVERY_FEATURE_INDEX_ERROR) {
-		if (response_data[5] == SLAVERY_HIDPP_ERROR_RESOURCE) {
+	if (response_data[2] == SLAVERY_FEATURE_INDEX_ERROR ||
+	    response_data[2] == SLAVERY_FEATURE_INDEX_ERROR_HIDPP20) {
+		slavery_request_table_count_error(&receiver->requests, device_index);
+
+		if (response_data[5] == SLAVERY_HIDPP_ERROR_BUSY) {
+			log_debug("device %s:%u is busy", receiver->devnode, device_index);
+
+			errno = EBUSY;
+		} else if (response_data[5] == SLAVERY_HIDPP_ERROR_RESOURCE ||
+		           response_data[5] == SLAVERY_HIDPP_ERROR_UNKNOWN_DEVICE) {
 			log_debug("received resource error, device likely doesn't exist");
+
+			errno = ENODEV;
 		} else {
-			log_warning(SLAVERY_ERROR_IO, "received error code");
+			log_warning(SLAVERY_ERROR_HIDPP,
+			            "received error code %s",
+			            slavery_hidpp_error_to_string(response_data[5]));
+
+			errno = EIO;
 		}
 
 		return -1;
 	}
 
-#ifdef DEBUG
-	char hex[SLAVERY_PACKET_LENGTH_CONTROL_LONG * 5];
+	if (log_enabled(LOG_LEVEL_DEBUG)) {
+		char hex[SLAVERY_PACKET_LENGTH_CONTROL_LONG * 5];
 
-	log_debug("received control event of size %u: %s",
-	          SLAVERY_PACKET_LENGTH_CONTROL_LONG,
-	          bytes_to_hex(response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG, hex));
-#endif
+		log_debug("received control event of size %u: %s",
+		          SLAVERY_PACKET_LENGTH_CONTROL_LONG,
+		          bytes_to_hex(response_data, SLAVERY_PACKET_LENGTH_CONTROL_LONG, hex));
+	}
 
 	return 0;
 }
 
-// FIXME add flow control.
-int slavery_receiver_control_write_response(slavery_receiver_t *receiver,
-                                            uint8_t response_data[],
-                                            ssize_t response_size) {
-	if (write(receiver->control_pipe[1], response_data, response_size) < 0) {
-		log_warning_errno(SLAVERY_ERROR_IO, "failed to write control event response");
+int slavery_receiver_request(slavery_receiver_t *receiver,
+                             uint8_t request_data[],
+                             const size_t request_size,
+                             uint8_t response_data[]) {
+	const slavery_options_t *options = &receiver->slavery->options;
+	unsigned int backoff_ms = options->request_backoff_ms;
 
-		return -1;
+	for (unsigned int attempt = 0;; attempt++) {
+		slavery_request_t *request = slavery_receiver_request_submit(receiver, request_data, request_size);
+
+		if (request == NULL) {
+			return -1;
+		}
+
+		if (slavery_receiver_request_wait(receiver, request, response_data) == 0) {
+			return 0;
+		}
+
+		if (errno != EBUSY || attempt >= options->request_retries) {
+			return -1;
+		}
+
+		log_debug("retrying request to %s:%u in %ums", receiver->devnode, request_data[1], backoff_ms);
+
+		slavery_request_table_count_retry(&receiver->requests, request_data[1]);
+
+		nanosleep(&(struct timespec){.tv_sec = backoff_ms / 1000, .tv_nsec = (backoff_ms % 1000) * 1000000L},
+		          NULL);
+
+		backoff_ms *= 2;
 	}
+}
 
-	return 0;
+int slavery_receiver_request_batch(slavery_receiver_t *receiver,
+                                   const size_t num_requests,
+                                   uint8_t request_data[][SLAVERY_PACKET_LENGTH_CONTROL_LONG],
+                                   const size_t request_size,
+                                   uint8_t response_data[][SLAVERY_PACKET_LENGTH_CONTROL_LONG]) {
+	slavery_request_t *requests[SLAVERY_SOFTWARE_ID_COUNT];
+	size_t busy[num_requests > 0 ? num_requests : 1];
+	size_t num_busy = 0;
+	size_t num_submitted = 0;
+	size_t num_completed = 0;
+	int result = 0;
+
+	// Keep as many requests in flight as there are software IDs, waiting on them in submission order. Each
+	// refill of the window is written in one submission where the backend supports it.
+	while (num_completed < num_requests) {
+		while (result == 0 && num_submitted < num_requests &&
+		       num_submitted - num_completed < SLAVERY_SOFTWARE_ID_COUNT) {
+			// Requests are only released by collecting them, so waiting for a slot while holding some could
+			// wait on every other batch doing the same. The window only grows while there's room, and the
+			// oldest request is collected otherwise.
+			slavery_request_t *request = slavery_receiver_request_queue(
+			    receiver, request_data[num_submitted], request_size, true, num_submitted == num_completed);
+
+			if (request == NULL) {
+				if (errno != EAGAIN) {
+					result = -1;
+				}
+
+				break;
+			}
+
+			requests[num_submitted++ % SLAVERY_SOFTWARE_ID_COUNT] = request;
+		}
+
+		if (slavery_receiver_flush(receiver) < 0) {
+			result = -1;
+		}
+
+		if (num_completed == num_submitted) {
+			break;
+		}
+
+		if (slavery_receiver_request_wait(
+		        receiver, requests[num_completed % SLAVERY_SOFTWARE_ID_COUNT], response_data[num_completed]) <
+		    0) {
+			// A device that has stopped answering would only time the rest out one after another.
+			if (errno == ETIMEDOUT) {
+				while (++num_completed < num_submitted) {
+					slavery_request_table_cancel(&receiver->requests,
+					                             requests[num_completed % SLAVERY_SOFTWARE_ID_COUNT]);
+				}
+
+				return -1;
+			}
+
+			if (errno == EBUSY) {
+				busy[num_busy++] = num_completed;
+			} else {
+				result = -1;
+			}
+		}
+
+		num_completed++;
+	}
+
+	// A busy device gets its requests again one at a time, with backoff, once the window has drained, so
+	// retrying never waits for a slot while holding others.
+	for (size_t i = 0; i < num_busy && result == 0; i++) {
+		size_t index = busy[i];
+
+		if (slavery_receiver_request(receiver, request_data[index], request_size, response_data[index]) < 0) {
+			result = -1;
+		}
+	}
+
+	return result;
 }
@@ -10,40 +10,75 @@
 
 #pragma once
 
+#include "device.h"
 #include "libslavery_p.h"
+#include "reactor.h"
+#include "report.h"
+#include "request.h"
+#include "timer.h"
+#include "uring.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <sys/types.h>
 
 typedef struct slavery_device_t slavery_device_t;
+typedef struct slavery_t slavery_t;
 
 /**
  * @brief Describes a unifying receiver.
  */
 typedef struct slavery_receiver_t {
+	slavery_t *slavery;
+	const slavery_transport_t *transport;
 	char *devnode;
+	uint16_t minor;
 	uint16_t vendor_id;
 	uint16_t product_id;
 	char *name;
 	char *address;
 	size_t num_devices;
 	slavery_device_t **devices;
+	_Atomic(slavery_device_t *) device_slots[SLAVERY_DEVICE_INDEX_6 + 1];
 	pthread_t listener_thread;
+	int stop_fd;
+	slavery_reactor_handler_t handler;
+	slavery_reactor_handler_t timer_handler;
+	atomic_bool listening;
+	uint32_t uring_index;
 	int fd;
-	int control_pipe[2];
+	slavery_request_table_t requests;
+	atomic_size_t pending_events;
+	slavery_timer_wheel_t timers;
+	slavery_replay_t *replay;
 } slavery_receiver_t;
 
 void slavery_receiver_array_free(slavery_receiver_t *receivers[], const ssize_t num_receivers);
 int slavery_receiver_free(slavery_receiver_t *receiver);
 ssize_t slavery_receiver_scan_devices(slavery_receiver_t *receiver);
 slavery_device_t *slavery_receiver_get_device(slavery_receiver_t *receiver, const uint8_t device_index);
-slavery_receiver_t *slavery_receiver_from_devnode(const char *devnode);
-int slavery_receiver_get_report_descriptor(slavery_receiver_t *receiver);
+slavery_device_t *slavery_receiver_get_device_slot(slavery_receiver_t *receiver, const uint8_t device_index);
+slavery_receiver_t *slavery_receiver_from_devnode(slavery_t *slavery, const char *devnode);
+slavery_receiver_t *slavery_receiver_from_fd(slavery_t *slavery, const int fd, const char *name);
+void slavery_receiver_handle_report(slavery_receiver_t *receiver, slavery_report_t *report);
+void slavery_receiver_handle_scratch(slavery_receiver_t *receiver, const uint8_t data[], const size_t size);
+ssize_t slavery_receiver_read_reports(slavery_receiver_t *receiver);
+void slavery_receiver_on_readable(void *data, const uint32_t events);
+void slavery_receiver_on_timer(void *data, const uint32_t events);
 void *slavery_receiver_listen(slavery_receiver_t *receiver);
-int slavery_receiver_control_read_response(slavery_receiver_t *receiver,
-                                           uint8_t response_data[],
-                                           ssize_t response_size);
-int slavery_receiver_control_write_response(slavery_receiver_t *receiver,
-                                            uint8_t response_data[],
-                                            ssize_t response_size);
+slavery_request_t *slavery_receiver_request_submit(slavery_receiver_t *receiver,
+                                                   uint8_t request_data[],
+                                                   const size_t request_size);
+int slavery_receiver_request_wait(slavery_receiver_t *receiver,
+                                  slavery_request_t *request,
+                                  uint8_t response_data[]);
+int slavery_receiver_request(slavery_receiver_t *receiver,
+                             uint8_t request_data[],
+                             const size_t request_size,
+                             uint8_t response_data[]);
+int slavery_receiver_request_batch(slavery_receiver_t *receiver,
+                                   const size_t num_requests,
+                                   uint8_t request_data[][SLAVERY_PACKET_LENGTH_CONTROL_LONG],
+                                   const size_t request_size,
+                                   uint8_t response_data[][SLAVERY_PACKET_LENGTH_CONTROL_LONG]);
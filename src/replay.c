@@ -0,0 +1,758 @@
+/**
+ * @file
+ * @brief HID++ trace replay implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "replay.h"
+
+#include "capture.h"
+#include "feature.h"
+#include "receiver.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief An interface described by the trace, which its packets refer to by index.
+ */
+typedef struct slavery_replay_interface_t {
+	uint16_t link_type;
+	uint8_t resolution;
+} slavery_replay_interface_t;
+
+static uint64_t slavery_replay_time_ns(const uint64_t timestamp, const uint8_t resolution) {
+	uint8_t exponent = resolution & 0x7f;
+	uint64_t time_ns = timestamp;
+
+	// The high bit makes the resolution a negative power of 2 rather than of 10.
+	if (resolution & 0x80) {
+		if (exponent >= 64) {
+			return 0;
+		}
+
+		uint64_t fraction = timestamp & ((UINT64_C(1) << exponent) - 1);
+
+		return (timestamp >> exponent) * 1000000000 +
+		       (uint64_t)((double)fraction / (double)(UINT64_C(1) << exponent) * 1e9);
+	}
+
+	for (uint8_t i = exponent; i < 9; i++) {
+		time_ns *= 10;
+	}
+
+	for (uint8_t i = 9; i < exponent; i++) {
+		time_ns /= 10;
+	}
+
+	return time_ns;
+}
+
+static uint8_t slavery_replay_interface_resolution(const uint8_t options[], const size_t size) {
+	size_t offset = 0;
+
+	while (offset + 4 <= size) {
+		uint16_t code;
+		uint16_t length;
+
+		memcpy(&code, options + offset, sizeof(code));
+		memcpy(&length, options + offset + 2, sizeof(length));
+
+		if (code == SLAVERY_CAPTURE_OPTION_END || offset + 4 + length > size) {
+			break;
+		}
+
+		if (code == SLAVERY_CAPTURE_OPTION_IF_TSRESOL && length == 1) {
+			return options[offset + 4];
+		}
+
+		offset += 4 + ((length + 3) & ~3);
+	}
+
+	// Without the option, timestamps are in microseconds.
+	return 6;
+}
+
+static bool slavery_replay_parse_packet(const uint8_t body[],
+                                        const size_t size,
+                                        const slavery_replay_interface_t interfaces[],
+                                        const size_t num_interfaces,
+                                        slavery_replay_packet_t *packet,
+                                        uint16_t *bus) {
+	slavery_capture_usbmon_header_t header;
+	uint32_t fields[5];
+
+	if (size < sizeof(fields) + sizeof(header)) {
+		return false;
+	}
+
+	memcpy(fields, body, sizeof(fields));
+
+	if (fields[0] >= num_interfaces ||
+	    interfaces[fields[0]].link_type != SLAVERY_CAPTURE_LINKTYPE_USB_LINUX_MMAPPED ||
+	    fields[3] < sizeof(header) || fields[3] > size - sizeof(fields)) {
+		return false;
+	}
+
+	memcpy(&header, body + sizeof(fields), sizeof(header));
+
+	size_t length = fields[3] - sizeof(header);
+
+	if (header.captured_length < length) {
+		length = header.captured_length;
+	}
+
+	if (length < 1 || length > SLAVERY_PACKET_LENGTH_MAX) {
+		return false;
+	}
+
+	// Reports read are completions on the IN endpoint. Those written are submissions, on the OUT endpoint or,
+	// as usbmon sees writes to a receiver without one, as SET_REPORT control transfers.
+	if (header.type == 'C' && header.transfer_type == SLAVERY_CAPTURE_USB_TRANSFER_INTERRUPT &&
+	    header.endpoint & 0x80) {
+		packet->direction = SLAVERY_CAPTURE_DIRECTION_IN;
+	} else if (header.type == 'S' && ((header.transfer_type == SLAVERY_CAPTURE_USB_TRANSFER_INTERRUPT &&
+	                                   !(header.endpoint & 0x80)) ||
+	                                  (header.transfer_type == SLAVERY_CAPTURE_USB_TRANSFER_CONTROL &&
+	                                   header.setup_flag == 0 && header.setup[0] == 0x21 &&
+	                                   header.setup[1] == 0x09))) {
+		packet->direction = SLAVERY_CAPTURE_DIRECTION_OUT;
+	} else {
+		return false;
+	}
+
+	packet->data = body + sizeof(fields) + sizeof(header);
+	packet->size = length;
+
+	if (packet->data[0] != SLAVERY_REPORT_ID_CONTROL_SHORT &&
+	    packet->data[0] != SLAVERY_REPORT_ID_CONTROL_LONG && packet->data[0] != SLAVERY_REPORT_ID_EVENT) {
+		return false;
+	}
+
+	packet->time_ns =
+	    slavery_replay_time_ns((uint64_t)fields[1] << 32 | fields[2], interfaces[fields[0]].resolution);
+	packet->response = false;
+	packet->used = false;
+	packet->response_index = SIZE_MAX;
+	*bus = header.bus;
+
+	return true;
+}
+
+static int slavery_replay_parse(slavery_replay_t *replay) {
+	slavery_replay_interface_t interfaces[SLAVERY_REPLAY_MAX_INTERFACES];
+	const uint8_t *data = replay->map;
+	size_t num_interfaces = 0;
+	size_t capacity = 0;
+	size_t offset = 0;
+	size_t skipped = 0;
+	bool have_bus = false;
+	uint16_t replay_bus = 0;
+
+	while (offset + 12 <= replay->map_size) {
+		uint32_t type;
+		uint32_t length;
+
+		memcpy(&type, data + offset, sizeof(type));
+		memcpy(&length, data + offset + 4, sizeof(length));
+
+		// A capture cut short by a crash is still worth replaying up to where it ends.
+		if (length < 12 || length % 4 != 0 || length > replay->map_size - offset) {
+			log_warning(SLAVERY_ERROR_IO, "trace is truncated at offset %zu, ignoring the rest", offset);
+
+			break;
+		}
+
+		const uint8_t *body = data + offset + 8;
+		size_t size = length - 12;
+
+		if (type == SLAVERY_CAPTURE_BLOCK_SHB) {
+			uint32_t magic;
+
+			if (size < 16) {
+				log_warning(SLAVERY_ERROR_IO, "trace section header is too short");
+
+				return -1;
+			}
+
+			memcpy(&magic, body, sizeof(magic));
+
+			if (magic != SLAVERY_CAPTURE_BYTE_ORDER_MAGIC) {
+				log_warning(SLAVERY_ERROR_IO, "trace section isn't in this machine's byte order");
+
+				return -1;
+			}
+
+			// Interface numbers start again in every section.
+			num_interfaces = 0;
+		} else if (type == SLAVERY_CAPTURE_BLOCK_IDB && size >= 8) {
+			if (num_interfaces < SLAVERY_REPLAY_MAX_INTERFACES) {
+				memcpy(&interfaces[num_interfaces].link_type, body, sizeof(uint16_t));
+				interfaces[num_interfaces].resolution =
+				    slavery_replay_interface_resolution(body + 8, size - 8);
+			}
+
+			num_interfaces++;
+		} else if (type == SLAVERY_CAPTURE_BLOCK_EPB) {
+			slavery_replay_packet_t packet;
+			uint16_t bus;
+
+			if (!slavery_replay_parse_packet(body,
+			                                 size,
+			                                 interfaces,
+			                                 num_interfaces < SLAVERY_REPLAY_MAX_INTERFACES
+			                                     ? num_interfaces
+			                                     : SLAVERY_REPLAY_MAX_INTERFACES,
+			                                 &packet,
+			                                 &bus)) {
+				skipped++;
+			} else if (have_bus && bus != replay_bus) {
+				skipped++;
+			} else {
+				if (replay->num_packets == capacity) {
+					capacity = capacity > 0 ? capacity * 2 : 1024;
+					replay->packets = realloc(replay->packets, capacity * sizeof(slavery_replay_packet_t));
+				}
+
+				replay->packets[replay->num_packets++] = packet;
+				replay_bus = bus;
+				have_bus = true;
+			}
+		}
+
+		offset += length;
+	}
+
+	log_debug(
+	    "loaded %zu reports from bus %u, skipped %zu packets", replay->num_packets, replay_bus, skipped);
+
+	return replay->num_packets > 0 ? 0 : -1;
+}
+
+static bool slavery_replay_is_response(const uint8_t request[], const uint8_t response[], const size_t size) {
+	if (size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT || response[0] == SLAVERY_REPORT_ID_EVENT ||
+	    response[1] != request[1]) {
+		return false;
+	}
+
+	// Error reports shift the original feature index and function along by one byte.
+	if (response[2] == SLAVERY_FEATURE_INDEX_ERROR || response[2] == SLAVERY_FEATURE_INDEX_ERROR_HIDPP20) {
+		return response[3] == request[2] && response[4] == request[3];
+	}
+
+	return response[2] == request[2] && response[3] == request[3];
+}
+
+static void slavery_replay_pair(slavery_replay_t *replay) {
+	replay->requests = malloc((replay->num_packets + 1) * sizeof(size_t));
+
+	// Pair each request with the first report after it that answers it, software ID and all. Those reports
+	// are sent when the library makes the same request, and every other report read is an event.
+	for (size_t i = 0; i < replay->num_packets; i++) {
+		slavery_replay_packet_t *request = &replay->packets[i];
+
+		if (request->direction != SLAVERY_CAPTURE_DIRECTION_OUT ||
+		    request->size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+			continue;
+		}
+
+		for (size_t j = i + 1; j < replay->num_packets && j <= i + SLAVERY_REPLAY_RESPONSE_WINDOW; j++) {
+			slavery_replay_packet_t *response = &replay->packets[j];
+
+			if (response->direction == SLAVERY_CAPTURE_DIRECTION_IN && !response->response &&
+			    slavery_replay_is_response(request->data, response->data, response->size)) {
+				response->response = true;
+				request->response_index = j;
+				replay->requests[replay->num_requests++] = i;
+
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < replay->num_packets; i++) {
+		if (replay->packets[i].direction == SLAVERY_CAPTURE_DIRECTION_IN && !replay->packets[i].response) {
+			replay->num_events++;
+		}
+	}
+
+	log_debug("trace has %zu answered requests and %zu events", replay->num_requests, replay->num_events);
+}
+
+static bool slavery_replay_request_matches(const slavery_replay_packet_t *packet,
+                                           const uint8_t request[],
+                                           const size_t size) {
+	// Software IDs are handed out afresh, so they needn't match the ones recorded.
+	return packet->size == size && memcmp(packet->data, request, 3) == 0 &&
+	       (packet->data[3] & 0xf0) == (request[3] & 0xf0) &&
+	       memcmp(packet->data + 4, request + 4, size - 4) == 0;
+}
+
+static const slavery_replay_packet_t *slavery_replay_find_response(slavery_replay_t *replay,
+                                                                  const uint8_t request[],
+                                                                  const size_t size) {
+	const slavery_replay_packet_t *fallback = NULL;
+
+	// Requests usually come in the order they were recorded, so the search starts after the last one
+	// answered. Requests made more than once are answered in turn, then with the last recorded answer.
+	for (size_t n = 0; n < replay->num_requests; n++) {
+		size_t i = (replay->next_request + n) % replay->num_requests;
+		slavery_replay_packet_t *packet = &replay->packets[replay->requests[i]];
+
+		if (!slavery_replay_request_matches(packet, request, size)) {
+			continue;
+		}
+
+		if (!packet->used) {
+			packet->used = true;
+			replay->next_request = (i + 1) % replay->num_requests;
+
+			return &replay->packets[packet->response_index];
+		}
+
+		if (fallback == NULL) {
+			fallback = &replay->packets[packet->response_index];
+		}
+	}
+
+	return fallback;
+}
+
+static void slavery_replay_send(slavery_replay_t *replay,
+                                const uint8_t data[],
+                                const size_t size,
+                                const bool event) {
+	size_t index = replay->num_sent - replay->base;
+
+	if (index < replay->num_samples) {
+		replay->samples[index] = (slavery_replay_sample_t){.event = event, .sent_ns = time_monotonic_ns()};
+	}
+
+	if (send(replay->fd, data, size, MSG_NOSIGNAL) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "send() failed");
+
+		return;
+	}
+
+	// Only reports actually sent are numbered, so the receiver's count of reads keeps up.
+	replay->num_sent++;
+}
+
+static void slavery_replay_answer(slavery_replay_t *replay) {
+	uint8_t request[SLAVERY_PACKET_LENGTH_MAX];
+	ssize_t size;
+
+	while ((size = recv(replay->fd, request, sizeof(request), MSG_DONTWAIT)) > 0) {
+		if (size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+			continue;
+		}
+
+		const slavery_replay_packet_t *response = slavery_replay_find_response(replay, request, size);
+		uint8_t data[SLAVERY_PACKET_LENGTH_MAX] = {0};
+
+		if (response != NULL) {
+			size_t function = response->data[2] == SLAVERY_FEATURE_INDEX_ERROR ||
+			                          response->data[2] == SLAVERY_FEATURE_INDEX_ERROR_HIDPP20
+			                      ? 4
+			                      : 3;
+
+			memcpy(data, response->data, response->size);
+			data[function] = (data[function] & 0xf0) | (request[3] & 0x0f);
+			replay->answered++;
+
+			slavery_replay_send(replay, data, response->size, false);
+
+			continue;
+		}
+
+		// Anything never asked of the recorded devices gets the answer a receiver gives for an empty slot.
+		data[0] = SLAVERY_REPORT_ID_CONTROL_SHORT;
+		data[1] = request[1];
+		data[2] = SLAVERY_FEATURE_INDEX_ERROR;
+		data[3] = request[2];
+		data[4] = request[3];
+		data[5] = SLAVERY_HIDPP_ERROR_UNKNOWN_DEVICE;
+		replay->refused++;
+
+		log_debug(
+		    "no recorded response for request to %u:%02x:%02x", request[1], request[2], request[3] >> 4);
+
+		slavery_replay_send(replay, data, SLAVERY_PACKET_LENGTH_CONTROL_SHORT, false);
+	}
+}
+
+static void *slavery_replay_respond(slavery_replay_t *replay) {
+	struct pollfd fds[] = {{.fd = replay->fd, .events = POLLIN}, {.fd = replay->stop_fd, .events = POLLIN}};
+
+	if ((errno = pthread_setname_np(pthread_self(), "replay")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	while (true) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "poll()");
+
+			break;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			slavery_replay_answer(replay);
+		}
+	}
+
+	return NULL;
+}
+
+static void slavery_replay_wait(slavery_replay_t *replay, const uint64_t until_ns) {
+	struct pollfd pollfd = {.fd = replay->fd, .events = POLLIN};
+	uint64_t now_ns;
+
+	// Requests made in the meantime are answered while waiting, as a device would.
+	while ((now_ns = time_monotonic_ns()) < until_ns) {
+		struct timespec timeout = {.tv_sec = (until_ns - now_ns) / 1000000000,
+		                           .tv_nsec = (until_ns - now_ns) % 1000000000};
+
+		if (ppoll(&pollfd, 1, &timeout, NULL) > 0) {
+			slavery_replay_answer(replay);
+		}
+	}
+}
+
+slavery_replay_t *slavery_replay_new(const char *path,
+                                     const slavery_options_t *options,
+                                     const char *config_path) {
+	slavery_replay_t *replay = calloc(1, sizeof(slavery_replay_t));
+	slavery_options_t replay_options;
+	struct stat trace_stat;
+	int fds[2];
+	int fd;
+
+	replay->fd = -1;
+	replay->stop_fd = -1;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to open trace %s", path);
+
+		free(replay);
+
+		return NULL;
+	}
+
+	if (fstat(fd, &trace_stat) < 0 || trace_stat.st_size == 0 ||
+	    (replay->map = mmap(NULL, trace_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to map trace %s", path);
+
+		close(fd);
+		free(replay);
+
+		return NULL;
+	}
+
+	close(fd);
+
+	replay->map_size = trace_stat.st_size;
+	madvise(replay->map, replay->map_size, MADV_SEQUENTIAL);
+
+	if (slavery_replay_parse(replay) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "no HID++ reports found in trace %s", path);
+
+		munmap(replay->map, replay->map_size);
+		free(replay->packets);
+		free(replay);
+
+		return NULL;
+	}
+
+	slavery_replay_pair(replay);
+
+	// Samples are kept for every event and whatever requests are answered during a run, so recording them
+	// never allocates.
+	replay->num_samples = replay->num_events + SLAVERY_REPLAY_EXTRA_SAMPLES;
+	replay->samples = calloc(replay->num_samples, sizeof(slavery_replay_sample_t));
+	atomic_init(&replay->dispatched, 0);
+
+	// The receiver's end is non-blocking, like a hidraw node. Each message is one report, both ways.
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "socketpair() failed");
+
+		slavery_replay_free(replay);
+
+		return NULL;
+	}
+
+	replay->fd = fds[0];
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+	// Devices the replay makes up must never end up in the user's cache.
+	if (options == NULL) {
+		slavery_options_init(&replay_options);
+	} else {
+		replay_options = *options;
+	}
+
+	replay_options.cache = false;
+
+	if ((replay->slavery = slavery_new_with_options(&replay_options)) == NULL) {
+		close(fds[1]);
+		slavery_replay_free(replay);
+
+		return NULL;
+	}
+
+	if ((replay->receiver = slavery_receiver_from_fd(replay->slavery, fds[1], path)) == NULL) {
+		close(fds[1]);
+		slavery_replay_free(replay);
+
+		return NULL;
+	}
+
+	replay->receiver->replay = replay;
+	slavery_add_receiver(replay->slavery, replay->receiver);
+
+	if ((replay->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		slavery_replay_free(replay);
+
+		return NULL;
+	}
+
+	if ((errno = pthread_create(
+	         &replay->thread, NULL, (pthread_callback_t)slavery_replay_respond, replay)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		slavery_replay_free(replay);
+
+		return NULL;
+	}
+
+	// Discovery and the config's diversion requests are all answered by the responder thread. Once it has
+	// stopped, nothing else is sent until a run starts.
+	if (slavery_receiver_scan_devices(replay->receiver) <= 0) {
+		log_warning(SLAVERY_ERROR_UNKNOWN, "no devices found in trace %s", path);
+	}
+
+	if (config_path != NULL) {
+		slavery_config_t *config = slavery_config_new(config_path);
+
+		if (config != NULL) {
+			slavery_set_config(replay->slavery, config);
+		}
+	}
+
+	eventfd_write(replay->stop_fd, 1);
+	pthread_join(replay->thread, NULL);
+
+	return replay;
+}
+
+static int slavery_replay_compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void slavery_replay_percentiles(uint64_t values[],
+                                       const size_t num_values,
+                                       slavery_replay_latency_t *latency) {
+	if (num_values == 0) {
+		*latency = (slavery_replay_latency_t){0};
+
+		return;
+	}
+
+	qsort(values, num_values, sizeof(uint64_t), slavery_replay_compare);
+
+	latency->p50_ns = values[(num_values - 1) * 500 / 1000];
+	latency->p90_ns = values[(num_values - 1) * 900 / 1000];
+	latency->p99_ns = values[(num_values - 1) * 990 / 1000];
+	latency->p999_ns = values[(num_values - 1) * 999 / 1000];
+	latency->max_ns = values[num_values - 1];
+}
+
+int slavery_replay_run(slavery_replay_t *replay, const bool fast) {
+	uint64_t first_ns = 0;
+
+	if (replay->num_events == 0) {
+		return -1;
+	}
+
+	// Samples are numbered from the first report this run sends, as anything earlier is long dispatched.
+	replay->base = replay->num_sent;
+	replay->num_fed = 0;
+	replay->answered = 0;
+	replay->refused = 0;
+	atomic_store(&replay->dispatched, 0);
+	memset(replay->samples, 0, replay->num_samples * sizeof(slavery_replay_sample_t));
+
+	replay->start_ns = time_monotonic_ns();
+
+	for (size_t i = 0; i < replay->num_packets; i++) {
+		const slavery_replay_packet_t *packet = &replay->packets[i];
+
+		if (packet->direction != SLAVERY_CAPTURE_DIRECTION_IN || packet->response) {
+			continue;
+		}
+
+		if (replay->num_fed == 0) {
+			first_ns = packet->time_ns;
+		}
+
+		// Flat out, requests are only looked for every so often, keeping the feed to a system call an event.
+		if (!fast) {
+			slavery_replay_wait(replay, replay->start_ns + (packet->time_ns - first_ns));
+		} else if (replay->num_fed % 64 == 0) {
+			slavery_replay_answer(replay);
+		}
+
+		slavery_replay_send(replay, packet->data, packet->size, true);
+		replay->num_fed++;
+	}
+
+	// Events dropped on the way are never dispatched, so waiting ends once they stop coming.
+	size_t dispatched;
+	size_t last_dispatched = 0;
+	uint64_t progress_ns = time_monotonic_ns();
+
+	while ((dispatched = atomic_load_explicit(&replay->dispatched, memory_order_acquire)) < replay->num_fed) {
+		uint64_t now_ns = time_monotonic_ns();
+
+		if (dispatched != last_dispatched) {
+			last_dispatched = dispatched;
+			progress_ns = now_ns;
+		} else if (now_ns - progress_ns > SLAVERY_REPLAY_DRAIN_MS * 1000000ULL) {
+			break;
+		}
+
+		slavery_replay_wait(replay, now_ns + 1000000);
+	}
+
+	return 0;
+}
+
+void slavery_replay_get_stats(slavery_replay_t *replay, slavery_replay_stats_t *stats) {
+	size_t num_samples = replay->num_sent - replay->base;
+	uint64_t last_ns = replay->start_ns;
+	uint64_t *values[4];
+	size_t num_values = 0;
+
+	if (num_samples > replay->num_samples) {
+		num_samples = replay->num_samples;
+	}
+
+	*stats = (slavery_replay_stats_t){0};
+	stats->events = replay->num_fed;
+	stats->dispatched = atomic_load_explicit(&replay->dispatched, memory_order_acquire);
+	stats->answered = replay->answered;
+	stats->refused = replay->refused;
+
+	for (size_t i = 0; i < 4; i++) {
+		values[i] = malloc((num_samples + 1) * sizeof(uint64_t));
+	}
+
+	for (size_t i = 0; i < num_samples; i++) {
+		const slavery_replay_sample_t *sample = &replay->samples[i];
+
+		if (!sample->event || sample->dispatched_ns == 0) {
+			continue;
+		}
+
+		values[0][num_values] = sample->read_ns - sample->sent_ns;
+		values[1][num_values] = sample->dequeued_ns - sample->read_ns;
+		values[2][num_values] = sample->dispatched_ns - sample->dequeued_ns;
+		values[3][num_values] = sample->dispatched_ns - sample->sent_ns;
+		num_values++;
+
+		if (sample->dispatched_ns > last_ns) {
+			last_ns = sample->dispatched_ns;
+		}
+	}
+
+	stats->elapsed_ns = last_ns - replay->start_ns;
+
+	slavery_replay_percentiles(values[0], num_values, &stats->read);
+	slavery_replay_percentiles(values[1], num_values, &stats->queue);
+	slavery_replay_percentiles(values[2], num_values, &stats->dispatch);
+	slavery_replay_percentiles(values[3], num_values, &stats->total);
+
+	for (size_t i = 0; i < 4; i++) {
+		free(values[i]);
+	}
+}
+
+void slavery_replay_free(slavery_replay_t *replay) {
+	// The receiver is freed with the context, before its socket loses the other end.
+	if (replay->slavery != NULL) {
+		slavery_free(replay->slavery);
+	}
+
+	if (replay->stop_fd >= 0) {
+		close(replay->stop_fd);
+	}
+
+	if (replay->fd >= 0) {
+		close(replay->fd);
+	}
+
+	munmap(replay->map, replay->map_size);
+	free(replay->samples);
+	free(replay->requests);
+	free(replay->packets);
+	free(replay);
+}
+
+void slavery_replay_read(slavery_replay_t *replay, slavery_report_t *report) {
+	// Only the receiver's reader calls this, so the count needs no atomics.
+	size_t sequence = replay->num_read++;
+
+	if (report != NULL) {
+		report->sequence = sequence;
+		report->read_ns = time_monotonic_ns();
+	}
+}
+
+void slavery_replay_observe(slavery_replay_t *replay,
+                            const slavery_report_t *report,
+                            const uint64_t dequeued_ns) {
+	size_t index = report->sequence - replay->base;
+
+	if (report->read_ns == 0 || index >= replay->num_samples) {
+		return;
+	}
+
+	slavery_replay_sample_t *sample = &replay->samples[index];
+
+	if (!sample->event) {
+		return;
+	}
+
+	sample->read_ns = report->read_ns;
+	sample->dequeued_ns = dequeued_ns;
+	sample->dispatched_ns = time_monotonic_ns();
+
+	atomic_fetch_add_explicit(&replay->dispatched, 1, memory_order_release);
+}
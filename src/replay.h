@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @brief HID++ trace replay functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "libslavery.h"
+#include "report.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Interfaces a trace can describe before later ones are ignored.
+ */
+#define SLAVERY_REPLAY_MAX_INTERFACES 16
+
+/**
+ * @brief Packets after a request searched for its response when loading a trace.
+ */
+#define SLAVERY_REPLAY_RESPONSE_WINDOW 256
+
+/**
+ * @brief Requests the library can make while a run is in progress, on top of the trace's events, before
+ * their latencies stop being recorded.
+ */
+#define SLAVERY_REPLAY_EXTRA_SAMPLES 1024
+
+/**
+ * @brief Milliseconds without an event finishing before the rest of a run's events are counted as dropped.
+ */
+#define SLAVERY_REPLAY_DRAIN_MS 1000
+
+/**
+ * @brief A HID++ report from the trace, pointing into the mapped file.
+ */
+typedef struct slavery_replay_packet_t {
+	uint64_t time_ns;
+	const uint8_t *data;
+	uint8_t size;
+	uint8_t direction;
+	bool response;
+	bool used;
+	size_t response_index;
+} slavery_replay_packet_t;
+
+/**
+ * @brief When one report sent by the replay reached each stage of the pipeline.
+ */
+typedef struct slavery_replay_sample_t {
+	bool event;
+	uint64_t sent_ns;
+	uint64_t read_ns;
+	uint64_t dequeued_ns;
+	uint64_t dispatched_ns;
+} slavery_replay_sample_t;
+
+/**
+ * @brief Replays a pcapng trace, such as one written with slavery_options_t::capture_path, through a receiver
+ * whose hidraw node is one end of a socket pair.
+ *
+ * The library's requests are answered with the responses recorded for the same requests, so devices are
+ * discovered as they were when the trace was made, and every other report read from the receiver is fed to
+ * it as an event. Everything from the listener on is the real pipeline. Each report sent is numbered, and as
+ * the receiver reads reports in the order they were sent, that number finds the report's sample again as it
+ * passes each stage.
+ */
+typedef struct slavery_replay_t {
+	slavery_t *slavery;
+	slavery_receiver_t *receiver;
+	int fd;
+	int stop_fd;
+	pthread_t thread;
+	void *map;
+	size_t map_size;
+	slavery_replay_packet_t *packets;
+	size_t num_packets;
+	size_t *requests;
+	size_t num_requests;
+	size_t next_request;
+	size_t num_events;
+	size_t num_fed;
+	uint64_t start_ns;
+	size_t answered;
+	size_t refused;
+	size_t num_sent;
+	size_t num_read;
+	size_t base;
+	slavery_replay_sample_t *samples;
+	size_t num_samples;
+	atomic_size_t dispatched;
+} slavery_replay_t;
+
+void slavery_replay_read(slavery_replay_t *replay, slavery_report_t *report);
+void slavery_replay_observe(slavery_replay_t *replay,
+                            const slavery_report_t *report,
+                            const uint64_t dequeued_ns);
@@ -0,0 +1,121 @@
+/**
+ * @file
+ * @brief Reference counted HID++ report slab implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#include "report.h"
+
+#include <stdlib.h>
+
+#define SLAVERY_REPORT_NONE UINT32_MAX
+
+static uint64_t slavery_report_pool_pack(const uint64_t tag, const uint32_t index) {
+	return tag << 32 | index;
+}
+
+static void slavery_report_pool_push(slavery_report_pool_t *pool, slavery_report_t *report) {
+	uint32_t index = report - pool->reports;
+	uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+
+	do {
+		atomic_store_explicit(&report->next, (uint32_t)head, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak_explicit(&pool->free_head,
+	                                                &head,
+	                                                slavery_report_pool_pack((head >> 32) + 1, index),
+	                                                memory_order_release,
+	                                                memory_order_relaxed));
+}
+
+slavery_report_pool_t *slavery_report_pool_new(const size_t num_reports) {
+	log_debug("creating report pool with %lu reports", num_reports);
+
+	slavery_report_pool_t *pool = malloc(sizeof(slavery_report_pool_t));
+
+	if ((pool->reports = calloc(num_reports, sizeof(slavery_report_t))) == NULL) {
+		log_warning_errno(SLAVERY_ERROR_OS, "failed to allocate reports");
+
+		free(pool);
+
+		return NULL;
+	}
+
+	pool->num_reports = num_reports;
+	atomic_init(&pool->free_head, slavery_report_pool_pack(0, SLAVERY_REPORT_NONE));
+	atomic_init(&pool->in_use, 0);
+	atomic_init(&pool->exhausted, 0);
+
+	for (size_t i = num_reports; i > 0; i--) {
+		slavery_report_t *report = &pool->reports[i - 1];
+
+		report->pool = pool;
+		atomic_init(&report->refs, 0);
+		atomic_init(&report->next, SLAVERY_REPORT_NONE);
+		slavery_report_pool_push(pool, report);
+	}
+
+	return pool;
+}
+
+void slavery_report_pool_free(slavery_report_pool_t *pool) {
+	log_debug("freeing report pool at %p", pool);
+
+	free(pool->reports);
+	free(pool);
+}
+
+slavery_report_t *slavery_report_acquire(slavery_report_pool_t *pool) {
+	uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+	slavery_report_t *report;
+	uint32_t next;
+
+	do {
+		if ((uint32_t)head == SLAVERY_REPORT_NONE) {
+			atomic_fetch_add_explicit(&pool->exhausted, 1, memory_order_relaxed);
+
+			return NULL;
+		}
+
+		report = &pool->reports[(uint32_t)head];
+		next = atomic_load_explicit(&report->next, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak_explicit(&pool->free_head,
+	                                                &head,
+	                                                slavery_report_pool_pack((head >> 32) + 1, next),
+	                                                memory_order_acquire,
+	                                                memory_order_acquire));
+
+	atomic_store_explicit(&report->refs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+	report->receiver = NULL;
+	report->size = 0;
+	report->read_ns = 0;
+
+	return report;
+}
+
+slavery_report_t *slavery_report_ref(slavery_report_t *report) {
+	atomic_fetch_add_explicit(&report->refs, 1, memory_order_relaxed);
+
+	return report;
+}
+
+void slavery_report_unref(slavery_report_t *report) {
+	// Release so every reader's accesses happen before the slot is handed out again.
+	if (atomic_fetch_sub_explicit(&report->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	atomic_fetch_sub_explicit(&report->pool->in_use, 1, memory_order_relaxed);
+	slavery_report_pool_push(report->pool, report);
+}
+
+void slavery_report_pool_get_stats(slavery_report_pool_t *pool, slavery_report_pool_stats_t *stats) {
+	stats->size = pool->num_reports;
+	stats->in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+	stats->exhausted = atomic_load_explicit(&pool->exhausted, memory_order_relaxed);
+}
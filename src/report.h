@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @brief Reference counted HID++ report slab functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "libslavery.h"
+#include "utils.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct slavery_receiver_t slavery_receiver_t;
+typedef struct slavery_report_pool_t slavery_report_pool_t;
+
+/**
+ * @brief A report slot, filled directly by read() and shared by reference between its readers.
+ *
+ * sequence and read_ns are only set for reports read from a replayed trace, read_ns being 0 otherwise.
+ */
+typedef struct slavery_report_t {
+	atomic_uint refs;
+	atomic_uint next;
+	slavery_report_pool_t *pool;
+	slavery_receiver_t *receiver;
+	ssize_t size;
+	size_t sequence;
+	uint64_t read_ns;
+	uint8_t data[SLAVERY_PACKET_LENGTH_MAX];
+} slavery_report_t;
+
+/**
+ * @brief Preallocated slab of report slots with a lock-free free list.
+ *
+ * The free list head packs a generation tag above the slot index, so a slot popped and pushed back between
+ * another thread's load and compare-exchange can't corrupt the list.
+ */
+typedef struct slavery_report_pool_t {
+	size_t num_reports;
+	slavery_report_t *reports;
+	_Alignas(64) atomic_uint_least64_t free_head;
+	atomic_size_t in_use;
+	atomic_size_t exhausted;
+} slavery_report_pool_t;
+
+slavery_report_pool_t *slavery_report_pool_new(const size_t num_reports);
+void slavery_report_pool_free(slavery_report_pool_t *pool);
+slavery_report_t *slavery_report_acquire(slavery_report_pool_t *pool);
+slavery_report_t *slavery_report_ref(slavery_report_t *report);
+void slavery_report_unref(slavery_report_t *report);
+void slavery_report_pool_get_stats(slavery_report_pool_t *pool, slavery_report_pool_stats_t *stats);
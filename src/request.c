@@ -0,0 +1,266 @@
+/**
+ * @file
+ * @brief Pending HID++ request table implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "request.h"
+
+#include "feature.h"
+
+#include <errno.h>
+#include <string.h>
+
+int slavery_request_table_init(slavery_request_table_t *table) {
+	pthread_condattr_t attr;
+
+	// Deadlines are measured on the monotonic clock so they aren't affected by wall clock changes.
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+	pthread_mutex_init(&table->mutex, NULL);
+	pthread_cond_init(&table->slot_freed, &attr);
+	atomic_init(&table->unsolicited, 0);
+
+	for (size_t i = 0; i < SLAVERY_REQUEST_TABLE_SIZE; i++) {
+		table->requests[i].in_use = false;
+		pthread_cond_init(&table->requests[i].cond, &attr);
+	}
+
+	for (size_t i = 0; i <= UINT8_MAX; i++) {
+		table->software_ids[i] = 0;
+		table->next_software_id[i] = SLAVERY_SOFTWARE_ID_MIN;
+		table->stats[i] = (slavery_request_stats_t){0};
+	}
+
+	pthread_condattr_destroy(&attr);
+
+	return 0;
+}
+
+void slavery_request_table_destroy(slavery_request_table_t *table) {
+	for (size_t i = 0; i < SLAVERY_REQUEST_TABLE_SIZE; i++) {
+		pthread_cond_destroy(&table->requests[i].cond);
+	}
+
+	pthread_cond_destroy(&table->slot_freed);
+	pthread_mutex_destroy(&table->mutex);
+}
+
+static slavery_request_t *slavery_request_table_find(slavery_request_table_t *table,
+                                                     const uint8_t device_index,
+                                                     const uint8_t feature_index,
+                                                     const uint8_t function) {
+	for (size_t i = 0; i < SLAVERY_REQUEST_TABLE_SIZE; i++) {
+		slavery_request_t *request = &table->requests[i];
+
+		if (request->in_use && request->device_index == device_index &&
+		    request->feature_index == feature_index && request->function == function) {
+			return request;
+		}
+	}
+
+	return NULL;
+}
+
+static uint8_t slavery_request_table_allocate_software_id(slavery_request_table_t *table,
+                                                        const uint8_t device_index) {
+	uint8_t software_id = table->next_software_id[device_index];
+
+	// Rotate through the IDs rather than reusing the lowest free one, so a late response to an abandoned
+	// request is unlikely to be mistaken for the answer to a new one.
+	for (size_t i = 0; i < SLAVERY_SOFTWARE_ID_COUNT; i++) {
+		if (!(table->software_ids[device_index] & (1 << software_id))) {
+			table->software_ids[device_index] |= 1 << software_id;
+			table->next_software_id[device_index] =
+			    software_id == SLAVERY_SOFTWARE_ID_MAX ? SLAVERY_SOFTWARE_ID_MIN : software_id + 1;
+
+			return software_id;
+		}
+
+		software_id = software_id == SLAVERY_SOFTWARE_ID_MAX ? SLAVERY_SOFTWARE_ID_MIN : software_id + 1;
+	}
+
+	return 0;
+}
+
+static void slavery_request_table_release(slavery_request_table_t *table, slavery_request_t *request) {
+	request->in_use = false;
+	table->software_ids[request->device_index] &= ~(1 << (request->function & 0x0f));
+
+	pthread_cond_broadcast(&table->slot_freed);
+}
+
+slavery_request_t *slavery_request_table_submit(slavery_request_table_t *table,
+                                                uint8_t request_data[],
+                                                const struct timespec *deadline,
+                                                const bool block) {
+	slavery_request_t *request = NULL;
+	uint8_t software_id = 0;
+
+	pthread_mutex_lock(&table->mutex);
+
+	// Wait for both a free slot and a free software ID for the device.
+	while (true) {
+		for (size_t i = 0; i < SLAVERY_REQUEST_TABLE_SIZE && request == NULL; i++) {
+			if (!table->requests[i].in_use) {
+				request = &table->requests[i];
+			}
+		}
+
+		if (request != NULL &&
+		    (software_id = slavery_request_table_allocate_software_id(table, request_data[1])) != 0) {
+			break;
+		}
+
+		request = NULL;
+
+		if (!block) {
+			pthread_mutex_unlock(&table->mutex);
+
+			errno = EAGAIN;
+
+			return NULL;
+		}
+
+		if (deadline == NULL) {
+			pthread_cond_wait(&table->slot_freed, &table->mutex);
+		} else if (pthread_cond_timedwait(&table->slot_freed, &table->mutex, deadline) == ETIMEDOUT) {
+			table->stats[request_data[1]].timeouts++;
+
+			pthread_mutex_unlock(&table->mutex);
+
+			errno = ETIMEDOUT;
+
+			return NULL;
+		}
+	}
+
+	request_data[3] = (request_data[3] & 0xf0) | software_id;
+
+	request->in_use = true;
+	request->complete = false;
+	request->expires = deadline != NULL;
+	request->deadline = deadline != NULL ? *deadline : (struct timespec){0};
+	request->device_index = request_data[1];
+	request->feature_index = request_data[2];
+	request->function = request_data[3];
+	request->response_size = 0;
+	table->stats[request->device_index].requests++;
+
+	pthread_mutex_unlock(&table->mutex);
+
+	return request;
+}
+
+bool slavery_request_table_complete(slavery_request_table_t *table,
+                                    const uint8_t report_data[],
+                                    const ssize_t report_size) {
+	slavery_request_t *request;
+
+	if (report_size < SLAVERY_PACKET_LENGTH_CONTROL_SHORT) {
+		atomic_fetch_add_explicit(&table->unsolicited, 1, memory_order_relaxed);
+
+		return false;
+	}
+
+	pthread_mutex_lock(&table->mutex);
+
+	// Error reports shift the original feature index and function along by one byte.
+	if (report_data[2] == SLAVERY_FEATURE_INDEX_ERROR ||
+	    report_data[2] == SLAVERY_FEATURE_INDEX_ERROR_HIDPP20) {
+		request = slavery_request_table_find(table, report_data[1], report_data[3], report_data[4]);
+	} else {
+		request = slavery_request_table_find(table, report_data[1], report_data[2], report_data[3]);
+	}
+
+	if (request == NULL || request->complete) {
+		pthread_mutex_unlock(&table->mutex);
+
+		atomic_fetch_add_explicit(&table->unsolicited, 1, memory_order_relaxed);
+
+		return false;
+	}
+
+	// Responses are never longer than a long control report, which is what callers size their buffers for.
+	request->response_size =
+	    report_size < SLAVERY_PACKET_LENGTH_CONTROL_LONG ? report_size : SLAVERY_PACKET_LENGTH_CONTROL_LONG;
+	memcpy(request->response_data, report_data, request->response_size);
+	request->complete = true;
+
+	pthread_cond_signal(&request->cond);
+	pthread_mutex_unlock(&table->mutex);
+
+	return true;
+}
+
+ssize_t slavery_request_table_wait(slavery_request_table_t *table,
+                                   slavery_request_t *request,
+                                   uint8_t response_data[]) {
+	pthread_mutex_lock(&table->mutex);
+
+	while (!request->complete) {
+		if (!request->expires) {
+			pthread_cond_wait(&request->cond, &table->mutex);
+		} else if (pthread_cond_timedwait(&request->cond, &table->mutex, &request->deadline) == ETIMEDOUT &&
+		           !request->complete) {
+			table->stats[request->device_index].timeouts++;
+			slavery_request_table_release(table, request);
+
+			pthread_mutex_unlock(&table->mutex);
+
+			errno = ETIMEDOUT;
+
+			return -1;
+		}
+	}
+
+	ssize_t response_size = request->response_size;
+
+	memcpy(response_data, request->response_data, response_size);
+	slavery_request_table_release(table, request);
+
+	pthread_mutex_unlock(&table->mutex);
+
+	return response_size;
+}
+
+void slavery_request_table_cancel(slavery_request_table_t *table, slavery_request_t *request) {
+	pthread_mutex_lock(&table->mutex);
+
+	slavery_request_table_release(table, request);
+
+	pthread_mutex_unlock(&table->mutex);
+}
+
+void slavery_request_table_count_error(slavery_request_table_t *table, const uint8_t device_index) {
+	pthread_mutex_lock(&table->mutex);
+
+	table->stats[device_index].errors++;
+
+	pthread_mutex_unlock(&table->mutex);
+}
+
+void slavery_request_table_count_retry(slavery_request_table_t *table, const uint8_t device_index) {
+	pthread_mutex_lock(&table->mutex);
+
+	table->stats[device_index].retries++;
+
+	pthread_mutex_unlock(&table->mutex);
+}
+
+void slavery_request_table_get_stats(slavery_request_table_t *table,
+                                     const uint8_t device_index,
+                                     slavery_request_stats_t *stats) {
+	pthread_mutex_lock(&table->mutex);
+
+	*stats = table->stats[device_index];
+
+	pthread_mutex_unlock(&table->mutex);
+}
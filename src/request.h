@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief Pending HID++ request table functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "libslavery.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define SLAVERY_REQUEST_TABLE_SIZE 32
+
+/**
+ * @brief Range of HID++ software IDs. 0 is reserved for notifications, leaving 15 requests per device that
+ * can be told apart while in flight.
+ */
+typedef enum
+{
+	SLAVERY_SOFTWARE_ID_MIN = 0x01,
+	SLAVERY_SOFTWARE_ID_MAX = 0x0f,
+	SLAVERY_SOFTWARE_ID_COUNT = SLAVERY_SOFTWARE_ID_MAX - SLAVERY_SOFTWARE_ID_MIN + 1
+} slavery_software_id_t;
+
+/**
+ * @brief An outstanding request, waiting for the listener to deliver its response.
+ *
+ * Requests are keyed by (device index, feature index, function/software ID), which is echoed back in both
+ * responses and error reports. Software IDs are unique per device while in flight, so every key is too. The
+ * deadline is set when the request is submitted, so time spent queued behind others counts towards it.
+ */
+typedef struct slavery_request_t {
+	bool in_use;
+	bool complete;
+	bool expires;
+	struct timespec deadline;
+	uint8_t device_index;
+	uint8_t feature_index;
+	uint8_t function;
+	ssize_t response_size;
+	uint8_t response_data[SLAVERY_PACKET_LENGTH_MAX];
+	pthread_cond_t cond;
+} slavery_request_t;
+
+/**
+ * @brief Correlates responses read by the listener with the callers waiting on them.
+ */
+typedef struct slavery_request_table_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t slot_freed;
+	slavery_request_t requests[SLAVERY_REQUEST_TABLE_SIZE];
+	uint16_t software_ids[UINT8_MAX + 1];
+	uint8_t next_software_id[UINT8_MAX + 1];
+	slavery_request_stats_t stats[UINT8_MAX + 1];
+	atomic_size_t unsolicited;
+} slavery_request_table_t;
+
+int slavery_request_table_init(slavery_request_table_t *table);
+void slavery_request_table_destroy(slavery_request_table_t *table);
+slavery_request_t *slavery_request_table_submit(slavery_request_table_t *table,
+                                                uint8_t request_data[],
+                                                const struct timespec *deadline,
+                                                const bool block);
+bool slavery_request_table_complete(slavery_request_table_t *table,
+                                    const uint8_t report_data[],
+                                    const ssize_t report_size);
+ssize_t slavery_request_table_wait(slavery_request_table_t *table,
+                                   slavery_request_t *request,
+                                   uint8_t response_data[]);
+void slavery_request_table_cancel(slavery_request_table_t *table, slavery_request_t *request);
+void slavery_request_table_count_error(slavery_request_table_t *table, const uint8_t device_index);
+void slavery_request_table_count_retry(slavery_request_table_t *table, const uint8_t device_index);
+void slavery_request_table_get_stats(slavery_request_table_t *table,
+                                     const uint8_t device_index,
+                                     slavery_request_stats_t *stats);
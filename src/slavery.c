@@ -12,21 +12,39 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && strcmp(argv[1], "compile-config") == 0) {
+		if (argc < 3 || argc > 4) {
+			fprintf(stderr, "usage: %s compile-config <config.json> [output]\n", argv[0]);
+
+			return EXIT_FAILURE;
+		}
+
+		return slavery_config_compile(argv[2], argc == 4 ? argv[3] : NULL) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
-int main() {
 	slavery_t *slavery = slavery_new();
-	ssize_t num_receivers = slavery_scan_receivers(slavery);
+	slavery_scan_timings_t timings;
 
-	for (ssize_t i = 0; i < num_receivers; i++) {
-		slavery_receiver_t *receiver = slavery_get_receiver(slavery, i);
-		ssize_t num_devices = slavery_receiver_scan_devices(receiver);
+	slavery_scan_receivers(slavery);
+	slavery_scan_devices(slavery);
+	slavery_get_scan_timings(slavery, &timings);
 
-		for (ssize_t j = 0; j < num_devices; j++) {
-			// slavery_device_set_config(device_entry->device, config);
-		}
+	log_debug("startup: discover %luus, open %luus, devices %luus",
+	          timings.discover_ns / 1000,
+	          timings.open_ns / 1000,
+	          timings.devices_ns / 1000);
+
+	// q quits, and v switches debug logging on and off without restarting.
+	int c;
+
+	while ((c = getchar()) != 'q') {
+		if (c == 'v') {
+			bool debug = slavery_get_log_level() == LOG_LEVEL_DEBUG;
 
-		while (getchar() != 'q') {
-			continue;
+			slavery_set_log_level(debug ? LOG_LEVEL_WARNING : LOG_LEVEL_DEBUG);
 		}
 	}
 
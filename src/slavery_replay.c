@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @brief Replays recorded HID++ traces through libslavery, to benchmark the event pipeline.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#include "libslavery.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static atomic_size_t allocations;
+
+// Allocations are counted here rather than in the library, by standing in for glibc's allocator in this
+// program alone. Every thread's allocations count, the library's included. Functions such as strdup() and
+// fopen() allocate through malloc() and are counted with it, but glibc's aligned allocations don't, so they
+// are stood in for as well.
+void *malloc(size_t size) {
+	atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+	atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+	return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+	atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	// Unlike memalign(), the alignment must be a power of 2 multiple of the size of a pointer.
+	if (alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+
+	void *aligned = memalign(alignment, size);
+
+	if (aligned == NULL) {
+		return ENOMEM;
+	}
+
+	*ptr = aligned;
+
+	return 0;
+}
+
+static void print_latency(const char *stage, const slavery_replay_latency_t *latency) {
+	printf("%-10s p50 %8.1fus  p90 %8.1fus  p99 %8.1fus  p99.9 %8.1fus  max %8.1fus\n",
+	       stage,
+	       latency->p50_ns / 1000.0,
+	       latency->p90_ns / 1000.0,
+	       latency->p99_ns / 1000.0,
+	       latency->p999_ns / 1000.0,
+	       latency->max_ns / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+	bool fast = false;
+	int arg = 1;
+
+	if (arg < argc && strcmp(argv[arg], "--fast") == 0) {
+		fast = true;
+		arg++;
+	}
+
+	if (argc - arg < 1 || argc - arg > 2) {
+		fprintf(stderr, "usage: %s [--fast] <trace.pcapng> [config.json]\n", argv[0]);
+
+		return EXIT_FAILURE;
+	}
+
+	slavery_replay_t *replay = slavery_replay_new(argv[arg], NULL, argc - arg == 2 ? argv[arg + 1] : NULL);
+	slavery_replay_stats_t stats;
+
+	if (replay == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	// Debug logging would cost more than everything being measured.
+	slavery_set_log_level(LOG_LEVEL_WARNING);
+
+	size_t allocations_before = atomic_load(&allocations);
+
+	if (slavery_replay_run(replay, fast) < 0) {
+		fprintf(stderr, "%s: no events to replay in %s\n", argv[0], argv[arg]);
+
+		slavery_replay_free(replay);
+
+		return EXIT_FAILURE;
+	}
+
+	size_t run_allocations = atomic_load(&allocations) - allocations_before;
+
+	slavery_replay_get_stats(replay, &stats);
+
+	printf("events     %zu fed, %zu dispatched, %zu dropped\n",
+	       stats.events,
+	       stats.dispatched,
+	       stats.events - stats.dispatched);
+	printf("requests   %zu answered, %zu refused\n", stats.answered, stats.refused);
+	printf("throughput %.0f events/s over %.3fs\n",
+	       stats.elapsed_ns > 0 ? stats.dispatched * 1e9 / stats.elapsed_ns : 0.0,
+	       stats.elapsed_ns / 1e9);
+	printf("allocs     %.3f per event (%zu in total)\n",
+	       stats.events > 0 ? (double)run_allocations / stats.events : 0.0,
+	       run_allocations);
+
+	print_latency("read", &stats.read);
+	print_latency("queue", &stats.queue);
+	print_latency("dispatch", &stats.dispatch);
+	print_latency("total", &stats.total);
+
+	slavery_replay_free(replay);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/**
+ * @file
+ * @brief Hierarchical timer wheel implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "timer.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define SLAVERY_TIMER_TICK_NS 1000000
+#define SLAVERY_TIMER_LEVEL_BITS 6
+#define SLAVERY_TIMER_MAX_DELAY ((1ULL << (SLAVERY_TIMER_LEVEL_BITS * SLAVERY_TIMER_LEVELS)) - 1)
+
+static uint64_t slavery_timer_wheel_tick(const slavery_timer_wheel_t *wheel) {
+	return (time_monotonic_ns() - wheel->start_ns) / SLAVERY_TIMER_TICK_NS;
+}
+
+static void slavery_timer_wheel_insert(slavery_timer_wheel_t *wheel, slavery_timer_t *timer) {
+	uint64_t delta = timer->expires - wheel->now;
+	uint8_t level = 0;
+
+	// A timer goes in the lowest level whose slots still reach its deadline, so it is cascaded down a level
+	// each time its slot comes round, and lands in level 0 for its final millisecond.
+	while (level < SLAVERY_TIMER_LEVELS - 1 && delta >= 1ULL << (SLAVERY_TIMER_LEVEL_BITS * (level + 1))) {
+		level++;
+	}
+
+	uint8_t slot = (timer->expires >> (SLAVERY_TIMER_LEVEL_BITS * level)) & (SLAVERY_TIMER_SLOTS - 1);
+	slavery_timer_t **head = &wheel->slots[level][slot];
+
+	timer->level = level;
+	timer->slot = slot;
+	timer->next = *head;
+	timer->pprev = head;
+
+	if (*head != NULL) {
+		(*head)->pprev = &timer->next;
+	}
+
+	*head = timer;
+	wheel->occupied[level] |= 1ULL << slot;
+}
+
+static void slavery_timer_wheel_unlink(slavery_timer_wheel_t *wheel, slavery_timer_t *timer) {
+	*timer->pprev = timer->next;
+
+	if (timer->next != NULL) {
+		timer->next->pprev = timer->pprev;
+	}
+
+	if (wheel->slots[timer->level][timer->slot] == NULL) {
+		wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+	}
+
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+static uint64_t slavery_timer_wheel_next(const slavery_timer_wheel_t *wheel) {
+	uint64_t next = UINT64_MAX;
+
+	// The next tick with work is the first occupied slot after the current one, on any level.
+	for (uint8_t level = 0; level < SLAVERY_TIMER_LEVELS; level++) {
+		if (wheel->occupied[level] == 0) {
+			continue;
+		}
+
+		unsigned int shift = SLAVERY_TIMER_LEVEL_BITS * level;
+		uint64_t units = wheel->now >> shift;
+		unsigned int start = (units + 1) & (SLAVERY_TIMER_SLOTS - 1);
+		uint64_t rotated = wheel->occupied[level] >> start | wheel->occupied[level] << ((64 - start) & 63);
+		uint64_t tick = (units + __builtin_ctzll(rotated) + 1) << shift;
+
+		if (tick < next) {
+			next = tick;
+		}
+	}
+
+	return next;
+}
+
+static void slavery_timer_wheel_advance(slavery_timer_wheel_t *wheel, const uint64_t target) {
+	while (wheel->now < target) {
+		uint64_t next = slavery_timer_wheel_next(wheel);
+
+		// Ticks without work are skipped outright, so catching up after a long idle period costs nothing.
+		if (next > target) {
+			wheel->now = target;
+
+			break;
+		}
+
+		wheel->now = next;
+
+		// Higher levels cascade first, so their timers can fall all the way down to this tick.
+		for (uint8_t level = SLAVERY_TIMER_LEVELS - 1; level > 0; level--) {
+			unsigned int shift = SLAVERY_TIMER_LEVEL_BITS * level;
+
+			if ((next & ((1ULL << shift) - 1)) != 0) {
+				continue;
+			}
+
+			uint8_t slot = (next >> shift) & (SLAVERY_TIMER_SLOTS - 1);
+			slavery_timer_t *timer = wheel->slots[level][slot];
+
+			wheel->slots[level][slot] = NULL;
+			wheel->occupied[level] &= ~(1ULL << slot);
+
+			while (timer != NULL) {
+				slavery_timer_t *next_timer = timer->next;
+
+				slavery_timer_wheel_insert(wheel, timer);
+				timer = next_timer;
+			}
+		}
+
+		slavery_timer_t **head = &wheel->slots[0][next & (SLAVERY_TIMER_SLOTS - 1)];
+		slavery_timer_t *timer;
+
+		while ((timer = *head) != NULL) {
+			slavery_timer_wheel_unlink(wheel, timer);
+			wheel->num_timers--;
+
+			timer->callback(timer);
+		}
+	}
+}
+
+static int slavery_timer_wheel_program(slavery_timer_wheel_t *wheel, const uint64_t next) {
+	struct itimerspec spec;
+
+	memset(&spec, 0, sizeof(spec));
+
+	// An all-zero expiry disarms the timerfd.
+	if (next != UINT64_MAX) {
+		uint64_t expires_ns = wheel->start_ns + next * SLAVERY_TIMER_TICK_NS;
+
+		spec.it_value.tv_sec = expires_ns / 1000000000;
+		spec.it_value.tv_nsec = expires_ns % 1000000000;
+	}
+
+	if (timerfd_settime(wheel->fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "timerfd_settime() failed");
+
+		return -1;
+	}
+
+	wheel->deadline = next;
+
+	return 0;
+}
+
+int slavery_timer_wheel_init(slavery_timer_wheel_t *wheel) {
+	memset(wheel, 0, sizeof(slavery_timer_wheel_t));
+
+	if ((wheel->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "timerfd_create() failed");
+
+		return -1;
+	}
+
+	pthread_mutex_init(&wheel->mutex, NULL);
+
+	wheel->start_ns = time_monotonic_ns();
+	wheel->deadline = UINT64_MAX;
+
+	return 0;
+}
+
+void slavery_timer_wheel_destroy(slavery_timer_wheel_t *wheel) {
+	pthread_mutex_destroy(&wheel->mutex);
+	close(wheel->fd);
+}
+
+void slavery_timer_wheel_expire(slavery_timer_wheel_t *wheel) {
+	uint64_t expirations;
+
+	if (read(wheel->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+		log_warning_errno(SLAVERY_ERROR_OS, "read() failed on timerfd");
+	}
+
+	pthread_mutex_lock(&wheel->mutex);
+
+	slavery_timer_wheel_advance(wheel, slavery_timer_wheel_tick(wheel));
+	slavery_timer_wheel_program(wheel, slavery_timer_wheel_next(wheel));
+
+	pthread_mutex_unlock(&wheel->mutex);
+}
+
+void slavery_timer_init(slavery_timer_t *timer, slavery_timer_callback_t callback, void *data) {
+	timer->next = NULL;
+	timer->pprev = NULL;
+	timer->expires = 0;
+	timer->callback = callback;
+	timer->data = data;
+}
+
+int slavery_timer_arm(slavery_timer_wheel_t *wheel, slavery_timer_t *timer, const uint64_t delay_ns) {
+	int result = 0;
+
+	pthread_mutex_lock(&wheel->mutex);
+
+	if (timer->pprev != NULL) {
+		slavery_timer_wheel_unlink(wheel, timer);
+		wheel->num_timers--;
+	}
+
+	uint64_t elapsed_ns = time_monotonic_ns() - wheel->start_ns;
+	uint64_t tick = elapsed_ns / SLAVERY_TIMER_TICK_NS;
+
+	// The wheel only advances when its timerfd fires, so an empty one is brought up to date first to keep
+	// new timers in the lowest level they can go in.
+	if (wheel->num_timers == 0 && tick > wheel->now) {
+		wheel->now = tick;
+	}
+
+	// Rounding up means a timer never fires before its delay has passed, and at most a tick after.
+	timer->expires = (elapsed_ns + delay_ns + SLAVERY_TIMER_TICK_NS - 1) / SLAVERY_TIMER_TICK_NS;
+
+	if (timer->expires <= wheel->now) {
+		timer->expires = wheel->now + 1;
+	} else if (timer->expires - wheel->now > SLAVERY_TIMER_MAX_DELAY) {
+		timer->expires = wheel->now + SLAVERY_TIMER_MAX_DELAY;
+	}
+
+	slavery_timer_wheel_insert(wheel, timer);
+	wheel->num_timers++;
+
+	// A deadline later than the one set is left alone, the early wakeup just sets the timerfd again.
+	uint64_t next = slavery_timer_wheel_next(wheel);
+
+	if (next < wheel->deadline) {
+		result = slavery_timer_wheel_program(wheel, next);
+	}
+
+	pthread_mutex_unlock(&wheel->mutex);
+
+	return result;
+}
+
+int slavery_timer_cancel(slavery_timer_wheel_t *wheel, slavery_timer_t *timer) {
+	pthread_mutex_lock(&wheel->mutex);
+
+	// The timerfd is left set, waking once for nothing is cheaper than setting it on every cancel.
+	if (timer->pprev != NULL) {
+		slavery_timer_wheel_unlink(wheel, timer);
+		wheel->num_timers--;
+	}
+
+	pthread_mutex_unlock(&wheel->mutex);
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Hierarchical timer wheel functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of wheel levels. Each level's slots span 64 times those of the level below, starting at 1ms,
+ * so the longest delay is 64^4 ms, a little over four and a half hours.
+ */
+#define SLAVERY_TIMER_LEVELS 4
+
+/**
+ * @brief Number of slots in each wheel level, one bit each in the level's occupancy mask.
+ */
+#define SLAVERY_TIMER_SLOTS 64
+
+typedef struct slavery_timer_t slavery_timer_t;
+
+/**
+ * @brief Called with the wheel locked when a timer expires. Must not arm or cancel timers on the same wheel.
+ */
+typedef void (*slavery_timer_callback_t)(slavery_timer_t *timer);
+
+/**
+ * @brief A timer, embedded in its owner so arming it never allocates.
+ */
+typedef struct slavery_timer_t {
+	slavery_timer_t *next;
+	slavery_timer_t **pprev;
+	uint64_t expires;
+	uint8_t level;
+	uint8_t slot;
+	slavery_timer_callback_t callback;
+	void *data;
+} slavery_timer_t;
+
+/**
+ * @brief Millisecond timer wheel driven by a single timerfd.
+ *
+ * The timerfd is only ever set for the next slot that has work, either timers expiring or a higher level's
+ * slot to cascade down, so an idle wheel costs no wakeups and a busy one one per distinct deadline.
+ */
+typedef struct slavery_timer_wheel_t {
+	pthread_mutex_t mutex;
+	int fd;
+	uint64_t start_ns;
+	uint64_t now;
+	uint64_t deadline;
+	size_t num_timers;
+	uint64_t occupied[SLAVERY_TIMER_LEVELS];
+	slavery_timer_t *slots[SLAVERY_TIMER_LEVELS][SLAVERY_TIMER_SLOTS];
+} slavery_timer_wheel_t;
+
+int slavery_timer_wheel_init(slavery_timer_wheel_t *wheel);
+void slavery_timer_wheel_destroy(slavery_timer_wheel_t *wheel);
+void slavery_timer_wheel_expire(slavery_timer_wheel_t *wheel);
+void slavery_timer_init(slavery_timer_t *timer, slavery_timer_callback_t callback, void *data);
+int slavery_timer_arm(slavery_timer_wheel_t *wheel, slavery_timer_t *timer, const uint64_t delay_ns);
+int slavery_timer_cancel(slavery_timer_wheel_t *wheel, slavery_timer_t *timer);
@@ -0,0 +1,177 @@
+/**
+ * @file
+ * @brief Receiver transport implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "transport.h"
+
+#include "discovery.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+static ssize_t slavery_transport_hidraw_discover(const slavery_transport_t *transport,
+                                                 const slavery_options_t *options,
+                                                 char ***paths) {
+	UNUSED(transport);
+
+	return slavery_discover(options->discovery, paths);
+}
+
+static int slavery_transport_hidraw_open(const slavery_transport_t *transport, const char *path) {
+	UNUSED(transport);
+
+	return open(path, O_RDWR | O_NONBLOCK);
+}
+
+static int slavery_transport_hidraw_get_report_descriptor(const int fd) {
+	struct hidraw_report_descriptor desc;
+
+	if ((ioctl(fd, HIDIOCGRDESCSIZE, &desc.size)) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRDESCSIZE) failed");
+
+		return -1;
+	}
+
+	if ((ioctl(fd, HIDIOCGRDESC, &desc)) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRDESC) failed");
+
+		return -1;
+	}
+
+	if (log_enabled(LOG_LEVEL_DEBUG)) {
+		char hex[desc.size * 5];
+
+		log_debug(
+		    "received report descriptor of size %u: %s", desc.size, bytes_to_hex(desc.value, desc.size, hex));
+	}
+
+	return 0;
+}
+
+static int slavery_transport_hidraw_info(const slavery_transport_t *transport,
+                                         const int fd,
+                                         slavery_transport_info_t *info) {
+	struct hidraw_devinfo devinfo;
+	struct stat devnode_stat;
+
+	UNUSED(transport);
+
+	if ((ioctl(fd, HIDIOCGRAWINFO, &devinfo)) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWINFO) failed");
+
+		return -1;
+	}
+
+	info->vendor_id = devinfo.vendor;
+	info->product_id = devinfo.product;
+	info->minor = fstat(fd, &devnode_stat) == 0 ? minor(devnode_stat.st_rdev) : 0;
+
+	if (ioctl(fd, HIDIOCGRAWNAME(sizeof(info->name)), info->name) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWNAME) failed");
+
+		return -1;
+	}
+
+	if (ioctl(fd, HIDIOCGRAWPHYS(sizeof(info->address)), info->address) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "ioctl(HIDIOCGRAWPHYS) failed");
+
+		return -1;
+	}
+
+	// Neither string is terminated when it fills the buffer.
+	info->name[sizeof(info->name) - 1] = '\0';
+	info->address[sizeof(info->address) - 1] = '\0';
+
+	// Only receivers are worth the descriptor, which is just logged.
+	if (info->vendor_id == SLAVERY_USB_VENDOR_ID_LOGITECH &&
+	    info->product_id == SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER &&
+	    slavery_transport_hidraw_get_report_descriptor(fd) < 0) {
+		log_warning(SLAVERY_ERROR_IO, "failed to get report descriptor");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+static ssize_t slavery_transport_hidraw_read(const slavery_transport_t *transport,
+                                             const int fd,
+                                             uint8_t data[],
+                                             const size_t size) {
+	UNUSED(transport);
+
+	return read(fd, data, size);
+}
+
+static ssize_t slavery_transport_hidraw_write(const slavery_transport_t *transport,
+                                              const int fd,
+                                              const uint8_t data[],
+                                              const size_t size) {
+	UNUSED(transport);
+
+	return write(fd, data, size);
+}
+
+static int slavery_transport_hidraw_close(const slavery_transport_t *transport, const int fd) {
+	UNUSED(transport);
+
+	return close(fd);
+}
+
+const slavery_transport_t slavery_transport_hidraw = {.name = "hidraw",
+                                                      .data = NULL,
+                                                      .discover = slavery_transport_hidraw_discover,
+                                                      .open = slavery_transport_hidraw_open,
+                                                      .info = slavery_transport_hidraw_info,
+                                                      .read = slavery_transport_hidraw_read,
+                                                      .write = slavery_transport_hidraw_write,
+                                                      .close = slavery_transport_hidraw_close};
+
+ssize_t slavery_transport_socket_read(const slavery_transport_t *transport,
+                                      const int fd,
+                                      uint8_t data[],
+                                      const size_t size) {
+	UNUSED(transport);
+
+	return recv(fd, data, size, 0);
+}
+
+ssize_t slavery_transport_socket_write(const slavery_transport_t *transport,
+                                       const int fd,
+                                       const uint8_t data[],
+                                       const size_t size) {
+	UNUSED(transport);
+
+	// Whatever is at the other end can go away before the receiver does, which mustn't kill the process.
+	return send(fd, data, size, MSG_NOSIGNAL);
+}
+
+int slavery_transport_socket_close(const slavery_transport_t *transport, const int fd) {
+	UNUSED(transport);
+
+	return close(fd);
+}
+
+const slavery_transport_t slavery_transport_socket = {.name = "socket",
+                                                      .data = NULL,
+                                                      .discover = NULL,
+                                                      .open = NULL,
+                                                      .info = NULL,
+                                                      .read = slavery_transport_socket_read,
+                                                      .write = slavery_transport_socket_write,
+                                                      .close = slavery_transport_socket_close};
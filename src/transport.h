@@ -0,0 +1,33 @@
+/**
+ * @file
+ * @brief Receiver transport functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include "libslavery.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief Receivers that are one end of a socket pair, created from a descriptor rather than found. Has no
+ * discover, open or info.
+ */
+extern const slavery_transport_t slavery_transport_socket;
+
+ssize_t slavery_transport_socket_read(const slavery_transport_t *transport,
+                                      const int fd,
+                                      uint8_t data[],
+                                      const size_t size);
+ssize_t slavery_transport_socket_write(const slavery_transport_t *transport,
+                                       const int fd,
+                                       const uint8_t data[],
+                                       const size_t size);
+int slavery_transport_socket_close(const slavery_transport_t *transport, const int fd);
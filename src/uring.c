@@ -0,0 +1,601 @@
+/**
+ * @file
+ * @brief io_uring receiver I/O backend implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "uring.h"
+
+#include "libslavery_p.h"
+#include "receiver.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#define SLAVERY_URING_BUFFER_GROUP 0
+
+/**
+ * @brief Kinds of operation, kept in the upper half of each submission's user data.
+ */
+typedef enum
+{
+	SLAVERY_URING_OP_READ = 1,
+	SLAVERY_URING_OP_WRITE = 2,
+	SLAVERY_URING_OP_STOP = 3,
+	SLAVERY_URING_OP_CANCEL = 4,
+	SLAVERY_URING_OP_TIMER = 5,
+	SLAVERY_URING_OP_SCRATCH = 6
+} slavery_uring_op_t;
+
+static uint64_t slavery_uring_user_data(const slavery_uring_op_t op, const uint32_t index) {
+	return (uint64_t)op << 32 | index;
+}
+
+static struct io_uring_sqe *slavery_uring_get_sqe(slavery_uring_t *uring) {
+	struct io_uring_sqe *sqe;
+
+	// A full submission queue is flushed to make room, which is the only time a deferred write is sent early.
+	while ((sqe = io_uring_get_sqe(&uring->ring)) == NULL) {
+		io_uring_submit(&uring->ring);
+		uring->num_queued = 0;
+	}
+
+	return sqe;
+}
+
+static void slavery_uring_arm_read(slavery_uring_t *uring, const uint32_t file_index) {
+	struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+	if (uring->multishot) {
+		io_uring_prep_read_multishot(sqe, file_index, 0, 0, SLAVERY_URING_BUFFER_GROUP);
+	} else {
+		io_uring_prep_read(sqe, file_index, NULL, SLAVERY_PACKET_LENGTH_MAX, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = SLAVERY_URING_BUFFER_GROUP;
+	}
+
+	sqe->flags |= IOSQE_FIXED_FILE;
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_READ, file_index));
+	uring->file_ops[file_index]++;
+}
+
+static void slavery_uring_arm_scratch(slavery_uring_t *uring, const uint32_t file_index) {
+	struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+	// Unlike a buffer ring read, this one always has somewhere to put a report, so it waits for one.
+	io_uring_prep_read(sqe, file_index, uring->scratch[file_index], SLAVERY_PACKET_LENGTH_MAX, 0);
+	sqe->flags |= IOSQE_FIXED_FILE;
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_SCRATCH, file_index));
+	uring->file_ops[file_index]++;
+}
+
+static void slavery_uring_arm_timer(slavery_uring_t *uring, const uint32_t file_index) {
+	struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+	// Timers expire far less often than reports arrive, so a one-shot poll re-armed each time is enough.
+	io_uring_prep_poll_add(sqe, uring->files[file_index]->timers.fd, POLLIN);
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_TIMER, file_index));
+	uring->file_ops[file_index]++;
+}
+
+static void slavery_uring_provide_buffers(slavery_uring_t *uring) {
+	int mask = io_uring_buf_ring_mask(SLAVERY_URING_NUM_BUFFERS);
+	int num_added = 0;
+
+	// Buffers are report slots, so a completed read is already a report that can be passed on by reference.
+	for (unsigned int bid = 0; bid < SLAVERY_URING_NUM_BUFFERS && uring->num_missing_buffers > 0; bid++) {
+		if (uring->buffers[bid] != NULL) {
+			continue;
+		}
+
+		if ((uring->buffers[bid] = slavery_report_acquire(uring->slavery->reports)) == NULL) {
+			break;
+		}
+
+		io_uring_buf_ring_add(
+		    uring->buf_ring, uring->buffers[bid]->data, SLAVERY_PACKET_LENGTH_MAX, bid, mask, num_added++);
+		uring->num_missing_buffers--;
+	}
+
+	if (num_added > 0) {
+		io_uring_buf_ring_advance(uring->buf_ring, num_added);
+	}
+}
+
+slavery_uring_t *slavery_uring_new(slavery_t *slavery) {
+	log_debug("creating io_uring backend");
+
+	slavery_uring_t *uring = calloc(1, sizeof(slavery_uring_t));
+	struct iovec iov = {.iov_base = uring->write_buffers, .iov_len = sizeof(uring->write_buffers)};
+	int result;
+
+	uring->slavery = slavery;
+	uring->multishot = true;
+	uring->free_writes = UINT64_MAX;
+	uring->num_missing_buffers = SLAVERY_URING_NUM_BUFFERS;
+	atomic_init(&uring->running, true);
+
+	if ((result = io_uring_queue_init(SLAVERY_URING_ENTRIES, &uring->ring, 0)) < 0) {
+		errno = -result;
+
+		log_warning_errno(SLAVERY_ERROR_OS, "io_uring_queue_init() failed");
+
+		free(uring);
+
+		return NULL;
+	}
+
+	if ((result = io_uring_register_files_sparse(&uring->ring, SLAVERY_URING_MAX_FILES)) < 0 ||
+	    (result = io_uring_register_buffers(&uring->ring, &iov, 1)) < 0) {
+		errno = -result;
+
+		log_warning_errno(SLAVERY_ERROR_OS, "io_uring registration failed");
+
+		io_uring_queue_exit(&uring->ring);
+		free(uring);
+
+		return NULL;
+	}
+
+	if ((uring->buf_ring = io_uring_setup_buf_ring(
+	         &uring->ring, SLAVERY_URING_NUM_BUFFERS, SLAVERY_URING_BUFFER_GROUP, 0, &result)) == NULL) {
+		errno = -result;
+
+		log_warning_errno(SLAVERY_ERROR_OS, "io_uring_setup_buf_ring() failed");
+
+		io_uring_queue_exit(&uring->ring);
+		free(uring);
+
+		return NULL;
+	}
+
+	slavery_uring_provide_buffers(uring);
+
+	pthread_mutex_init(&uring->mutex, NULL);
+	pthread_mutex_init(&uring->dispatch_mutex, NULL);
+	pthread_cond_init(&uring->write_freed, NULL);
+
+	if ((errno = pthread_create(&uring->thread, NULL, (pthread_callback_t)slavery_uring_run, uring)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		atomic_store(&uring->running, false);
+		slavery_uring_free(uring);
+
+		return NULL;
+	}
+
+	return uring;
+}
+
+int slavery_uring_free(slavery_uring_t *uring) {
+	log_debug("freeing io_uring backend at %p", uring);
+
+	if (atomic_load(&uring->running)) {
+		pthread_mutex_lock(&uring->mutex);
+
+		struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+		io_uring_prep_nop(sqe);
+		io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_STOP, 0));
+		io_uring_submit(&uring->ring);
+
+		pthread_mutex_unlock(&uring->mutex);
+
+		if ((errno = pthread_join(uring->thread, NULL)) != 0) {
+			log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+
+			return -1;
+		}
+	}
+
+	io_uring_free_buf_ring(
+	    &uring->ring, uring->buf_ring, SLAVERY_URING_NUM_BUFFERS, SLAVERY_URING_BUFFER_GROUP);
+	io_uring_queue_exit(&uring->ring);
+
+	for (size_t i = 0; i < SLAVERY_URING_NUM_BUFFERS; i++) {
+		if (uring->buffers[i] != NULL) {
+			slavery_report_unref(uring->buffers[i]);
+		}
+	}
+
+	pthread_cond_destroy(&uring->write_freed);
+	pthread_mutex_destroy(&uring->dispatch_mutex);
+	pthread_mutex_destroy(&uring->mutex);
+	free(uring);
+
+	return 0;
+}
+
+int slavery_uring_add(slavery_uring_t *uring, slavery_receiver_t *receiver) {
+	int result;
+
+	pthread_mutex_lock(&uring->mutex);
+
+	for (uint32_t i = 0; i < SLAVERY_URING_MAX_FILES; i++) {
+		if (uring->file_states[i] != SLAVERY_URING_FILE_FREE) {
+			continue;
+		}
+
+		if ((result = io_uring_register_files_update(&uring->ring, i, &receiver->fd, 1)) < 0) {
+			pthread_mutex_unlock(&uring->mutex);
+
+			errno = -result;
+
+			log_warning_errno(SLAVERY_ERROR_OS, "io_uring_register_files_update() failed");
+
+			return -1;
+		}
+
+		pthread_mutex_lock(&uring->dispatch_mutex);
+
+		uring->files[i] = receiver;
+		uring->file_states[i] = SLAVERY_URING_FILE_ACTIVE;
+
+		pthread_mutex_unlock(&uring->dispatch_mutex);
+
+		receiver->uring_index = i;
+
+		slavery_uring_arm_read(uring, i);
+		slavery_uring_arm_timer(uring, i);
+		io_uring_submit(&uring->ring);
+		uring->num_queued = 0;
+
+		pthread_mutex_unlock(&uring->mutex);
+
+		return 0;
+	}
+
+	pthread_mutex_unlock(&uring->mutex);
+
+	log_warning(SLAVERY_ERROR_OS, "no free io_uring file slots");
+
+	return -1;
+}
+
+int slavery_uring_remove(slavery_uring_t *uring, slavery_receiver_t *receiver) {
+	uint32_t file_index = receiver->uring_index;
+
+	pthread_mutex_lock(&uring->mutex);
+
+	// Once the dispatch lock has been taken and released, the completion thread can't be using the receiver.
+	// The registered file stays open until the cancelled read and timer poll complete, then its slot is
+	// recycled.
+	pthread_mutex_lock(&uring->dispatch_mutex);
+
+	uring->files[file_index] = NULL;
+	uring->file_states[file_index] = SLAVERY_URING_FILE_CLOSING;
+
+	pthread_mutex_unlock(&uring->dispatch_mutex);
+
+	struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+	io_uring_prep_cancel64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_READ, file_index), 0);
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_CANCEL, file_index));
+
+	sqe = slavery_uring_get_sqe(uring);
+
+	io_uring_prep_cancel64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_SCRATCH, file_index), 0);
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_CANCEL, file_index));
+
+	sqe = slavery_uring_get_sqe(uring);
+
+	io_uring_prep_cancel64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_TIMER, file_index), 0);
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_CANCEL, file_index));
+	io_uring_submit(&uring->ring);
+	uring->num_queued = 0;
+
+	pthread_mutex_unlock(&uring->mutex);
+
+	return 0;
+}
+
+int slavery_uring_write(slavery_uring_t *uring,
+                        slavery_receiver_t *receiver,
+                        const uint8_t data[],
+                        const size_t size,
+                        const bool defer) {
+	pthread_mutex_lock(&uring->mutex);
+
+	while (uring->free_writes == 0) {
+		pthread_cond_wait(&uring->write_freed, &uring->mutex);
+	}
+
+	uint32_t slot = __builtin_ctzll(uring->free_writes);
+	struct io_uring_sqe *sqe = slavery_uring_get_sqe(uring);
+
+	uring->free_writes &= ~(1ULL << slot);
+	memcpy(uring->write_buffers[slot], data, size);
+
+	io_uring_prep_write_fixed(sqe, receiver->uring_index, uring->write_buffers[slot], size, 0, 0);
+	sqe->flags |= IOSQE_FIXED_FILE;
+	io_uring_sqe_set_data64(sqe, slavery_uring_user_data(SLAVERY_URING_OP_WRITE, slot));
+	uring->num_queued++;
+
+	int result = 0;
+
+	if (!defer) {
+		result = io_uring_submit(&uring->ring);
+		uring->num_queued = 0;
+	}
+
+	pthread_mutex_unlock(&uring->mutex);
+
+	if (result < 0) {
+		errno = -result;
+
+		log_warning_errno(SLAVERY_ERROR_IO, "io_uring_submit() failed");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+int slavery_uring_flush(slavery_uring_t *uring) {
+	int result = 0;
+
+	pthread_mutex_lock(&uring->mutex);
+
+	if (uring->num_queued > 0) {
+		result = io_uring_submit(&uring->ring);
+		uring->num_queued = 0;
+	}
+
+	pthread_mutex_unlock(&uring->mutex);
+
+	if (result < 0) {
+		errno = -result;
+
+		log_warning_errno(SLAVERY_ERROR_IO, "io_uring_submit() failed");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+static void slavery_uring_handle_read(slavery_uring_t *uring,
+                                      const uint32_t file_index,
+                                      const struct io_uring_cqe *cqe,
+                                      bool *rearm,
+                                      bool *starved,
+                                      bool *release) {
+	slavery_receiver_t *receiver = uring->files[file_index];
+
+	if (cqe->res > 0) {
+		unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		slavery_report_t *report = uring->buffers[bid];
+
+		uring->buffers[bid] = NULL;
+		uring->num_missing_buffers++;
+
+		if (receiver != NULL) {
+			report->receiver = receiver;
+			report->size = cqe->res;
+
+			slavery_receiver_handle_report(receiver, report);
+		}
+
+		slavery_report_unref(report);
+	} else if (cqe->res == -EINVAL && uring->multishot) {
+		log_debug("multishot reads unsupported, falling back to single reads");
+
+		uring->multishot = false;
+	} else if (cqe->res == -ENOBUFS) {
+		log_debug("io_uring file %u ran out of buffers", file_index);
+
+		*starved = true;
+	} else if (cqe->res == 0) {
+		log_debug("io_uring file %u hung up", file_index);
+
+		receiver = NULL;
+	} else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+		errno = -cqe->res;
+
+		log_warning_errno(SLAVERY_ERROR_IO, "read failed on io_uring file %u", file_index);
+
+		receiver = NULL;
+	}
+
+	// A read stops when it isn't multishot, when it runs out of buffers, or when it is cancelled.
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		uring->file_ops[file_index]--;
+
+		if (receiver != NULL) {
+			*rearm = true;
+		} else if (uring->file_states[file_index] == SLAVERY_URING_FILE_CLOSING &&
+		           uring->file_ops[file_index] == 0) {
+			*release = true;
+		}
+	}
+}
+
+static void slavery_uring_handle_scratch(slavery_uring_t *uring,
+                                         const uint32_t file_index,
+                                         const struct io_uring_cqe *cqe,
+                                         bool *starved,
+                                         bool *release) {
+	slavery_receiver_t *receiver = uring->files[file_index];
+
+	uring->file_ops[file_index]--;
+
+	if (cqe->res > 0) {
+		if (receiver != NULL) {
+			slavery_receiver_handle_scratch(receiver, uring->scratch[file_index], cqe->res);
+		}
+	} else if (cqe->res == 0) {
+		log_debug("io_uring file %u hung up", file_index);
+
+		receiver = NULL;
+	} else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+		errno = -cqe->res;
+
+		log_warning_errno(SLAVERY_ERROR_IO, "read failed on io_uring file %u", file_index);
+
+		receiver = NULL;
+	}
+
+	if (receiver != NULL) {
+		*starved = true;
+	} else if (uring->file_states[file_index] == SLAVERY_URING_FILE_CLOSING &&
+	           uring->file_ops[file_index] == 0) {
+		*release = true;
+	}
+}
+
+static void slavery_uring_handle_timer(slavery_uring_t *uring,
+                                       const uint32_t file_index,
+                                       const struct io_uring_cqe *cqe,
+                                       bool *rearm,
+                                       bool *release) {
+	slavery_receiver_t *receiver = uring->files[file_index];
+
+	uring->file_ops[file_index]--;
+
+	if (receiver != NULL) {
+		if (cqe->res > 0) {
+			slavery_timer_wheel_expire(&receiver->timers);
+		}
+
+		*rearm = true;
+	} else if (uring->file_states[file_index] == SLAVERY_URING_FILE_CLOSING &&
+	           uring->file_ops[file_index] == 0) {
+		*release = true;
+	}
+}
+
+void *slavery_uring_run(slavery_uring_t *uring) {
+	if ((errno = pthread_setname_np(pthread_self(), "io_uring")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	log_debug("started");
+
+	while (atomic_load(&uring->running)) {
+		struct io_uring_cqe *cqe;
+		unsigned int head, num_cqes = 0;
+		bool rearm[SLAVERY_URING_MAX_FILES] = {false};
+		bool starved[SLAVERY_URING_MAX_FILES] = {false};
+		bool rearm_timer[SLAVERY_URING_MAX_FILES] = {false};
+		bool release[SLAVERY_URING_MAX_FILES] = {false};
+		uint64_t freed_writes = 0;
+		int result;
+
+		if ((result = io_uring_wait_cqe(&uring->ring, &cqe)) < 0) {
+			if (result == -EINTR) {
+				continue;
+			}
+
+			errno = -result;
+
+			log_warning_errno(SLAVERY_ERROR_OS, "io_uring_wait_cqe() failed");
+
+			break;
+		}
+
+		// The submission lock is never taken while dispatching, as add() and remove() take it first.
+		pthread_mutex_lock(&uring->dispatch_mutex);
+
+		io_uring_for_each_cqe(&uring->ring, head, cqe) {
+			uint64_t user_data = io_uring_cqe_get_data64(cqe);
+			uint32_t index = (uint32_t)user_data;
+
+			switch ((slavery_uring_op_t)(user_data >> 32)) {
+				case SLAVERY_URING_OP_READ:
+					slavery_uring_handle_read(
+					    uring, index, cqe, &rearm[index], &starved[index], &release[index]);
+
+					break;
+
+				case SLAVERY_URING_OP_SCRATCH:
+					slavery_uring_handle_scratch(uring, index, cqe, &starved[index], &release[index]);
+
+					break;
+
+				case SLAVERY_URING_OP_WRITE:
+					if (cqe->res < 0) {
+						errno = -cqe->res;
+
+						log_warning_errno(SLAVERY_ERROR_IO, "failed to write request");
+					}
+
+					freed_writes |= 1ULL << index;
+
+					break;
+
+				case SLAVERY_URING_OP_STOP:
+					atomic_store(&uring->running, false);
+
+					break;
+
+				case SLAVERY_URING_OP_CANCEL:
+					break;
+
+				case SLAVERY_URING_OP_TIMER:
+					slavery_uring_handle_timer(uring, index, cqe, &rearm_timer[index], &release[index]);
+
+					break;
+			}
+
+			num_cqes++;
+		}
+
+		io_uring_cq_advance(&uring->ring, num_cqes);
+
+		pthread_mutex_unlock(&uring->dispatch_mutex);
+
+		// Buffers are handed back and reads re-armed once per batch of completions, in a single submission.
+		pthread_mutex_lock(&uring->mutex);
+
+		if (freed_writes != 0) {
+			uring->free_writes |= freed_writes;
+
+			pthread_cond_broadcast(&uring->write_freed);
+		}
+
+		slavery_uring_provide_buffers(uring);
+
+		for (uint32_t i = 0; i < SLAVERY_URING_MAX_FILES; i++) {
+			if (release[i]) {
+				int fd = -1;
+
+				io_uring_register_files_update(&uring->ring, i, &fd, 1);
+				uring->file_states[i] = SLAVERY_URING_FILE_FREE;
+			} else if (uring->file_states[i] == SLAVERY_URING_FILE_ACTIVE) {
+				// Re-arming a read that ran out of buffers before any are handed back would only fail again.
+				if (starved[i] && uring->num_missing_buffers == SLAVERY_URING_NUM_BUFFERS) {
+					slavery_uring_arm_scratch(uring, i);
+					uring->num_queued++;
+				} else if (rearm[i] || starved[i]) {
+					slavery_uring_arm_read(uring, i);
+					uring->num_queued++;
+				}
+
+				if (rearm_timer[i]) {
+					slavery_uring_arm_timer(uring, i);
+					uring->num_queued++;
+				}
+			}
+		}
+
+		if (uring->num_queued > 0) {
+			io_uring_submit(&uring->ring);
+			uring->num_queued = 0;
+		}
+
+		pthread_mutex_unlock(&uring->mutex);
+	}
+
+	log_debug("stopped");
+
+	return NULL;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @brief io_uring receiver I/O backend functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#ifdef SLAVERY_IO_URING
+
+	#include "report.h"
+	#include "utils.h"
+
+	#include <liburing.h>
+	#include <pthread.h>
+	#include <stdatomic.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+
+	#define SLAVERY_URING_ENTRIES 256
+	#define SLAVERY_URING_MAX_FILES 32
+	#define SLAVERY_URING_NUM_BUFFERS 128
+	#define SLAVERY_URING_NUM_WRITES 64
+
+typedef struct slavery_t slavery_t;
+typedef struct slavery_receiver_t slavery_receiver_t;
+
+/**
+ * @brief State of a registered file slot.
+ */
+typedef enum
+{
+	SLAVERY_URING_FILE_FREE,
+	SLAVERY_URING_FILE_ACTIVE,
+	SLAVERY_URING_FILE_CLOSING
+} slavery_uring_file_state_t;
+
+/**
+ * @brief Services every receiver's reads and writes through one ring and one completion thread.
+ *
+ * Receiver fds are registered files. Each has a multishot read armed, which takes report slots straight from
+ * a provided buffer ring, so a completion is handed on without copying. While the ring is empty, a file reads
+ * into its scratch buffer instead, so responses still reach their requests. Outgoing requests are copied
+ * into registered write buffers and can be queued and submitted in batches. Each receiver's timerfd is polled
+ * through the ring too, so its tap and hold timers need no thread of their own.
+ */
+typedef struct slavery_uring_t {
+	slavery_t *slavery;
+	struct io_uring ring;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t write_freed;
+	pthread_mutex_t dispatch_mutex;
+	bool multishot;
+	struct io_uring_buf_ring *buf_ring;
+	slavery_report_t *buffers[SLAVERY_URING_NUM_BUFFERS];
+	unsigned int num_missing_buffers;
+	uint8_t write_buffers[SLAVERY_URING_NUM_WRITES][SLAVERY_PACKET_LENGTH_MAX];
+	uint8_t scratch[SLAVERY_URING_MAX_FILES][SLAVERY_PACKET_LENGTH_MAX];
+	uint64_t free_writes;
+	unsigned int num_queued;
+	slavery_receiver_t *files[SLAVERY_URING_MAX_FILES];
+	slavery_uring_file_state_t file_states[SLAVERY_URING_MAX_FILES];
+	uint8_t file_ops[SLAVERY_URING_MAX_FILES];
+	atomic_bool running;
+} slavery_uring_t;
+
+slavery_uring_t *slavery_uring_new(slavery_t *slavery);
+int slavery_uring_free(slavery_uring_t *uring);
+int slavery_uring_add(slavery_uring_t *uring, slavery_receiver_t *receiver);
+int slavery_uring_remove(slavery_uring_t *uring, slavery_receiver_t *receiver);
+int slavery_uring_write(slavery_uring_t *uring,
+                        slavery_receiver_t *receiver,
+                        const uint8_t data[],
+                        const size_t size,
+                        const bool defer);
+int slavery_uring_flush(slavery_uring_t *uring);
+void *slavery_uring_run(slavery_uring_t *uring);
+
+#endif
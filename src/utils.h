@@ -75,15 +75,21 @@ const char *slavery_hidpp_error_to_string(const slavery_hidpp_error_t error) {
 }
 
 /**
- * @brief USB HID report IDs.
+ * @brief USB HID report IDs. The timer ID is never sent by a device, it marks a receiver timer's expiry.
  */
 typedef enum
 {
+	SLAVERY_REPORT_ID_TIMER = 0x00,
 	SLAVERY_REPORT_ID_CONTROL_SHORT = 0x10,
 	SLAVERY_REPORT_ID_CONTROL_LONG = 0x11,
 	SLAVERY_REPORT_ID_EVENT = 0x20
 } slavery_report_id_t;
 
+/**
+ * @brief Type of a receiver's DJ mouse report, the only event report with button bits.
+ */
+#define SLAVERY_EVENT_TYPE_MOUSE 0x02
+
 /**
  * @brief Converts byte array to human-readable hex string.
  *
@@ -95,24 +101,35 @@ typedef enum
 const char *bytes_to_hex(const uint8_t bytes[], const size_t num_bytes, char *restrict hex);
 
 /**
- * @brief Debug logging level.
+ * @brief Reads the monotonic clock.
+ *
+ * @return uint64_t Nanoseconds since an arbitrary point in the past.
  */
-extern const char *LOG_LEVEL_DEBUG;
+uint64_t time_monotonic_ns();
 
 /**
- * @brief Info logging level.
+ * @brief Logging levels, from most to least verbose.
  */
-extern const char *LOG_LEVEL_INFO;
+typedef enum
+{
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARNING,
+	/**
+	 * @brief When used will exit the program with EXIT_FAILURE.
+	 */
+	LOG_LEVEL_ERROR
+} slavery_log_level_t;
 
 /**
- * @brief Warning logging level.
+ * @brief Least severe level logged. Change with slavery_set_log_level().
  */
-extern const char *LOG_LEVEL_WARNING;
+extern slavery_log_level_t slavery_log_level;
 
 /**
- * @brief Error logging level. When used will exit the program with EXIT_FAILURE.
+ * @brief Whether messages at a level are logged. Checked before a message's arguments are even evaluated.
  */
-extern const char *LOG_LEVEL_ERROR;
+#define log_enabled(level) ((level) >= __atomic_load_n(&slavery_log_level, __ATOMIC_RELAXED))
 
 #define ERROR_MAP(ERROR)                               \
 	ERROR(SLAVERY_ERROR_EVENT, "Event error")          \
@@ -121,6 +138,7 @@ extern const char *LOG_LEVEL_ERROR;
 	ERROR(SLAVERY_ERROR_OS, "OS error")                \
 	ERROR(SLAVERY_ERROR_UDEV, "udev error")            \
 	ERROR(SLAVERY_ERROR_HIDPP, "HID++ protocol error") \
+	ERROR(SLAVERY_ERROR_TIMEOUT, "Timeout error")      \
 	ERROR_UNKNOWN(SLAVERY_ERROR_UNKNOWN, "Unknown error")
 
 typedef enum
@@ -148,8 +166,13 @@ const char *slavery_error_to_string(const slavery_error_t error) {
 	}
 }
 
-void log_x(const char *level, const char *file, const char *func, const int line, const char *fmt, ...);
-void log_x_error(const char *level,
+void log_x(const slavery_log_level_t level,
+           const char *file,
+           const char *func,
+           const int line,
+           const char *fmt,
+           ...);
+void log_x_error(const slavery_log_level_t level,
                  const slavery_error_t error,
                  const bool with_errno,
                  const char *file,
@@ -158,18 +181,23 @@ void log_x_error(const char *level,
                  const char *fmt,
                  ...);
 
-#ifdef DEBUG
-	#define log_debug(...) log_x(LOG_LEVEL_DEBUG, __FILE__, __func__, __LINE__, __VA_ARGS__)
-	#define log_info(...) log_x(LOG_LEVEL_INFO, __FILE__, __func__, __LINE, __VA_ARGS__)
-#else
-	#define log_debug(...)
-	#define log_info(...)
-#endif
-
-#define log_warning(error, ...) \
-	log_x_error(LOG_LEVEL_WARNING, error, false, __FILE__, __func__, __LINE__, __VA_ARGS__)
-#define log_warning_errno(error, ...) \
-	log_x_error(LOG_LEVEL_WARNING, error, true, __FILE__, __func__, __LINE__, __VA_ARGS__)
+#define log_at(level, ...)                                           \
+	do {                                                             \
+		if (log_enabled(level)) {                                    \
+			log_x(level, __FILE__, __func__, __LINE__, __VA_ARGS__); \
+		}                                                            \
+	} while (0)
+#define log_at_error(level, error, with_errno, ...)                                           \
+	do {                                                                                      \
+		if (log_enabled(level)) {                                                             \
+			log_x_error(level, error, with_errno, __FILE__, __func__, __LINE__, __VA_ARGS__); \
+		}                                                                                     \
+	} while (0)
+
+#define log_debug(...) log_at(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_warning(error, ...) log_at_error(LOG_LEVEL_WARNING, error, false, __VA_ARGS__)
+#define log_warning_errno(error, ...) log_at_error(LOG_LEVEL_WARNING, error, true, __VA_ARGS__)
 
 #define log_error(error, ...)                                                              \
 	log_x_error(LOG_LEVEL_ERROR, error, false, __FILE__, __func__, __LINE__, __VA_ARGS__); \
@@ -181,9 +209,13 @@ void log_x_error(const char *level,
 extern const uint16_t SLAVERY_USB_VENDOR_ID_LOGITECH;
 extern const uint16_t SLAVERY_USB_PRODUCT_ID_UNIFYING_RECEIVER;
 
-extern const size_t SLAVERY_PACKET_LENGTH_CONTROL_SHORT;
-extern const size_t SLAVERY_PACKET_LENGTH_CONTROL_LONG;
-extern const size_t SLAVERY_PACKET_LENGTH_EVENT;
-extern const size_t SLAVERY_PACKET_LENGTH_MAX;
-
-extern const uint8_t SLAVERY_SOFTWARE_ID;
+/**
+ * @brief USB HID report lengths, usable as array sizes.
+ */
+typedef enum
+{
+	SLAVERY_PACKET_LENGTH_CONTROL_SHORT = 7,
+	SLAVERY_PACKET_LENGTH_CONTROL_LONG = 20,
+	SLAVERY_PACKET_LENGTH_EVENT = 15,
+	SLAVERY_PACKET_LENGTH_MAX = 32
+} slavery_packet_length_t;
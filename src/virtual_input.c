@@ -8,67 +8,124 @@
  * @license $(PROJECT_LICENSE)
  */
 
-#include <libevdev/libevdev-uinput.h>
-#include <libevdev/libevdev.h>
+#define _GNU_SOURCE
+
+#include "virtual_input.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 
-struct libevdev *dev;
-struct libevdev_uinput *uidev;
+static int slavery_virtual_input_setup(const int fd, const slavery_virtual_input_caps_t *caps) {
+	struct uinput_setup setup = {.id = {.bustype = BUS_VIRTUAL}};
 
-int virtual_input_create_device() {
-	dev = libevdev_new();
-	libevdev_set_name(dev, "fake keyboard device");
+	snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "%s", caps->name);
 
-	if (libevdev_enable_event_type(dev, EV_KEY) != 0) {
-		perror("error");
+	if (ioctl(fd, UI_SET_EVBIT, EV_SYN) < 0) {
+		return -1;
+	}
 
+	if (caps->num_keys > 0 && ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0) {
 		return -1;
 	}
 
-	if (libevdev_enable_event_code(dev, EV_KEY, KEY_F12, NULL) != 0) {
-		perror("error");
+	for (size_t i = 0; i < caps->num_keys; i++) {
+		if (ioctl(fd, UI_SET_KEYBIT, caps->keys[i]) < 0) {
+			return -1;
+		}
+	}
 
+	if (caps->num_rels > 0 && ioctl(fd, UI_SET_EVBIT, EV_REL) < 0) {
 		return -1;
 	}
 
-	if (libevdev_uinput_create_from_device(dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &uidev) != 0) {
-		perror("error");
+	for (size_t i = 0; i < caps->num_rels; i++) {
+		if (ioctl(fd, UI_SET_RELBIT, caps->rels[i]) < 0) {
+			return -1;
+		}
+	}
 
+	if (ioctl(fd, UI_DEV_SETUP, &setup) < 0) {
 		return -1;
 	}
 
-	return 0;
+	return ioctl(fd, UI_DEV_CREATE);
+}
+
+bool slavery_virtual_input_caps_equal(const slavery_virtual_input_caps_t *caps,
+                                      const slavery_virtual_input_caps_t *other_caps) {
+	return strcmp(caps->name, other_caps->name) == 0 && caps->num_keys == other_caps->num_keys &&
+	       caps->num_rels == other_caps->num_rels &&
+	       memcmp(caps->keys, other_caps->keys, sizeof(uint16_t) * caps->num_keys) == 0 &&
+	       memcmp(caps->rels, other_caps->rels, sizeof(uint16_t) * caps->num_rels) == 0;
 }
 
-int virtual_input(const int on) {
-	if (libevdev_uinput_write_event(uidev, EV_KEY, KEY_F12, on) < 0) {
-		perror("error");
+slavery_virtual_input_t *slavery_virtual_input_new(const slavery_virtual_input_caps_t *caps) {
+	log_debug("creating virtual input device %s with %zu keys and %zu axes",
+	          caps->name,
+	          caps->num_keys,
+	          caps->num_rels);
 
-		return -1;
+	slavery_virtual_input_t *input = malloc(sizeof(slavery_virtual_input_t));
+
+	if ((input->fd = open("/dev/uinput", O_WRONLY | O_CLOEXEC)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "failed to open /dev/uinput");
+
+		free(input);
+
+		return NULL;
 	}
 
-	if (libevdev_uinput_write_event(uidev, EV_SYN, SYN_REPORT, 0) < 0) {
-		perror("error");
+	if (slavery_virtual_input_setup(input->fd, caps) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "failed to create virtual input device %s", caps->name);
 
-		return -1;
+		close(input->fd);
+		free(input);
+
+		return NULL;
+	}
+
+	return input;
+}
+
+int slavery_virtual_input_free(slavery_virtual_input_t *input) {
+	log_debug("freeing virtual input device at %p", input);
+
+	if (ioctl(input->fd, UI_DEV_DESTROY) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "ioctl()");
 	}
 
-	/*if (libevdev_uinput_write_event(uidev, EV_KEY, KEY_F12, 0) < 0) {
-	    perror("error");
+	if (close(input->fd) < 0) {
+		log_warning_errno(SLAVERY_ERROR_IO, "close()");
 
-	    return -1;
+		free(input);
+
+		return -1;
 	}
 
-	if (libevdev_uinput_write_event(uidev, EV_SYN, SYN_REPORT, 0) < 0) {
-	    perror("error");
+	free(input);
 
-	    return -1;
-	}*/
+	return 0;
+}
 
-	// libevdev_uinput_destroy(uidev);
+int slavery_virtual_input_write_events(slavery_virtual_input_t *input,
+                                       const struct input_event events[],
+                                       const size_t num_events) {
+	size_t size = num_events * sizeof(struct input_event);
 
-	printf("Complete\n");
+	// uinput handles a whole write under one lock, so frames from concurrent writers never interleave.
+	if (write(input->fd, events, size) != (ssize_t)size) {
+		log_warning_errno(SLAVERY_ERROR_IO, "failed to write %zu events to virtual input device", num_events);
+
+		return -1;
+	}
 
 	return 0;
 }
@@ -1,6 +1,6 @@
 /**
  * @file
- * @brief Virtual input functions, used to allow for button remapping.
+ * @brief Virtual input functions and types, used to allow for button remapping.
  *
  * @version $(PROJECT_VERSION)
  * @authors $(PROJECT_AUTHORS)
@@ -10,5 +10,33 @@
 
 #pragma once
 
-int virtual_input_create_device();
-int virtual_input(const int on);
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Event types and codes a virtual device is created with.
+ */
+typedef struct slavery_virtual_input_caps_t {
+	const char *name;
+	size_t num_keys;
+	const uint16_t *keys;
+	size_t num_rels;
+	const uint16_t *rels;
+} slavery_virtual_input_caps_t;
+
+/**
+ * @brief A virtual input device backed by /dev/uinput.
+ */
+typedef struct slavery_virtual_input_t {
+	int fd;
+} slavery_virtual_input_t;
+
+bool slavery_virtual_input_caps_equal(const slavery_virtual_input_caps_t *caps,
+                                      const slavery_virtual_input_caps_t *other_caps);
+slavery_virtual_input_t *slavery_virtual_input_new(const slavery_virtual_input_caps_t *caps);
+int slavery_virtual_input_free(slavery_virtual_input_t *input);
+int slavery_virtual_input_write_events(slavery_virtual_input_t *input,
+                                       const struct input_event events[],
+                                       const size_t num_events);
@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @brief Config file watcher implementation.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "watch.h"
+
+#include "config.h"
+#include "libslavery_p.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+slavery_config_watch_t *slavery_config_watch_new(slavery_t *slavery, const char *path) {
+	log_debug("watching config file %s", path);
+
+	slavery_config_watch_t *watch = malloc(sizeof(slavery_config_watch_t));
+	char *directory = strdup(path);
+
+	watch->slavery = slavery;
+	watch->path = strdup(path);
+	watch->name = strdup(strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 : path);
+
+	if ((watch->inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "inotify_init1() failed");
+
+		free(directory);
+		free(watch->name);
+		free(watch->path);
+		free(watch);
+
+		return NULL;
+	}
+
+	if (inotify_add_watch(watch->inotify_fd, dirname(directory), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) <
+	    0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "inotify_add_watch() failed for %s", path);
+
+		close(watch->inotify_fd);
+		free(directory);
+		free(watch->name);
+		free(watch->path);
+		free(watch);
+
+		return NULL;
+	}
+
+	free(directory);
+
+	if ((watch->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd() failed");
+
+		close(watch->inotify_fd);
+		free(watch->name);
+		free(watch->path);
+		free(watch);
+
+		return NULL;
+	}
+
+	if ((errno = pthread_create(
+	         &watch->thread, NULL, (pthread_callback_t)slavery_config_watch_run, watch)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_create() failed");
+
+		close(watch->stop_fd);
+		close(watch->inotify_fd);
+		free(watch->name);
+		free(watch->path);
+		free(watch);
+
+		return NULL;
+	}
+
+	return watch;
+}
+
+int slavery_config_watch_free(slavery_config_watch_t *watch) {
+	log_debug("freeing config watch at %p", watch);
+
+	if (eventfd_write(watch->stop_fd, 1) < 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "eventfd_write()");
+
+		return -1;
+	}
+
+	if ((errno = pthread_join(watch->thread, NULL)) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_join()");
+
+		return -1;
+	}
+
+	close(watch->stop_fd);
+	close(watch->inotify_fd);
+	free(watch->name);
+	free(watch->path);
+	free(watch);
+
+	return 0;
+}
+
+int slavery_config_watch_reload(slavery_config_watch_t *watch) {
+	uint64_t start_ns = time_monotonic_ns();
+	slavery_config_t *config;
+
+	// A config that fails to parse leaves the current one in place, so a bad edit never drops every rule.
+	if ((config = slavery_config_new(watch->path)) == NULL) {
+		log_warning(SLAVERY_ERROR_CONFIG, "keeping previous config, %s failed to load", watch->path);
+
+		return -1;
+	}
+
+	if (slavery_set_config(watch->slavery, config) < 0) {
+		return -1;
+	}
+
+	log_debug("reloaded %s in %luus", watch->path, (time_monotonic_ns() - start_ns) / 1000);
+
+	return 0;
+}
+
+void *slavery_config_watch_run(slavery_config_watch_t *watch) {
+	if ((errno = pthread_setname_np(pthread_self(), "config")) != 0) {
+		log_warning_errno(SLAVERY_ERROR_OS, "pthread_setname_np() failed");
+	}
+
+	log_debug("started");
+
+	struct pollfd fds[] = {{.fd = watch->inotify_fd, .events = POLLIN},
+	                       {.fd = watch->stop_fd, .events = POLLIN}};
+	_Alignas(struct inotify_event) char buffer[4096];
+
+	while (true) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			log_warning_errno(SLAVERY_ERROR_OS, "poll()");
+
+			return NULL;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			log_debug("stopped");
+
+			return NULL;
+		}
+
+		bool changed = false;
+		ssize_t size;
+
+		// Saves usually arrive as several events, which are coalesced into one reload.
+		while ((size = read(watch->inotify_fd, buffer, sizeof(buffer))) > 0) {
+			for (char *ptr = buffer; ptr < buffer + size;) {
+				const struct inotify_event *event = (const struct inotify_event *)ptr;
+
+				if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+					changed = true;
+				}
+
+				ptr += sizeof(struct inotify_event) + event->len;
+			}
+		}
+
+		if (changed) {
+			slavery_config_watch_reload(watch);
+		}
+	}
+}
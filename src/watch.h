@@ -0,0 +1,35 @@
+/**
+ * @file
+ * @brief Config file watcher functions and types.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+typedef struct slavery_t slavery_t;
+
+/**
+ * @brief Reloads a config file whenever it changes.
+ *
+ * The file's directory is watched rather than the file, so configs replaced by rename, as most editors and
+ * deployment tools do, are picked up too.
+ */
+typedef struct slavery_config_watch_t {
+	slavery_t *slavery;
+	char *path;
+	char *name;
+	int inotify_fd;
+	int stop_fd;
+	pthread_t thread;
+} slavery_config_watch_t;
+
+slavery_config_watch_t *slavery_config_watch_new(slavery_t *slavery, const char *path);
+int slavery_config_watch_free(slavery_config_watch_t *watch);
+int slavery_config_watch_reload(slavery_config_watch_t *watch);
+void *slavery_config_watch_run(slavery_config_watch_t *watch);
@@ -12,6 +12,7 @@
 #include "libslavery.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char *argv[]) {
 	UNUSED(argc);
@@ -19,8 +20,59 @@ int main(int argc, char *argv[]) {
 	slavery_config_t *config = slavery_config_new(argv[1]);
 
 	if (config->num_entries != 1) {
-		log_error(SLAVERY_ERROR_CONFIG, "expected %u config entries, found %u", 1, config->num_entries);
+		log_error(SLAVERY_ERROR_CONFIG, "expected %u config entries, found %zu", 1, config->num_entries);
 	}
 
+	const slavery_config_entry_t *entry = &config->entries[0];
+	const struct input_event *events = slavery_config_entry_get_events(config, entry);
+
+	// alt and tab pressed, then released in reverse, each half closed by a SYN_REPORT.
+	if (entry->num_events != 6 || events[0].code != KEY_LEFTALT || events[1].code != KEY_TAB ||
+	    events[2].type != EV_SYN || events[3].code != KEY_TAB || events[3].value != 0) {
+		log_error(SLAVERY_ERROR_CONFIG, "unexpected compiled output with %u events", entry->num_events);
+	}
+
+	if (config->caps.num_keys != 2 || config->caps.num_rels != 0) {
+		log_error(SLAVERY_ERROR_CONFIG,
+		          "expected 2 keys and no axes, found %zu and %zu",
+		          config->caps.num_keys,
+		          config->caps.num_rels);
+	}
+
+	if (entry->num_do_commands != 1) {
+		log_error(SLAVERY_ERROR_CONFIG, "expected %u compiled commands, found %u", 1, entry->num_do_commands);
+	}
+
+	const slavery_config_command_t *command = slavery_config_entry_get_do_command(config, entry, 0);
+
+	if (command->argc != 1 || strcmp(command->args, "/bin/nautilus") != 0) {
+		log_error(SLAVERY_ERROR_CONFIG, "unexpected compiled command with %u arguments", command->argc);
+	}
+
+	// Commands are split as a shell would, without expanding anything.
+	const char *line = "sh -c 'echo \"$HOME\"' \\x \"a\\\"b\" ''";
+	const char expected[] = "sh\0-c\0echo \"$HOME\"\0x\0a\"b\0";
+	char args[strlen(line) + 1];
+	uint32_t num_args;
+
+	if (slavery_config_command_split(line, args, &num_args) != sizeof(expected) || num_args != 6 ||
+	    memcmp(args, expected, sizeof(expected)) != 0) {
+		log_error(SLAVERY_ERROR_CONFIG, "unexpected split of %s", line);
+	}
+
+	if (slavery_config_command_split("'unterminated", args, &num_args) >= 0) {
+		log_error(SLAVERY_ERROR_CONFIG, "split a command with an unterminated quote");
+	}
+
+	slavery_config_free(config);
+
+	// Loading again maps the compiled copy written by the first load, which must read back the same.
+	if ((config = slavery_config_new(argv[1])) == NULL || config->num_entries != 1 ||
+	    config->entries[0].num_events != 6 || config->caps.num_keys != 2) {
+		log_error(SLAVERY_ERROR_CONFIG, "compiled config doesn't match its source");
+	}
+
+	slavery_config_free(config);
+
 	return EXIT_SUCCESS;
 }
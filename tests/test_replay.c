@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief Test replaying a captured trace, discovery included, with nothing dropped.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#include "libslavery_p.h"
+#include "receiver.h"
+#include "replay.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+	slavery_options_t options;
+	slavery_replay_stats_t stats;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <trace.pcapng>\n", argv[0]);
+
+		return EXIT_FAILURE;
+	}
+
+	slavery_set_log_level(LOG_LEVEL_WARNING);
+	slavery_options_init(&options);
+
+	// The trace was captured without profiles, so every device is discovered from its responses.
+	options.profiles = false;
+
+	slavery_replay_t *replay = slavery_replay_new(argv[1], &options, NULL);
+
+	if (replay == NULL) {
+		log_error(SLAVERY_ERROR_IO, "failed to load trace %s", argv[1]);
+	}
+
+	slavery_device_t *device = slavery_receiver_get_device_slot(replay->receiver, SLAVERY_DEVICE_INDEX_1);
+
+	if (device == NULL || strcmp(device->name, "Wireless Mouse MX Master 3") != 0 ||
+	    device->num_buttons == 0) {
+		log_error(SLAVERY_ERROR_HIDPP, "mouse in the trace wasn't discovered");
+	}
+
+	if (slavery_replay_run(replay, true) < 0) {
+		log_error(SLAVERY_ERROR_EVENT, "no events to replay");
+	}
+
+	slavery_replay_get_stats(replay, &stats);
+
+	if (stats.events == 0 || stats.dispatched != stats.events) {
+		log_error(SLAVERY_ERROR_EVENT, "dispatched %zu of %zu events", stats.dispatched, stats.events);
+	}
+
+	printf("replayed %zu events in %.3fms\n", stats.events, stats.elapsed_ns / 1e6);
+
+	slavery_replay_free(replay);
+
+	return EXIT_SUCCESS;
+}
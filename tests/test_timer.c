@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @brief Test the timer wheel.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#include "timer.h"
+#include "utils.h"
+
+#include <poll.h>
+#include <stdlib.h>
+
+#define NUM_TIMERS 400
+
+static slavery_timer_t timers[NUM_TIMERS];
+static uint64_t deadlines[NUM_TIMERS];
+static unsigned int fired[NUM_TIMERS];
+static size_t num_fired = 0;
+static size_t num_late = 0;
+
+static void on_timer(slavery_timer_t *timer) {
+	size_t index = timer - timers;
+	uint64_t now = time_monotonic_ns();
+
+	if (now < deadlines[index]) {
+		log_error(SLAVERY_ERROR_TIMEOUT, "timer %zu fired %luns early", index, deadlines[index] - now);
+	}
+
+	if (now - deadlines[index] > 2000000) {
+		num_late++;
+	}
+
+	fired[index]++;
+	num_fired++;
+}
+
+int main() {
+	slavery_timer_wheel_t wheel;
+	struct pollfd fd;
+	size_t num_expected = 0;
+
+	if (slavery_timer_wheel_init(&wheel) < 0) {
+		log_error(SLAVERY_ERROR_OS, "failed to create timer wheel");
+	}
+
+	srand(1);
+
+	// Delays up to 5s put timers on the upper levels, so they have to cascade down to fire on time.
+	for (size_t i = 0; i < NUM_TIMERS; i++) {
+		uint64_t delay_ns = (rand() % (i % 8 == 0 ? 5000 : 300)) * 1000000ULL + rand() % 1000000;
+
+		slavery_timer_init(&timers[i], on_timer, NULL);
+		deadlines[i] = time_monotonic_ns() + delay_ns;
+		slavery_timer_arm(&wheel, &timers[i], delay_ns);
+	}
+
+	for (size_t i = 0; i < NUM_TIMERS; i++) {
+		if (i % 10 == 0) {
+			slavery_timer_cancel(&wheel, &timers[i]);
+		} else {
+			num_expected++;
+		}
+	}
+
+	fd.fd = wheel.fd;
+	fd.events = POLLIN;
+
+	while (num_fired < num_expected) {
+		if (poll(&fd, 1, 6000) <= 0) {
+			log_error(SLAVERY_ERROR_TIMEOUT, "only %zu of %zu timers fired", num_fired, num_expected);
+		}
+
+		slavery_timer_wheel_expire(&wheel);
+	}
+
+	for (size_t i = 0; i < NUM_TIMERS; i++) {
+		if (fired[i] != (i % 10 == 0 ? 0 : 1)) {
+			log_error(SLAVERY_ERROR_TIMEOUT, "timer %zu fired %u times", i, fired[i]);
+		}
+	}
+
+	// A loaded machine can delay a wakeup now and then, but most have to land within a tick of their
+	// deadline.
+	if (num_late > num_expected / 10) {
+		log_error(SLAVERY_ERROR_TIMEOUT, "%zu of %zu timers fired over 2ms late", num_late, num_expected);
+	}
+
+	slavery_timer_wheel_destroy(&wheel);
+
+	return EXIT_SUCCESS;
+}
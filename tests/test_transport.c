@@ -0,0 +1,583 @@
+/**
+ * @file
+ * @brief Test enumeration, dispatch and capture against mock receivers, and how fast events get through.
+ *
+ * @version $(PROJECT_VERSION)
+ * @authors $(PROJECT_AUTHORS)
+ * @copyright $(PROJECT_COPYRIGHT)
+ * @license $(PROJECT_LICENSE)
+ */
+
+#define _GNU_SOURCE
+
+#include "capture.h"
+#include "config.h"
+#include "device.h"
+#include "function.h"
+#include "libslavery_p.h"
+#include "mock.h"
+#include "receiver.h"
+#include "utils.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_EVENTS 200000
+#define NUM_CAPTURE_ROUNDS 16
+
+static slavery_t *start(slavery_mock_t *mock,
+                        const bool profiles,
+                        const bool reactor,
+                        const char *capture_path) {
+	slavery_options_t options;
+	slavery_t *slavery;
+
+	slavery_options_init(&options);
+
+	options.transport = &mock->transport;
+	options.cache = false;
+	options.profiles = profiles;
+	options.reactor = reactor;
+	options.capture_path = capture_path;
+
+	if ((slavery = slavery_new_with_options(&options)) == NULL) {
+		log_error(SLAVERY_ERROR_OS, "failed to create context");
+	}
+
+	if (slavery_scan_receivers(slavery) != 2) {
+		log_error(SLAVERY_ERROR_IO, "expected 2 receivers, found %zu", slavery->num_receivers);
+	}
+
+	// The keyboard answers, but only mice are kept.
+	if (slavery_scan_devices(slavery) != 2) {
+		log_error(SLAVERY_ERROR_HIDPP, "expected 2 devices");
+	}
+
+	return slavery;
+}
+
+static size_t count_dispatched(slavery_t *slavery) {
+	slavery_pool_stats_t stats;
+	size_t dispatched = 0;
+
+	for (size_t i = 0; i < slavery_get_num_workers(slavery); i++) {
+		slavery_get_pool_stats(slavery, i, &stats);
+		dispatched += stats.dispatched;
+	}
+
+	return dispatched;
+}
+
+static void wait_dispatched(slavery_t *slavery, const size_t count) {
+	uint64_t deadline_ns = time_monotonic_ns() + 2000000000;
+
+	while (count_dispatched(slavery) < count) {
+		if (time_monotonic_ns() > deadline_ns) {
+			log_error(
+			    SLAVERY_ERROR_TIMEOUT, "only %zu of %zu events dispatched", count_dispatched(slavery), count);
+		}
+
+		sched_yield();
+	}
+
+	// Workers release each event they finish through the receiver's count, so its state can be read after.
+	for (size_t i = 0; i < slavery->num_receivers; i++) {
+		while (atomic_load_explicit(&slavery->receivers[i]->pending_events, memory_order_acquire) > 0) {
+			sched_yield();
+		}
+	}
+}
+
+static void wait_commands(slavery_t *slavery, const size_t count) {
+	uint64_t deadline_ns = time_monotonic_ns() + 2000000000;
+	slavery_launcher_stats_t stats;
+
+	// Whether the command could be started doesn't matter, only that its rule ran.
+	do {
+		if (time_monotonic_ns() > deadline_ns) {
+			log_error(
+			    SLAVERY_ERROR_TIMEOUT, "only %zu of %zu commands run", stats.launched + stats.failed, count);
+		}
+
+		sched_yield();
+		slavery_get_launcher_stats(slavery, &stats);
+	} while (stats.launched + stats.failed < count);
+}
+
+static slavery_config_t *gesture_config() {
+	slavery_config_button_t button = {.cid = SLAVERY_CID_MOUSE_THUMB};
+	slavery_config_action_t action = SLAVERY_CONFIG_ACTION_GESTURE_UP;
+	char *do_command[] = {"true"};
+	slavery_config_source_entry_t entry = {.name = "gesture",
+	                                       .num_buttons = 1,
+	                                       .buttons = &button,
+	                                       .num_actions = 1,
+	                                       .actions = &action,
+	                                       .enabled = true,
+	                                       .num_do_commands = 1,
+	                                       .do_command = do_command};
+	slavery_config_source_entry_t *entries[] = {&entry};
+	char path[] = "/tmp/test_transport-XXXXXX";
+	struct stat source = {0};
+	slavery_config_t *config;
+	size_t size;
+	int fd;
+
+	// The image is loaded back as a precompiled config, so no JSON is needed.
+	uint8_t *data = slavery_config_image_build(entries, 1, &source, &size);
+
+	if ((fd = mkstemp(path)) < 0 || write(fd, data, size) != (ssize_t)size) {
+		log_error(SLAVERY_ERROR_IO, "failed to write compiled config");
+	}
+
+	close(fd);
+	free(data);
+
+	if ((config = slavery_config_new(path)) == NULL) {
+		log_error(SLAVERY_ERROR_CONFIG, "failed to load compiled config");
+	}
+
+	unlink(path);
+
+	return config;
+}
+
+static void test_enumeration(const slavery_mock_device_t *mouse,
+                             const slavery_mock_device_t *keyboard,
+                             const bool profiles) {
+	slavery_mock_t *mock = slavery_mock_new(2);
+
+	slavery_mock_attach(mock, 0, SLAVERY_DEVICE_INDEX_1, mouse);
+	slavery_mock_attach(mock, 0, SLAVERY_DEVICE_INDEX_2, keyboard);
+	slavery_mock_attach(mock, 1, SLAVERY_DEVICE_INDEX_4, mouse);
+
+	slavery_t *slavery = start(mock, profiles, false, NULL);
+	slavery_device_t *device = slavery_receiver_get_device_slot(slavery_get_receiver(slavery, 0), 1);
+
+	if (device == NULL || strcmp(device->name, mouse->name) != 0 ||
+	    strcmp(device->protocol_version, "4.5") != 0 || device->num_buttons != mouse->num_controls) {
+		log_error(SLAVERY_ERROR_HIDPP, "mouse on mock:0 wasn't discovered as modelled");
+	}
+
+	// Whether built from a profile or discovered, the device has to have every feature and control modelled.
+	for (size_t i = 0; i < mouse->num_features; i++) {
+		if (slavery_feature_id_to_index(device, mouse->features[i].id) != mouse->features[i].index) {
+			log_error(SLAVERY_ERROR_HIDPP, "feature %#06x not found at its index", mouse->features[i].id);
+		}
+	}
+
+	for (size_t i = 0; i < mouse->num_controls; i++) {
+		slavery_cid_t cid = (slavery_cid_t)mouse->controls[i].info[0] << 8 | mouse->controls[i].info[1];
+		slavery_cid_t found = device->buttons[i]->cid;
+
+		if (found != cid) {
+			log_error(SLAVERY_ERROR_HIDPP, "expected control %#06x, found %#06x", cid, found);
+		}
+	}
+
+	if (slavery_receiver_get_device_slot(slavery_get_receiver(slavery, 0), 2) != NULL ||
+	    slavery_receiver_get_device_slot(slavery_get_receiver(slavery, 1), 4) == NULL) {
+		log_error(SLAVERY_ERROR_HIDPP, "devices found in the wrong slots");
+	}
+
+	printf("enumerated %s in %zu requests\n",
+	       profiles ? "from profiles" : "by discovery",
+	       atomic_load(&mock->requests));
+
+	slavery_free(slavery);
+	slavery_mock_free(mock);
+}
+
+static void test_dispatch(const slavery_mock_device_t *mouse, const bool reactor) {
+	slavery_mock_t *mock = slavery_mock_new(2);
+
+	slavery_mock_attach(mock, 0, SLAVERY_DEVICE_INDEX_1, mouse);
+	slavery_mock_attach(mock, 1, SLAVERY_DEVICE_INDEX_1, mouse);
+
+	slavery_t *slavery = start(mock, true, reactor, NULL);
+	slavery_device_t *device = slavery_receiver_get_device_slot(slavery_get_receiver(slavery, 0), 1);
+	ssize_t thumb = slavery_device_cid_to_bit(device, SLAVERY_CID_MOUSE_THUMB);
+	slavery_cid_t cids[] = {SLAVERY_CID_MOUSE_THUMB};
+
+	if (thumb < 0) {
+		log_error(SLAVERY_ERROR_HIDPP, "thumb button has no bit");
+	}
+
+	// Reported and diverted buttons end up in the same state.
+	slavery_mock_press(mock, 0, SLAVERY_DEVICE_INDEX_1, 0x01);
+	wait_dispatched(slavery, 1);
+	slavery_mock_press_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, cids, 1);
+	wait_dispatched(slavery, 2);
+
+	if (device->pressed != (1u | 1u << thumb)) {
+		log_error(SLAVERY_ERROR_EVENT, "expected buttons %#x, found %#x", 1u | 1u << thumb, device->pressed);
+	}
+
+	slavery_mock_press_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, NULL, 0);
+	slavery_mock_press(mock, 0, SLAVERY_DEVICE_INDEX_1, 0x00);
+	wait_dispatched(slavery, 4);
+
+	if (device->pressed != 0) {
+		log_error(SLAVERY_ERROR_EVENT, "expected no buttons, found %#x", device->pressed);
+	}
+
+	// A keyboard report from the same slot has a key where a mouse report has its button bits.
+	uint8_t keyboard[SLAVERY_PACKET_LENGTH_EVENT] = {
+	    SLAVERY_REPORT_ID_EVENT, SLAVERY_DEVICE_INDEX_1, 0x01, 0x01};
+
+	slavery_mock_send(mock, 0, keyboard, sizeof(keyboard));
+	wait_dispatched(slavery, 5);
+
+	if (device->pressed != 0) {
+		log_error(SLAVERY_ERROR_EVENT, "keyboard report decoded as buttons %#x", device->pressed);
+	}
+
+	size_t base = count_dispatched(slavery);
+	size_t window = slavery->options.worker_queue_size / 2;
+	uint64_t start_ns = time_monotonic_ns();
+
+	// Events are kept within what the worker queues can hold, so none are dropped and every one is timed.
+	for (size_t sent = 0; sent < NUM_EVENTS; sent++) {
+		while (sent - (count_dispatched(slavery) - base) >= window) {
+			sched_yield();
+		}
+
+		slavery_mock_press(mock, sent % 2, SLAVERY_DEVICE_INDEX_1, sent % 4 < 2 ? 0x01 : 0x00);
+	}
+
+	wait_dispatched(slavery, base + NUM_EVENTS);
+
+	uint64_t elapsed_ns = time_monotonic_ns() - start_ns;
+
+	printf("dispatched %u events with the %s in %.3fs, %.0f events/s\n",
+	       NUM_EVENTS,
+	       reactor ? "reactor" : "listeners",
+	       elapsed_ns / 1e9,
+	       NUM_EVENTS * 1e9 / elapsed_ns);
+
+	slavery_free(slavery);
+	slavery_mock_free(mock);
+}
+
+static void test_gesture(const slavery_mock_device_t *mouse) {
+	slavery_mock_t *mock = slavery_mock_new(2);
+	int reporting = SLAVERY_CONTROLS_V4_REPORT_DIVERT | SLAVERY_CONTROLS_V4_REPORT_RAW_XY;
+	slavery_cid_t cids[] = {SLAVERY_CID_MOUSE_THUMB};
+
+	slavery_mock_attach(mock, 0, SLAVERY_DEVICE_INDEX_1, mouse);
+	slavery_mock_attach(mock, 1, SLAVERY_DEVICE_INDEX_1, mouse);
+
+	slavery_t *slavery = start(mock, true, false, NULL);
+	slavery_device_t *device = slavery_receiver_get_device_slot(slavery_get_receiver(slavery, 0), 1);
+
+	slavery_set_config(slavery, gesture_config());
+
+	if (slavery_mock_get_reporting(mock, 0, SLAVERY_DEVICE_INDEX_1, SLAVERY_CID_MOUSE_THUMB) != reporting) {
+		log_error(SLAVERY_ERROR_HIDPP, "thumb button wasn't diverted with raw XY");
+	}
+
+	// Motion under the threshold is still a press, so releasing it runs nothing.
+	slavery_mock_press_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, cids, 1);
+	slavery_mock_move_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, 10, -20);
+	wait_dispatched(slavery, 2);
+
+	if (device->gesture.moved || device->gesture.dx != 10 || device->gesture.dy != -20) {
+		log_error(SLAVERY_ERROR_EVENT, "unexpected gesture %d,%d", device->gesture.dx, device->gesture.dy);
+	}
+
+	// Past it, the dominant axis picks the gesture, wherever the motion wandered on the way.
+	slavery_mock_move_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, 30, -20);
+	slavery_mock_move_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, -30, -40);
+	wait_dispatched(slavery, 4);
+
+	if (!device->gesture.moved || device->gesture.dx != 10 || device->gesture.dy != -80) {
+		log_error(SLAVERY_ERROR_EVENT, "unexpected gesture %d,%d", device->gesture.dx, device->gesture.dy);
+	}
+
+	slavery_mock_press_diverted(mock, 0, SLAVERY_DEVICE_INDEX_1, NULL, 0);
+	wait_dispatched(slavery, 5);
+	wait_commands(slavery, 1);
+
+	if (device->gesture.moved || device->gesture.dx != 0 || device->gesture.dy != 0) {
+		log_error(SLAVERY_ERROR_EVENT, "gesture wasn't reset on release");
+	}
+
+	// Diversion is lost along with the link, so it has to be sent again once the device is back.
+	slavery_mock_reconnect(mock, 0, SLAVERY_DEVICE_INDEX_1);
+	wait_dispatched(slavery, 6);
+
+	if (slavery_mock_get_reporting(mock, 0, SLAVERY_DEVICE_INDEX_1, SLAVERY_CID_MOUSE_THUMB) != reporting) {
+		log_error(SLAVERY_ERROR_HIDPP, "thumb button wasn't diverted again after reconnecting");
+	}
+
+	slavery_free(slavery);
+	slavery_mock_free(mock);
+}
+
+static uint32_t get_u32(const uint8_t data[]) {
+	uint32_t value;
+
+	memcpy(&value, data, sizeof(value));
+
+	return value;
+}
+
+static const uint8_t *find_option(const uint8_t options[],
+                                  const size_t size,
+                                  const uint16_t code,
+                                  uint16_t *length) {
+	const uint8_t *found = NULL;
+	size_t offset = 0;
+
+	// Every option is walked, so each one's padding and the end of options are checked as well.
+	while (true) {
+		uint16_t header[2];
+
+		if (offset + sizeof(header) > size) {
+			log_error(SLAVERY_ERROR_IO, "options run past their block");
+		}
+
+		memcpy(header, options + offset, sizeof(header));
+
+		size_t padded = (header[1] + 3) & ~3;
+
+		if (header[0] == SLAVERY_CAPTURE_OPTION_END) {
+			if (header[1] != 0 || offset + sizeof(header) != size) {
+				log_error(SLAVERY_ERROR_IO, "options don't end at the end of their block");
+			}
+
+			return found;
+		}
+
+		if (offset + sizeof(header) + padded > size) {
+			log_error(SLAVERY_ERROR_IO, "option %u runs past its block", header[0]);
+		}
+
+		for (size_t i = header[1]; i < padded; i++) {
+			if (options[offset + sizeof(header) + i] != 0) {
+				log_error(SLAVERY_ERROR_IO, "option %u is padded with non-zero bytes", header[0]);
+			}
+		}
+
+		if (header[0] == code) {
+			found = options + offset + sizeof(header);
+			*length = header[1];
+		}
+
+		offset += sizeof(header) + padded;
+	}
+}
+
+static void check_capture(const uint8_t data[], const size_t size) {
+	uint8_t pressed[2][2];
+	size_t num_pressed[2] = {0};
+	size_t num_blocks = 0;
+	size_t num_out = 0;
+	uint8_t resolution = 0;
+	int64_t now_ns = time(NULL) * INT64_C(1000000000);
+	uint16_t length;
+	const uint8_t *option;
+
+	for (size_t offset = 0; offset < size;) {
+		if (size - offset < 12) {
+			log_error(SLAVERY_ERROR_IO, "block %zu is truncated", num_blocks);
+		}
+
+		uint32_t type = get_u32(data + offset);
+		uint32_t block_length = get_u32(data + offset + 4);
+		const uint8_t *body = data + offset + 8;
+		size_t body_size = block_length - 12;
+
+		if (block_length % 4 != 0 || block_length < 12 || block_length > size - offset ||
+		    get_u32(data + offset + block_length - 4) != block_length) {
+			log_error(SLAVERY_ERROR_IO, "block %zu has a bad length %u", num_blocks, block_length);
+		}
+
+		if (num_blocks == 0) {
+			if (type != SLAVERY_CAPTURE_BLOCK_SHB || body_size < 16 ||
+			    get_u32(body) != SLAVERY_CAPTURE_BYTE_ORDER_MAGIC || get_u32(body + 4) != 1) {
+				log_error(SLAVERY_ERROR_IO, "capture doesn't start with a section header");
+			}
+
+			option = find_option(body + 16, body_size - 16, SLAVERY_CAPTURE_OPTION_SHB_USERAPPL, &length);
+
+			if (option == NULL) {
+				log_error(SLAVERY_ERROR_IO, "section header doesn't name its application");
+			}
+		} else if (num_blocks == 1) {
+			if (type != SLAVERY_CAPTURE_BLOCK_IDB || body_size < 8 ||
+			    get_u32(body) != SLAVERY_CAPTURE_LINKTYPE_USB_LINUX_MMAPPED ||
+			    get_u32(body + 4) != sizeof(slavery_capture_usbmon_header_t) + SLAVERY_PACKET_LENGTH_MAX) {
+				log_error(SLAVERY_ERROR_IO, "capture doesn't describe a usbmon interface");
+			}
+
+			option = find_option(body + 8, body_size - 8, SLAVERY_CAPTURE_OPTION_IF_TSRESOL, &length);
+
+			if (option == NULL || length != 1) {
+				log_error(SLAVERY_ERROR_IO, "interface has no timestamp resolution");
+			}
+
+			resolution = *option;
+		} else {
+			slavery_capture_usbmon_header_t header;
+			uint32_t captured = body_size >= 20 ? get_u32(body + 12) : 0;
+			size_t padded = (captured + 3) & ~3;
+
+			if (type != SLAVERY_CAPTURE_BLOCK_EPB || get_u32(body) != 0 || captured != get_u32(body + 16) ||
+			    captured < sizeof(header) || 20 + padded > body_size) {
+				log_error(SLAVERY_ERROR_IO, "block %zu isn't a usbmon packet", num_blocks);
+			}
+
+			for (size_t i = captured; i < padded; i++) {
+				if (body[20 + i] != 0) {
+					log_error(SLAVERY_ERROR_IO, "packet %zu is padded with non-zero bytes", num_blocks);
+				}
+			}
+
+			memcpy(&header, body + 20, sizeof(header));
+
+			const uint8_t *report = body + 20 + sizeof(header);
+			uint64_t time_ns = (uint64_t)get_u32(body + 4) << 32 | get_u32(body + 8);
+			bool in = header.type == 'C';
+			uint32_t flags = in ? SLAVERY_CAPTURE_EPB_FLAGS_INBOUND : SLAVERY_CAPTURE_EPB_FLAGS_OUTBOUND;
+			uint8_t endpoint = in ? SLAVERY_CAPTURE_USB_ENDPOINT_IN : SLAVERY_CAPTURE_USB_ENDPOINT_OUT;
+
+			option = find_option(
+			    body + 20 + padded, body_size - 20 - padded, SLAVERY_CAPTURE_OPTION_EPB_FLAGS, &length);
+
+			// With nanosecond timestamps, the packet and its usbmon header agree on when it happened.
+			if (option == NULL || length != 4 || get_u32(option) != flags || header.endpoint != endpoint ||
+			    header.captured_length != captured - sizeof(header) ||
+			    header.ts_sec != (int64_t)(time_ns / 1000000000) ||
+			    header.ts_usec != (int32_t)(time_ns % 1000000000 / 1000) ||
+			    llabs((int64_t)time_ns - now_ns) > INT64_C(60000000000)) {
+				log_error(SLAVERY_ERROR_IO, "packet %zu doesn't describe its report", num_blocks);
+			}
+
+			num_out += !in;
+
+			if (in && header.captured_length == SLAVERY_PACKET_LENGTH_EVENT &&
+			    report[0] == SLAVERY_REPORT_ID_EVENT && header.bus < 2 && num_pressed[header.bus] < 2) {
+				pressed[header.bus][num_pressed[header.bus]++] = report[3];
+			}
+		}
+
+		offset += block_length;
+		num_blocks++;
+	}
+
+	if (resolution != 9) {
+		log_error(SLAVERY_ERROR_IO, "expected nanosecond timestamps, found resolution %u", resolution);
+	}
+
+	if (num_out == 0 || num_pressed[0] != 2 || pressed[0][0] != 0x01 || pressed[0][1] != 0x00 ||
+	    num_pressed[1] != 1 || pressed[1][0] != 0x01) {
+		log_error(SLAVERY_ERROR_IO, "captured reports don't match those sent");
+	}
+
+	printf("captured %zu packets\n", num_blocks - 2);
+}
+
+static void test_capture(const slavery_mock_device_t *mouse) {
+	slavery_mock_t *mock = slavery_mock_new(2);
+	char path[] = "/tmp/test_transport-XXXXXX";
+	int fd;
+
+	if ((fd = mkstemp(path)) < 0) {
+		log_error(SLAVERY_ERROR_IO, "failed to create capture file");
+	}
+
+	close(fd);
+
+	slavery_mock_attach(mock, 0, SLAVERY_DEVICE_INDEX_1, mouse);
+	slavery_mock_attach(mock, 1, SLAVERY_DEVICE_INDEX_1, mouse);
+
+	slavery_t *slavery = start(mock, true, false, path);
+
+	slavery_mock_press(mock, 0, SLAVERY_DEVICE_INDEX_1, 0x01);
+	slavery_mock_press(mock, 1, SLAVERY_DEVICE_INDEX_1, 0x01);
+	slavery_mock_press(mock, 0, SLAVERY_DEVICE_INDEX_1, 0x00);
+	wait_dispatched(slavery, 3);
+
+	// Freeing the context writes out whatever is still in the ring.
+	slavery_free(slavery);
+	slavery_mock_free(mock);
+
+	FILE *file = fopen(path, "re");
+	uint8_t *data;
+	long size;
+
+	if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET) != 0 || (data = malloc(size)) == NULL ||
+	    fread(data, 1, size, file) != (size_t)size) {
+		log_error(SLAVERY_ERROR_IO, "failed to read capture back");
+	}
+
+	fclose(file);
+	unlink(path);
+	check_capture(data, size);
+	free(data);
+
+	// Only the I/O path's side is timed, a round at a time so the writer never lets the ring fill.
+	slavery_capture_t *capture = slavery_capture_new("/dev/null");
+	uint8_t report[SLAVERY_PACKET_LENGTH_EVENT] = {
+	    SLAVERY_REPORT_ID_EVENT, SLAVERY_DEVICE_INDEX_1, SLAVERY_EVENT_TYPE_MOUSE};
+	size_t per_round = SLAVERY_CAPTURE_RING_SIZE / 2;
+	uint64_t elapsed_ns = 0;
+
+	if (capture == NULL) {
+		log_error(SLAVERY_ERROR_IO, "failed to start capture");
+	}
+
+	for (size_t round = 0; round < NUM_CAPTURE_ROUNDS; round++) {
+		while (atomic_load(&capture->dequeue_pos) != atomic_load(&capture->enqueue_pos)) {
+			usleep(1000);
+		}
+
+		uint64_t start_ns = time_monotonic_ns();
+
+		for (size_t i = 0; i < per_round; i++) {
+			slavery_capture_report(capture, 0, SLAVERY_CAPTURE_DIRECTION_IN, report, sizeof(report));
+		}
+
+		elapsed_ns += time_monotonic_ns() - start_ns;
+	}
+
+	if (atomic_load(&capture->dropped) > 0) {
+		log_error(SLAVERY_ERROR_IO, "capture dropped reports with room in its ring");
+	}
+
+	printf("captured %zu reports in %.0fns each\n",
+	       NUM_CAPTURE_ROUNDS * per_round,
+	       (double)elapsed_ns / (NUM_CAPTURE_ROUNDS * per_round));
+
+	slavery_capture_free(capture);
+}
+
+int main() {
+	slavery_mock_device_t mouse;
+	slavery_mock_device_t keyboard;
+
+	slavery_set_log_level(LOG_LEVEL_WARNING);
+
+	mouse = slavery_mock_mx_master_3;
+
+	// A keyboard sharing the mouse's features, but not its firmware, so it always needs discovering.
+	keyboard = mouse;
+	keyboard.name = "Wireless Keyboard";
+	keyboard.type = SLAVERY_DEVICE_TYPE_KEYBOARD;
+	keyboard.firmware[4] = 0x00;
+
+	test_enumeration(&mouse, &keyboard, false);
+	test_enumeration(&mouse, &keyboard, true);
+	test_dispatch(&mouse, false);
+	test_dispatch(&mouse, true);
+	test_gesture(&mouse);
+	test_capture(&mouse);
+
+	return EXIT_SUCCESS;
+}